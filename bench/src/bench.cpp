@@ -0,0 +1,455 @@
+#include "bench.h"
+#include <octal/ecs/ecs.h>
+#include <octal/ecs/scene.h>
+#include <octal/ecs/entity.h>
+#include <octal/core/jobs.h>
+#include <octal/core/logger.h>
+#include <octal/math/math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Standalone benchmarks for the ECS
+// usage: bench [--max N] [--json path] [--filter name]
+
+struct Position : octal::Component {
+  f32 x, y, z;
+  Position(f32 x = 0, f32 y = 0, f32 z = 0) : x(x), y(y), z(z) {}
+};
+
+struct Velocity : octal::Component {
+  f32 x, y, z;
+  Velocity(f32 x = 0, f32 y = 0, f32 z = 0) : x(x), y(y), z(z) {}
+};
+
+struct Health : octal::Component {
+  i32 hp;
+  Health(i32 hp = 100) : hp(hp) {}
+};
+
+struct Enemy : octal::Component {};
+struct Visible : octal::Component {};
+struct Dead : octal::Component {};
+
+/// Big component that isn't trivially copyable
+struct Large : octal::Component {
+  std::string name;
+  f32 data[60];
+  Large(const char* name, f32 v) : name(name) {
+    for (f32& d : data) d = v;
+  }
+};
+
+/// Result of running one scenario
+struct Result {
+  std::string name;
+  std::string variant;
+  u32 entities;
+  /// Operations done in the timed section
+  u64 ops;
+  /// Time of the timed section in nanoseconds
+  f64 ns;
+  /// Resident memory gained since the scenario started setting up, in kilobytes
+  i64 rss_growth_kb;
+};
+
+static std::vector<Result> s_Results;
+
+volatile u64 g_Sink;
+
+/// Resident memory of the process when the current scenario started
+static i64 s_BaselineKb;
+
+/// Peak resident memory of the whole run in kilobytes
+static u64 peakRss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // kilobytes on linux
+  return (u64) usage.ru_maxrss;
+}
+
+/// Resident memory of the process right now in kilobytes
+static i64 residentKb() {
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  unsigned long long size = 0, resident = 0;
+  int read = fscanf(f, "%llu %llu", &size, &resident);
+  fclose(f);
+  return read == 2 ? (i64) (resident * (u64) sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
+
+/// Count memory growth from here, called before each scenario sets up
+static void markBaseline() {
+  s_BaselineKb = residentKb();
+}
+
+void Record(const char* name, const char* variant, u32 n, u64 ops, f64 ns) {
+  s_Results.push_back({name, variant, n, ops, ns, residentKb() - s_BaselineKb});
+  const Result& r = s_Results.back();
+  printf("%-22s %-10s %9u %12.2f ns/op %14.0f ops/s %+10lld KB\n",
+      r.name.c_str(), r.variant.c_str(), r.entities, r.ns / r.ops,
+      r.ops / (r.ns * 1e-9), (long long) r.rss_growth_kb);
+}
+
+static const char* storageName(octal::ECS::Storage storage) {
+  return storage == octal::ECS::Storage::SparseSet ? "sparse" : "archetype";
+}
+
+/// Time a section of an ecs scenario
+template<typename F>
+static void measure(const char* name, octal::ECS::Storage storage, u32 n, F&& func) {
+  Measure(name, storageName(storage), n, std::forward<F>(func));
+}
+
+/// Create n entities then destroy all of them, twice so recycled ids are covered
+static void createDestroy(octal::ECS::Storage storage, u32 n) {
+  octal::ECS ecs(storage);
+  std::vector<u32> ids(n);
+  measure("create_destroy", storage, n, [&]() {
+    for (u32 round = 0; round < 2; ++round) {
+      for (u32 i = 0; i < n; ++i)
+        ids[i] = ecs.CreateEntity();
+      for (u32 i = 0; i < n; ++i)
+        ecs.DestroyEntity(ids[i]);
+    }
+    return (u64) n * 4;
+  });
+}
+
+/// Add and remove a component on entities that already have others
+static void addRemove(octal::ECS::Storage storage, u32 n) {
+  octal::ECS ecs(storage);
+  std::vector<u32> ids(n);
+  for (u32 i = 0; i < n; ++i) {
+    ids[i] = ecs.CreateEntity();
+    ecs.Emplace<Position>(ids[i], (f32) i, 0.f, 0.f);
+  }
+  measure("add_remove", storage, n, [&]() {
+    for (u32 round = 0; round < 2; ++round) {
+      for (u32 i = 0; i < n; ++i)
+        ecs.Emplace<Velocity>(ids[i], 1.f, 1.f, 1.f);
+      for (u32 i = 0; i < n; ++i)
+        ecs.RemoveComponent<Velocity>(ids[i]);
+    }
+    return (u64) n * 4;
+  });
+}
+
+/// Add a large non-trivial component in place and by copying a finished one
+static void addLarge(octal::ECS::Storage storage, u32 n) {
+  std::vector<u32> ids(n);
+  {
+    octal::ECS ecs(storage);
+    for (u32 i = 0; i < n; ++i)
+      ids[i] = ecs.CreateEntity();
+    measure("add_large_emplace", storage, n, [&]() {
+      for (u32 i = 0; i < n; ++i)
+        ecs.Emplace<Large>(ids[i], "a component with a name that doesn't fit in sso", (f32) i);
+      return (u64) n;
+    });
+  }
+  {
+    octal::ECS ecs(storage);
+    for (u32 i = 0; i < n; ++i)
+      ids[i] = ecs.CreateEntity();
+    measure("add_large_copy", storage, n, [&]() {
+      for (u32 i = 0; i < n; ++i) {
+        Large comp("a component with a name that doesn't fit in sso", (f32) i);
+        ecs.AddComponent(ids[i], comp);
+      }
+      return (u64) n;
+    });
+  }
+}
+
+/// Get components of entities in a random order
+static void getRandom(octal::ECS::Storage storage, u32 n) {
+  octal::ECS ecs(storage);
+  std::vector<u32> ids(n);
+  for (u32 i = 0; i < n; ++i) {
+    ids[i] = ecs.CreateEntity();
+    ecs.Emplace<Position>(ids[i], (f32) i, 0.f, 0.f);
+    ecs.Emplace<Velocity>(ids[i], 1.f, 1.f, 1.f);
+  }
+  std::mt19937 rng(1234);
+  std::shuffle(ids.begin(), ids.end(), rng);
+  measure("get_random", storage, n, [&]() {
+    f32 sum = 0;
+    for (u32 i = 0; i < n; ++i)
+      sum += ecs.GetComponent<Position>(ids[i])->x;
+    g_Sink = (u64) sum;
+    return (u64) n;
+  });
+}
+
+/// Iterate views over one to three components
+static void iterate(octal::ECS::Storage storage, u32 n) {
+  octal::ECS ecs(storage);
+  for (u32 i = 0; i < n; ++i) {
+    u32 id = ecs.CreateEntity();
+    ecs.Emplace<Position>(id, (f32) i, 0.f, 0.f);
+    ecs.Emplace<Velocity>(id, 1.f, 1.f, 1.f);
+    ecs.Emplace<Health>(id, (i32) i);
+  }
+  measure("iterate_1", storage, n, [&]() {
+    f32 sum = 0;
+    ecs.View<const Position>().Each([&](const Position& p) { sum += p.x; });
+    g_Sink = (u64) sum;
+    return (u64) n;
+  });
+  measure("iterate_2", storage, n, [&]() {
+    ecs.View<Position, const Velocity>().Each([](Position& p, const Velocity& v) {
+      p.x += v.x; p.y += v.y; p.z += v.z;
+    });
+    return (u64) n;
+  });
+  measure("iterate_3", storage, n, [&]() {
+    ecs.View<Position, const Velocity, Health>().Each([](Position& p, const Velocity& v, Health& h) {
+      p.x += v.x;
+      h.hp -= 1;
+    });
+    return (u64) n;
+  });
+}
+
+/// Update a scene with a couple of systems on the job system
+static void sceneUpdate(octal::ECS::Storage storage, u32 n) {
+  octal::Scene scene(storage);
+  for (u32 i = 0; i < n; ++i) {
+    octal::Entity e = scene.CreateEntity();
+    e.Emplace<Position>((f32) i, 0.f, 0.f);
+    e.Emplace<Velocity>(1.f, 1.f, 1.f);
+    e.Emplace<Health>((i32) i);
+  }
+  scene.AddSystem<Position, const Velocity>("move", [](f64 dt, Position& p, const Velocity& v) {
+    p.x += v.x * (f32) dt; p.y += v.y * (f32) dt; p.z += v.z * (f32) dt;
+  });
+  scene.AddSystem<Health>("decay", [](f64 dt, Health& h) {
+    h.hp -= 1;
+  });
+  const u32 frames = 10;
+  measure("scene_update", storage, n, [&]() {
+    for (u32 f = 0; f < frames; ++f)
+      scene.Update(1.0 / 60.0);
+    return (u64) n * frames;
+  });
+}
+
+/// Propagate transforms down chains of eight entities, each the child of the one before
+static void hierarchy(octal::ECS::Storage storage, u32 n) {
+  octal::Scene scene(storage);
+  std::vector<octal::Entity> entities;
+  entities.reserve(n);
+  for (u32 i = 0; i < n; ++i) {
+    octal::Entity e = scene.CreateEntity();
+    e.Emplace<octal::Transform>(octal::vec3(1.f, 0.f, 0.f));
+    if (i % 8 != 0)
+      e.SetParent(entities.back());
+    entities.push_back(e);
+  }
+  const u32 frames = 10;
+  measure("hierarchy", storage, n, [&]() {
+    for (u32 f = 0; f < frames; ++f)
+      scene.Update(1.0 / 60.0);
+    g_Sink = (u64) scene.Transforms().World(entities.back().Id())->c[3].x;
+    return (u64) n * frames;
+  });
+}
+
+/// Spawn copies of a prefab, compared with adding each component one by one, then clone the scene
+static void instantiate(octal::ECS::Storage storage, u32 n) {
+  {
+    octal::Scene scene(storage);
+    octal::Entity prefab = scene.CreateEntity();
+    prefab.Emplace<Position>(1.f, 2.f, 3.f);
+    prefab.Emplace<Velocity>(1.f, 1.f, 1.f);
+    prefab.Emplace<Health>(100);
+    measure("instantiate/batch", storage, n, [&]() {
+      g_Sink = g_Sink + scene.Instantiate(prefab, n).size();
+      return (u64) n * 3;
+    });
+    measure("clone", storage, n, [&]() {
+      auto copy = scene.Clone();
+      g_Sink = g_Sink + std::get<0>(*copy->View<const Position>().begin());
+      return (u64) n * 3;
+    });
+  }
+  octal::Scene scene(storage);
+  measure("instantiate/each", storage, n, [&]() {
+    for (u32 i = 0; i < n; ++i) {
+      octal::Entity e = scene.CreateEntity();
+      e.Emplace<Position>(1.f, 2.f, 3.f);
+      e.Emplace<Velocity>(1.f, 1.f, 1.f);
+      e.Emplace<Health>(100);
+    }
+    return (u64) n * 3;
+  });
+}
+
+/// Tag entities, then find the ones with several tags and filter a view on them
+static void tags(octal::ECS::Storage storage, u32 n) {
+  octal::ECS ecs(storage);
+  std::vector<u32> ids(n);
+  measure("tags/add", storage, n, [&]() {
+    for (u32 i = 0; i < n; ++i) {
+      ids[i] = ecs.CreateEntity();
+      ecs.Emplace<Health>(ids[i], (i32) i);
+      if (i % 2 == 0) ecs.Emplace<Enemy>(ids[i]);
+      if (i % 3 == 0) ecs.Emplace<Visible>(ids[i]);
+      if (i % 5 == 0) ecs.Emplace<Dead>(ids[i]);
+    }
+    return (u64) n;
+  });
+  const u32 rounds = 10;
+  measure("tags/each", storage, n, [&]() {
+    u64 sum = 0;
+    for (u32 r = 0; r < rounds; ++r)
+      ecs.EachTagged<Enemy, Visible, Dead>([&](u32 id) { sum += id; });
+    g_Sink = sum;
+    return (u64) n * rounds;
+  });
+  measure("tags/count", storage, n, [&]() {
+    u64 sum = 0;
+    for (u32 r = 0; r < rounds; ++r)
+      sum += ecs.CountTagged<Enemy, Visible>();
+    g_Sink = sum;
+    return (u64) n * rounds;
+  });
+  measure("tags/view", storage, n, [&]() {
+    u64 sum = 0;
+    for (u32 r = 0; r < rounds; ++r) {
+      ecs.View<const Health>().With<Enemy>().Without<Dead>().Each([&](const Health& h) { sum += h.hp; });
+    }
+    g_Sink = sum;
+    return (u64) n * rounds;
+  });
+}
+
+/// How this binary was built, so results from different builds aren't mixed up
+struct BuildConfig {
+  bool optimized;
+  bool release;
+  u32 log_level_max;
+  const char* simd;
+};
+
+static BuildConfig buildConfig() {
+  BuildConfig config{};
+#ifdef __OPTIMIZE__
+  config.optimized = true;
+#endif
+#if RELEASE == 1
+  config.release = true;
+#endif
+  config.log_level_max = LOG_LEVEL_MAX;
+#if defined(MATH_AVX2)
+  config.simd = "avx2";
+#elif defined(MATH_SSE)
+  config.simd = "sse";
+#else
+  config.simd = "scalar";
+#endif
+  return config;
+}
+
+/// Write every result as json
+static bool writeJson(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return false;
+  BuildConfig config = buildConfig();
+  fprintf(f, "{\n  \"build\": {\"optimized\": %s, \"release\": %s, \"log_level_max\": %u, \"simd\": \"%s\"},\n",
+      config.optimized ? "true" : "false", config.release ? "true" : "false", config.log_level_max, config.simd);
+  fprintf(f, "  \"peak_rss_kb\": %llu,\n  \"results\": [\n", (unsigned long long) peakRss());
+  for (size_t i = 0; i < s_Results.size(); ++i) {
+    const Result& r = s_Results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"variant\": \"%s\", \"entities\": %u, \"ops\": %llu, "
+        "\"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"rss_growth_kb\": %lld}%s\n",
+        r.name.c_str(), r.variant.c_str(), r.entities, r.ops, r.ns / r.ops,
+        r.ops / (r.ns * 1e-9), (long long) r.rss_growth_kb, i + 1 < s_Results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  u32 max = 1000000;
+  const char* json = nullptr;
+  const char* filter = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--max") && i + 1 < argc) {
+      max = (u32) strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+      json = argv[++i];
+    } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      filter = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--max N] [--json path] [--filter name]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  struct Scenario {
+    const char* name;
+    void (*run)(octal::ECS::Storage, u32);
+  };
+  const Scenario scenarios[] = {
+    {"create_destroy", createDestroy},
+    {"add_remove", addRemove},
+    {"add_large", addLarge},
+    {"get_random", getRandom},
+    {"iterate", iterate},
+    {"scene_update", sceneUpdate},
+    {"hierarchy", hierarchy},
+    {"instantiate", instantiate},
+    {"tags", tags},
+  };
+
+  BuildConfig config = buildConfig();
+  if (!config.optimized || !config.release)
+    fprintf(stderr, "warning: benchmarks built without optimizations or RELEASE=1, use make bench\n");
+  printf("build: %s, %s, simd %s\n", config.optimized ? "optimized" : "unoptimized",
+      config.release ? "release" : "debug", config.simd);
+
+  // pinned workers keep the numbers from moving around between runs
+  octal::JobSystem::Init(0, true);
+  for (const Scenario& s : scenarios) {
+    if (filter && !strstr(s.name, filter))
+      continue;
+    for (u32 n = 1000; n <= max; n *= 10) {
+      markBaseline();
+      s.run(octal::ECS::Storage::SparseSet, n);
+      markBaseline();
+      s.run(octal::ECS::Storage::Archetype, n);
+    }
+  }
+  if (!filter || strstr("math", filter)) {
+    for (u32 n = 1000; n <= max; n *= 10) {
+      markBaseline();
+      MathBenchmarks(n);
+    }
+  }
+  if (!filter || strstr("spatial", filter)) {
+    for (u32 n = 1000; n <= max; n *= 10) {
+      markBaseline();
+      SpatialBenchmarks(n);
+    }
+  }
+  octal::JobSystem::Shutdown();
+  printf("peak resident memory %llu KB\n", (unsigned long long) peakRss());
+
+  if (json && !writeJson(json)) {
+    fprintf(stderr, "could not write %s\n", json);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <octal/defines.h>
+#include <chrono>
+#include <utility>
+
+/// Stops the compiler from throwing away the work we time
+extern volatile u64 g_Sink;
+
+/// Record the result of a timed section and print it
+/// @param name of the scenario
+/// @param variant of the scenario, like the storage backend or code path
+/// @param n size of the scenario
+/// @param ops operations done in the timed section
+/// @param ns time the section took in nanoseconds
+void Record(const char* name, const char* variant, u32 n, u64 ops, f64 ns);
+
+/// Time a section of a scenario
+/// @param func the work to do, returns the number of operations it did
+template<typename F>
+void Measure(const char* name, const char* variant, u32 n, F&& func) {
+  auto start = std::chrono::steady_clock::now();
+  u64 ops = func();
+  auto end = std::chrono::steady_clock::now();
+  Record(name, variant, n, ops,
+      (f64) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+/// Compare the SIMD math kernels against their scalar versions
+/// @param n number of points, matrices or boxes to work on
+void MathBenchmarks(u32 n);
+
+/// Compare the spatial indices against each other and a brute force scan
+/// @param n number of entities to index
+void SpatialBenchmarks(u32 n);
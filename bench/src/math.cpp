@@ -0,0 +1,82 @@
+#include "bench.h"
+#include <octal/math/batch.h>
+#include <random>
+#include <vector>
+
+using namespace octal;
+
+/// Transform arrays of points by one matrix
+static void transformPoints(u32 n) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<f32> dist(-100.0f, 100.0f);
+  std::vector<f32> x(n), y(n), z(n), ox(n), oy(n), oz(n);
+  for (u32 i = 0; i < n; ++i) {
+    x[i] = dist(rng); y[i] = dist(rng); z[i] = dist(rng);
+  }
+  mat4 m = Compose({1, 2, 3}, AxisAngle(Normalize({1, 1, 0}), 0.5f), vec3(2.0f));
+  const u32 rounds = 10;
+  Measure("math_transform_points", "simd", n, [&]() {
+    for (u32 r = 0; r < rounds; ++r)
+      TransformPoints(m, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), n);
+    g_Sink = (u64) ox[n / 2];
+    return (u64) n * rounds;
+  });
+  Measure("math_transform_points", "scalar", n, [&]() {
+    for (u32 r = 0; r < rounds; ++r)
+      scalar::TransformPoints(m, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), n);
+    g_Sink = (u64) ox[n / 2];
+    return (u64) n * rounds;
+  });
+}
+
+/// Multiply arrays of matrices
+static void mulMatrices(u32 n) {
+  std::vector<mat4> a(n), b(n), out(n);
+  for (u32 i = 0; i < n; ++i) {
+    a[i] = Compose({(f32) i, 0, 0}, AxisAngle({0, 0, 1}, 0.1f * i), vec3(1.0f));
+    b[i] = Translate({0, (f32) i, 0});
+  }
+  Measure("math_mul_matrices", "simd", n, [&]() {
+    MulMatrices(a.data(), b.data(), out.data(), n);
+    g_Sink = (u64) out[n / 2].c[3].x;
+    return (u64) n;
+  });
+  Measure("math_mul_matrices", "scalar", n, [&]() {
+    scalar::MulMatrices(a.data(), b.data(), out.data(), n);
+    g_Sink = (u64) out[n / 2].c[3].x;
+    return (u64) n;
+  });
+}
+
+/// Cull boxes against a frustum eight at a time
+static void cullAABBs(u32 n) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<f32> dist(-2.0f, 2.0f);
+  u32 groups = (n + 7) / 8;
+  std::vector<AABB8> boxes(groups);
+  std::vector<u8> masks(groups);
+  for (u32 g = 0; g < groups; ++g) {
+    for (u32 lane = 0; lane < 8; ++lane) {
+      vec3 c{dist(rng), dist(rng), dist(rng) * 0.25f + 0.5f};
+      boxes[g].Set(lane, {c - vec3(0.1f), c + vec3(0.1f)});
+    }
+  }
+  // clip space box with 0 to 1 depth
+  Frustum f = Frustum::FromMatrix(mat4());
+  Measure("math_cull_aabbs", "simd", n, [&]() {
+    CullAABBs(f, boxes.data(), masks.data(), groups);
+    g_Sink = masks[groups / 2];
+    return (u64) groups * 8;
+  });
+  Measure("math_cull_aabbs", "scalar", n, [&]() {
+    scalar::CullAABBs(f, boxes.data(), masks.data(), groups);
+    g_Sink = masks[groups / 2];
+    return (u64) groups * 8;
+  });
+}
+
+void MathBenchmarks(u32 n) {
+  transformPoints(n);
+  mulMatrices(n);
+  cullAABBs(n);
+}
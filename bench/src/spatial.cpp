@@ -0,0 +1,134 @@
+#include "bench.h"
+#include <octal/spatial/grid.h>
+#include <octal/spatial/bvh.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace octal;
+
+/// Number of queries of each kind timed per index
+static constexpr u32 QUERIES = 10000;
+
+/// Random boxes spread so there are about the same number of entities per unit of volume at every size
+static std::vector<AABB> randomBoxes(u32 n, std::mt19937& rng) {
+  f32 world = std::cbrt((f32) n) * 4.0f;
+  std::uniform_real_distribution<f32> pos(0.0f, world);
+  std::uniform_real_distribution<f32> size(0.1f, 1.0f);
+  std::vector<AABB> boxes(n);
+  for (u32 i = 0; i < n; ++i) {
+    vec3 c{pos(rng), pos(rng), pos(rng)};
+    vec3 e{size(rng), size(rng), size(rng)};
+    boxes[i] = {c - e, c + e};
+  }
+  return boxes;
+}
+
+/// Time one index through build, updates and each kind of query
+static void runIndex(const char* variant, SpatialIndex& index, u32 n) {
+  std::mt19937 rng(1234);
+  std::vector<AABB> boxes = randomBoxes(n, rng);
+  std::vector<u32> ids(n);
+  for (u32 i = 0; i < n; ++i)
+    ids[i] = i + 1;
+  f32 world = std::cbrt((f32) n) * 4.0f;
+  std::uniform_real_distribution<f32> pos(0.0f, world);
+  std::uniform_real_distribution<f32> dir(-1.0f, 1.0f);
+
+  Measure("spatial_build", variant, n, [&]() {
+    index.Build(ids.data(), boxes.data(), n);
+    return (u64) n;
+  });
+
+  // a tenth of the entities move a little, like a frame of gameplay
+  u32 moved = n / 10;
+  std::uniform_int_distribution<u32> pick(0, n - 1);
+  std::vector<u32> which(moved);
+  for (u32& w : which)
+    w = pick(rng);
+  Measure("spatial_update", variant, n, [&]() {
+    for (u32 w : which) {
+      boxes[w].min = boxes[w].min + vec3(0.05f);
+      boxes[w].max = boxes[w].max + vec3(0.05f);
+      index.Update(ids[w], boxes[w]);
+    }
+    return (u64) moved;
+  });
+
+  std::vector<AABB> ranges(QUERIES);
+  std::vector<vec3> points(QUERIES);
+  std::vector<Ray> rays(QUERIES);
+  for (u32 i = 0; i < QUERIES; ++i) {
+    points[i] = {pos(rng), pos(rng), pos(rng)};
+    ranges[i] = {points[i] - vec3(2.0f), points[i] + vec3(2.0f)};
+    rays[i] = {points[i], Normalize(vec3{dir(rng), dir(rng), dir(rng)}), 20.0f};
+  }
+
+  std::vector<u32> out;
+  Measure("spatial_query", variant, n, [&]() {
+    u64 found = 0;
+    for (const AABB& r : ranges) {
+      out.clear();
+      index.Query(r, out);
+      found += out.size();
+    }
+    g_Sink = found;
+    return (u64) QUERIES;
+  });
+  QueryResults results;
+  Measure("spatial_query_batch", variant, n, [&]() {
+    index.QueryBatch(ranges.data(), QUERIES, results);
+    g_Sink = results.ids.size();
+    return (u64) QUERIES;
+  });
+  Measure("spatial_nearest", variant, n, [&]() {
+    u64 found = 0;
+    for (const vec3& p : points) {
+      out.clear();
+      index.Nearest(p, 8, out);
+      found += out[0];
+    }
+    g_Sink = found;
+    return (u64) QUERIES;
+  });
+  Measure("spatial_raycast", variant, n, [&]() {
+    u64 hits = 0;
+    for (const Ray& r : rays)
+      hits += index.Raycast(r).id != 0;
+    g_Sink = hits;
+    return (u64) QUERIES;
+  });
+}
+
+/// Range queries by checking every box, the baseline the indices have to beat
+static void bruteForce(u32 n) {
+  std::mt19937 rng(1234);
+  std::vector<AABB> boxes = randomBoxes(n, rng);
+  f32 world = std::cbrt((f32) n) * 4.0f;
+  std::uniform_real_distribution<f32> pos(0.0f, world);
+  // scanning is slow enough that fewer queries still give a stable time
+  u32 queries = std::max(10u, QUERIES / (n / 1000));
+  std::vector<AABB> ranges(queries);
+  for (AABB& r : ranges) {
+    vec3 p{pos(rng), pos(rng), pos(rng)};
+    r = {p - vec3(2.0f), p + vec3(2.0f)};
+  }
+  Measure("spatial_query", "brute", n, [&]() {
+    u64 found = 0;
+    for (const AABB& r : ranges) {
+      for (const AABB& b : boxes)
+        found += b.Overlaps(r);
+    }
+    g_Sink = found;
+    return (u64) queries;
+  });
+}
+
+void SpatialBenchmarks(u32 n) {
+  LooseGrid grid(4.0f);
+  runIndex("grid", grid, n);
+  DynamicBVH bvh(0.1f);
+  runIndex("bvh", bvh, n);
+  bruteForce(n);
+}
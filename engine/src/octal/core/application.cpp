@@ -1,14 +1,31 @@
 #include "octal/core/logger.h"
 #include "platform/platform.h"
 #include "octal/core/application.h"
+#include "octal/core/jobs.h"
+#include "octal/core/memory.h"
 
 namespace octal {
   Renderer renderer;
-  Application::Application(Config config) { 
+  /// Ticks between frame time reports in the log
+  static constexpr u64 STATS_INTERVAL = 10 * Platform::TICKS_PER_SECOND;
+
+  Application::Application(Config config)
+    : m_Fixed(config.fixed_timestep), m_Pacer(config.target_fps),
+      m_TargetFps(config.target_fps), m_SuspendedFps(config.suspended_fps) { 
+    // write logs on a background thread from here on
+    InitLog(config.log);
     // set state
     m_State.width = config.width;
+    m_State.height = config.height;
+    m_State.is_running = false;
+    m_State.is_suspended = false;
+    m_State.last_time = Platform::AbsoluteTime();
     // start up window
     Platform::Init(config.name, config.x, config.y, config.width, config.height);
+    // start worker threads
+    JobSystem::Init(config.worker_threads);
+    // scratch memory for each worker, reset every frame
+    Memory::Init(config.frame_memory);
 
     if (!renderer.Init()) {
       FATAL("Could not start vulkan :(");
@@ -20,18 +37,70 @@ namespace octal {
 
   void Application::Run() {
     bool quit = false;
+    m_State.is_running = true;
+    m_Timer.Reset();
+    m_Fixed.Reset();
+    m_Pacer.Reset();
+    u64 next_report = m_Timer.Last() + STATS_INTERVAL;
     // main loop
     while (!quit) {
       if (!Platform::Flush()) {
         quit = true;
       }
-      renderer.Draw();
+      f64 dt = m_Timer.Tick();
+      m_State.last_time = (f64) m_Timer.Last() / (f64) Platform::TICKS_PER_SECOND;
+
+      m_Fixed.Advance(m_Timer.DeltaTicks());
+      while (m_Fixed.Step()) {
+        for (Layer* layer : m_LayerStack) {
+          layer->OnFixedUpdate(m_Fixed.StepSize());
+        }
+      }
+      for (Layer* layer : m_LayerStack) {
+        layer->OnUpdate(dt);
+      }
+      // nobody sees a hidden window so don't draw one
+      if (!m_State.is_suspended) {
+        for (Layer* layer : m_LayerStack) {
+          layer->OnRender(dt);
+        }
+        renderer.Draw();
+      }
+      // nothing from this frame is used past here
+      Memory::EndFrame();
+
+      if (m_Timer.Last() >= next_report) {
+        FrameStats stats = m_Timer.Stats();
+        LOG_TO(Core, Debug, "Frame time over %u frames: min %.2fms avg %.2fms p99 %.2fms max %.2fms",
+            stats.frames, stats.min * 1000.0, stats.avg * 1000.0, stats.p99 * 1000.0, stats.max * 1000.0);
+        FrameStats jitter = m_Pacer.Jitter();
+        if (jitter.frames > 0) {
+          LOG_TO(Core, Debug, "Pacing at %.1f fps woke late by avg %.1fus p99 %.1fus max %.1fus",
+              m_Pacer.Target(), jitter.avg * 1e6, jitter.p99 * 1e6, jitter.max * 1e6);
+        }
+        next_report = m_Timer.Last() + STATS_INTERVAL;
+      }
+
+      // drop to a slow cadence while nobody can see us rather than spinning a core
+      bool suspended = Platform::IsSuspended();
+      if (suspended != m_State.is_suspended) {
+        m_State.is_suspended = suspended;
+        m_Pacer.SetTarget(suspended ? m_SuspendedFps : m_TargetFps);
+      }
+      m_Pacer.Wait();
     }
+    m_State.is_running = false;
     renderer.Shutdown();
   }
 
   Application::~Application() {
+    Memory::Shutdown();
+    JobSystem::Shutdown();
     Platform::Shutdown();
+    // everything still queued gets written here
+    ShutdownLog();
+    // anything still live here is a leak, the log writes straight to the console by now
+    Memory::Dump();
   }
 
 }
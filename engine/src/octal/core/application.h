@@ -2,6 +2,8 @@
 #include <string>
 #include "octal/defines.h"
 #include "octal/core/layer.h"
+#include "octal/core/logger.h"
+#include "octal/core/timer.h"
 #include "octal/renderer/renderer.h"
 
 namespace octal {
@@ -20,6 +22,18 @@ namespace octal {
         i16 height{600};
         /// Title for the window
         std::string name{"Test"};
+        /// Number of job system worker threads, 0 for one per remaining core
+        u32 worker_threads{0};
+        /// Bytes of per frame scratch memory each thread starts with
+        u64 frame_memory{1024 * 1024};
+        /// Buffering of the background log writer
+        LogConfig log{};
+        /// Seconds between Layer::OnFixedUpdate calls
+        f64 fixed_timestep{1.0 / 60.0};
+        /// Frames a second to hold the main loop to, 0 to leave it to the renderer
+        f64 target_fps{0.0};
+        /// Frames a second while the window is minimized or hidden
+        f64 suspended_fps{10.0};
       };
 
       /// Create an application
@@ -30,6 +44,13 @@ namespace octal {
       /// Run the application
       void Run();
 
+      /// Times each frame of Run
+      const FrameTimer& Timer() const { return m_Timer; }
+      /// Steps of Layer::OnFixedUpdate, Alpha says how far into the next one a frame is
+      const FixedTimestep& Fixed() const { return m_Fixed; }
+      /// Holds frames to Config::target_fps
+      const FramePacer& Pacer() const { return m_Pacer; }
+
     private:
       /// Stores state for the application
       struct AppState {
@@ -46,6 +67,12 @@ namespace octal {
       };
       /// This application's state
       AppState m_State;
+      FrameTimer m_Timer;
+      FixedTimestep m_Fixed;
+      FramePacer m_Pacer;
+      /// Frames a second to pace to when shown and when suspended
+      f64 m_TargetFps;
+      f64 m_SuspendedFps;
 
     protected:
       /// The layers this application is storing
@@ -0,0 +1,367 @@
+#include "octal/core/jobs.h"
+#include "octal/core/logger.h"
+#include "octal/core/asserts.h"
+#include "platform/platform.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace octal {
+
+  /// A job and the counter to decrement once it has run
+  struct JobEntry {
+    JobSystem::Job job;
+    JobCounter* counter;
+  };
+
+  /// Entries, queues and the job system itself are counted against MemoryTag::Jobs
+  static JobEntry* createEntry(JobSystem::Job&& job, JobCounter* counter) {
+    void* block = Platform::Allocate(sizeof(JobEntry), false, MemoryTag::Jobs);
+    ASSERT(block, "Out of memory");
+    return new (block) JobEntry{std::move(job), counter};
+  }
+
+  static void destroyEntry(JobEntry* e) {
+    e->~JobEntry();
+    Platform::Free(e);
+  }
+
+  /// Chase-Lev work stealing deque
+  /// Only the owning thread may Push and Pop, any thread may Steal.
+  /// See "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al. 2013)
+  class WorkDeque {
+    private:
+      /// Circular buffer of jobs, replaced by a bigger one when full
+      struct Buffer {
+        i64 capacity;
+        std::atomic<JobEntry*>* slots;
+
+        Buffer(i64 cap) : capacity(cap) {
+          slots = (std::atomic<JobEntry*>*) Platform::Allocate(cap * sizeof(std::atomic<JobEntry*>), true, MemoryTag::Jobs);
+          for (i64 i = 0; i < cap; ++i)
+            new (&slots[i]) std::atomic<JobEntry*>(nullptr);
+        }
+        ~Buffer() { Platform::Free(slots); }
+
+        JobEntry* Get(i64 i) { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void Put(i64 i, JobEntry* e) { slots[i & (capacity - 1)].store(e, std::memory_order_relaxed); }
+      };
+
+      /// Next index to steal from
+      alignas(64) std::atomic<i64> m_Top{0};
+      /// Next index to push to
+      alignas(64) std::atomic<i64> m_Bottom{0};
+      /// Current buffer
+      std::atomic<Buffer*> m_Buffer;
+      /// Old buffers that thieves might still be reading, freed with the deque
+      std::vector<Buffer*> m_Retired;
+
+    public:
+      WorkDeque() : m_Buffer(new Buffer(1024)) { }
+      ~WorkDeque() {
+        delete m_Buffer.load();
+        for (Buffer* b : m_Retired)
+          delete b;
+      }
+
+      /// Add a job to the bottom, owner only
+      void Push(JobEntry* e) {
+        i64 b = m_Bottom.load(std::memory_order_relaxed);
+        i64 t = m_Top.load(std::memory_order_acquire);
+        Buffer* buf = m_Buffer.load(std::memory_order_relaxed);
+        // full so double the buffer
+        if (b - t > buf->capacity - 1) {
+          Buffer* bigger = new Buffer(buf->capacity * 2);
+          for (i64 i = t; i < b; ++i)
+            bigger->Put(i, buf->Get(i));
+          m_Retired.push_back(buf);
+          m_Buffer.store(bigger, std::memory_order_release);
+          buf = bigger;
+        }
+        buf->Put(b, e);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_Bottom.store(b + 1, std::memory_order_relaxed);
+      }
+
+      /// Take the newest job from the bottom, owner only
+      JobEntry* Pop() {
+        i64 b = m_Bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = m_Buffer.load(std::memory_order_relaxed);
+        m_Bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 t = m_Top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+          // empty
+          m_Bottom.store(b + 1, std::memory_order_relaxed);
+          return nullptr;
+        }
+        JobEntry* e = buf->Get(b);
+        if (t == b) {
+          // last job so race the thieves for it
+          if (!m_Top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            e = nullptr;
+          }
+          m_Bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return e;
+      }
+
+      /// Take the oldest job from the top, any thread
+      JobEntry* Steal() {
+        i64 t = m_Top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 b = m_Bottom.load(std::memory_order_acquire);
+        if (t >= b)
+          return nullptr;
+        Buffer* buf = m_Buffer.load(std::memory_order_acquire);
+        JobEntry* e = buf->Get(t);
+        // someone else got it first
+        if (!m_Top.compare_exchange_strong(t, t + 1,
+              std::memory_order_seq_cst, std::memory_order_relaxed)) {
+          return nullptr;
+        }
+        return e;
+      }
+  };
+
+  /// Bounded lock-free multi producer multi consumer queue for threads outside the pool
+  /// See Dmitry Vyukov's bounded MPMC queue
+  class InjectQueue {
+    private:
+      static constexpr u64 CAPACITY = 4096;
+
+      struct Cell {
+        std::atomic<u64> sequence;
+        JobEntry* entry;
+      };
+
+      Cell m_Cells[CAPACITY];
+      alignas(64) std::atomic<u64> m_Enqueue{0};
+      alignas(64) std::atomic<u64> m_Dequeue{0};
+
+    public:
+      InjectQueue() {
+        for (u64 i = 0; i < CAPACITY; ++i)
+          m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+
+      /// Add a job
+      /// @return false if the queue is full
+      bool Push(JobEntry* e) {
+        u64 pos = m_Enqueue.load(std::memory_order_relaxed);
+        while (true) {
+          Cell& cell = m_Cells[pos & (CAPACITY - 1)];
+          u64 seq = cell.sequence.load(std::memory_order_acquire);
+          i64 diff = (i64) seq - (i64) pos;
+          if (diff == 0) {
+            if (m_Enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              cell.entry = e;
+              cell.sequence.store(pos + 1, std::memory_order_release);
+              return true;
+            }
+          } else if (diff < 0) {
+            return false;
+          } else {
+            pos = m_Enqueue.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      /// Take a job, null if empty
+      JobEntry* Pop() {
+        u64 pos = m_Dequeue.load(std::memory_order_relaxed);
+        while (true) {
+          Cell& cell = m_Cells[pos & (CAPACITY - 1)];
+          u64 seq = cell.sequence.load(std::memory_order_acquire);
+          i64 diff = (i64) seq - (i64) (pos + 1);
+          if (diff == 0) {
+            if (m_Dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              JobEntry* e = cell.entry;
+              cell.sequence.store(pos + CAPACITY, std::memory_order_release);
+              return e;
+            }
+          } else if (diff < 0) {
+            return nullptr;
+          } else {
+            pos = m_Dequeue.load(std::memory_order_relaxed);
+          }
+        }
+      }
+  };
+
+  /// Everything the job system needs while running
+  struct JobState {
+    /// One deque per worker, index 0 belongs to the thread that called Init
+    std::vector<Scope<WorkDeque>> deques;
+    /// Worker threads, index i runs deque i + 1
+    std::vector<std::thread> threads;
+    /// Jobs from threads outside the pool
+    InjectQueue inject;
+    /// Are the workers still running?
+    std::atomic<bool> running{true};
+    /// Bumped whenever a job is scheduled so sleepers know to look again
+    std::atomic<u64> signal{0};
+    /// Number of workers asleep
+    std::atomic<u32> sleeping{0};
+    /// Lock for sleeping workers
+    std::mutex lock;
+    /// Wakes sleeping workers
+    std::condition_variable wake;
+  };
+
+  /// State of the job system, null if it isn't running
+  static JobState* s_Jobs = nullptr;
+  /// Index of the calling thread's deque, -1 if it isn't a worker
+  static thread_local i32 t_Worker = -1;
+
+  /// Run a job and let its counter know
+  static void run(JobEntry* e) {
+    e->job();
+    if (e->counter)
+      e->counter->fetch_sub(1, std::memory_order_acq_rel);
+    destroyEntry(e);
+  }
+
+  /// Find a job for a worker: its own deque, then the shared queue, then the other workers
+  /// @param idx index of the calling thread's deque or -1
+  static JobEntry* find(i32 idx) {
+    JobEntry* e = nullptr;
+    if (idx >= 0 && (e = s_Jobs->deques[idx]->Pop()))
+      return e;
+    if ((e = s_Jobs->inject.Pop()))
+      return e;
+    u32 count = (u32) s_Jobs->deques.size();
+    u32 start = idx >= 0 ? (u32) idx + 1 : 0;
+    for (u32 i = 0; i < count; ++i) {
+      u32 victim = (start + i) % count;
+      if ((i32) victim == idx)
+        continue;
+      if ((e = s_Jobs->deques[victim]->Steal()))
+        return e;
+    }
+    return nullptr;
+  }
+
+  /// Loop run by each worker thread
+  static void workerLoop(JobState* state, i32 idx, bool pin) {
+    t_Worker = idx;
+    if (pin)
+      Platform::PinThread(idx);
+    u32 idle = 0;
+    while (state->running.load(std::memory_order_acquire)) {
+      u64 seen = state->signal.load(std::memory_order_seq_cst);
+      if (JobEntry* e = find(idx)) {
+        run(e);
+        idle = 0;
+        continue;
+      }
+      // spin for a little bit before giving up the core
+      if (++idle < 64) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> guard(state->lock);
+      state->sleeping.fetch_add(1, std::memory_order_seq_cst);
+      state->wake.wait(guard, [&]() {
+        return state->signal.load(std::memory_order_seq_cst) != seen
+          || !state->running.load(std::memory_order_acquire);
+      });
+      state->sleeping.fetch_sub(1, std::memory_order_seq_cst);
+      idle = 0;
+    }
+  }
+
+  bool JobSystem::Init(u32 threads, bool pin) {
+    if (s_Jobs) {
+      WARN("Job system already running!");
+      return false;
+    }
+    if (threads == 0) {
+      u32 cores = Platform::CoreCount();
+      threads = cores > 1 ? cores - 1 : 0;
+    }
+
+    s_Jobs = new (Platform::Allocate(sizeof(JobState), true, MemoryTag::Jobs)) JobState{};
+    for (u32 i = 0; i <= threads; ++i) {
+      s_Jobs->deques.push_back(CreateScope<WorkDeque>());
+    }
+    // the calling thread is worker 0 but isn't ours to pin, the workers
+    // take the cores after the first so it keeps one to itself
+    t_Worker = 0;
+    for (u32 i = 1; i <= threads; ++i) {
+      s_Jobs->threads.emplace_back(workerLoop, s_Jobs, (i32) i, pin);
+    }
+    INFO("Started job system with %d worker threads", threads);
+    return true;
+  }
+
+  void JobSystem::Shutdown() {
+    if (!s_Jobs)
+      return;
+    {
+      std::lock_guard<std::mutex> guard(s_Jobs->lock);
+      s_Jobs->running.store(false, std::memory_order_release);
+    }
+    s_Jobs->wake.notify_all();
+    for (auto& thread : s_Jobs->threads) {
+      thread.join();
+    }
+    // drop whatever is left
+    while (JobEntry* e = find(0)) {
+      destroyEntry(e);
+    }
+    s_Jobs->~JobState();
+    Platform::Free(s_Jobs);
+    s_Jobs = nullptr;
+    t_Worker = -1;
+  }
+
+  void JobSystem::Schedule(Job job, JobCounter* counter) {
+    if (!s_Jobs) {
+      job();
+      return;
+    }
+    if (counter)
+      counter->fetch_add(1, std::memory_order_relaxed);
+
+    JobEntry* e = createEntry(std::move(job), counter);
+    if (t_Worker >= 0) {
+      s_Jobs->deques[t_Worker]->Push(e);
+    } else {
+      // the shared queue is full so help drain it
+      while (!s_Jobs->inject.Push(e)) {
+        if (JobEntry* other = find(-1))
+          run(other);
+      }
+    }
+
+    s_Jobs->signal.fetch_add(1, std::memory_order_seq_cst);
+    if (s_Jobs->sleeping.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> guard(s_Jobs->lock);
+      s_Jobs->wake.notify_one();
+    }
+  }
+
+  void JobSystem::Wait(JobCounter& counter) {
+    while (counter.load(std::memory_order_acquire) > 0) {
+      // help out instead of blocking
+      JobEntry* e = s_Jobs ? find(t_Worker) : nullptr;
+      if (e) {
+        run(e);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  u32 JobSystem::WorkerCount() {
+    return s_Jobs ? (u32) s_Jobs->deques.size() : 0;
+  }
+
+  i32 JobSystem::WorkerIndex() {
+    return s_Jobs ? t_Worker : -1;
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "octal/defines.h"
+#include <atomic>
+#include <functional>
+
+namespace octal {
+
+  /// Counts jobs that haven't finished yet
+  /// Scheduling a job with a counter increments it and the job decrements it when done
+  using JobCounter = std::atomic<u32>;
+
+  /// Engine wide pool of worker threads that run jobs
+  /// Each worker owns a Chase-Lev deque: it pushes and pops at the bottom
+  /// without locking while idle workers steal from the top. The thread that
+  /// calls Init is worker 0 and helps out whenever it waits on a counter.
+  /// Threads outside the pool submit through a lock-free shared queue.
+  class JobSystem {
+    public:
+      /// Something to do on a worker
+      using Job = std::function<void()>;
+
+      /// Start the worker threads
+      /// @param threads number of workers besides the calling thread, 0 for one per remaining core
+      /// @param pin should each worker be pinned to its own core, the calling thread is left alone
+      /// @return false if the job system was already running
+      API static bool Init(u32 threads = 0, bool pin = false);
+
+      /// Stop and join the workers, jobs that are still queued are dropped
+      API static void Shutdown();
+
+      /// Queue a job to run on the pool
+      /// If the job system isn't running the job is run right away on this thread
+      /// @param job the work to do
+      /// @param counter optional counter to increment now and decrement once the job is done
+      API static void Schedule(Job job, JobCounter* counter = nullptr);
+
+      /// Wait for a counter to reach zero, running jobs on this thread in the meantime
+      /// @param counter to wait on
+      API static void Wait(JobCounter& counter);
+
+      /// Split a range into batches and run them across the pool, returns when all are done
+      /// @param count size of the range
+      /// @param batch how many items each job handles
+      /// @param func called as func(u32 begin, u32 end) for each batch
+      template<typename F>
+      static void ParallelFor(u32 count, u32 batch, F&& func) {
+        if (count == 0)
+          return;
+        if (batch == 0)
+          batch = 1;
+        u32 batches = (count + batch - 1) / batch;
+        // not worth the overhead
+        if (batches == 1 || WorkerCount() <= 1) {
+          func(0, count);
+          return;
+        }
+        JobCounter counter{0};
+        // keep the first batch for ourselves
+        for (u32 b = 1; b < batches; ++b) {
+          u32 begin = b * batch;
+          u32 end = begin + batch < count ? begin + batch : count;
+          Schedule([&func, begin, end]() { func(begin, end); }, &counter);
+        }
+        func(0, batch);
+        Wait(counter);
+      }
+
+      /// Number of threads running jobs including the one that called Init, 0 if not running
+      API static u32 WorkerCount();
+
+      /// Index of the calling thread in the pool, -1 if it isn't part of it
+      API static i32 WorkerIndex();
+  };
+}
@@ -21,6 +21,10 @@ namespace octal {
 			/// Code to run on each update (could be more than once a frame)
 			/// @param dt the time that has passed since the last time this was called
 			virtual void OnUpdate(double dt) {}
+			/// Code to step a simulation, called at a fixed rate before OnUpdate
+			/// Runs zero or more times a frame, see Application::Config::fixed_timestep.
+			/// @param dt the fixed step, the same every call
+			virtual void OnFixedUpdate(double dt) {}
 			/// Rendering code for this layer
 			/// @param dt the time that has passed since the last time this was called
 			virtual void OnRender(double dt) {}
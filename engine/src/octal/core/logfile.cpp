@@ -0,0 +1,180 @@
+#include "octal/core/logfile.h"
+#include "platform/platform.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace octal {
+  /// Bytes of a message entry besides its arguments
+  static constexpr u64 MESSAGE_BYTES = 1 + 1 + 1 + 4 + 4 + 8 + 4;
+  /// Bytes of a format entry besides its characters
+  static constexpr u64 FORMAT_BYTES = 1 + 4 + 4 + 1;
+
+  LogFileWriter::~LogFileWriter() {
+    Close();
+  }
+
+  bool LogFileWriter::Open(const char* path, u64 file_size, u32 file_count) {
+    Close();
+    m_Path = path;
+    // every file must fit the biggest message
+    m_FileSize = std::max<u64>(file_size, 64 * 1024);
+    m_FileCount = file_count;
+    return openFile();
+  }
+
+  void LogFileWriter::Close() {
+    if (!m_Data)
+      return;
+    Platform::CloseMappedFile(m_Path.c_str(), m_Data, m_FileSize, m_Used);
+    m_Data = nullptr;
+    m_Used = 0;
+  }
+
+  bool LogFileWriter::openFile() {
+    m_Data = (u8*) Platform::CreateMappedFile(m_Path.c_str(), m_FileSize);
+    if (!m_Data)
+      return false;
+    LogFileHeader header{};
+    std::memcpy(header.magic, LOG_FILE_MAGIC, sizeof(header.magic));
+    header.version = LOG_FILE_VERSION;
+    header.start_time = Platform::Ticks();
+    header.wall_time = (u64) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::memcpy(m_Data, &header, sizeof(header));
+    m_Used = sizeof(header);
+    m_Formats.clear();
+    return true;
+  }
+
+  bool LogFileWriter::rotate() {
+    Close();
+    if (m_FileCount > 0) {
+      std::string last = m_Path + "." + std::to_string(m_FileCount);
+      std::remove(last.c_str());
+      for (u32 i = m_FileCount - 1; i > 0; --i) {
+        std::string from = m_Path + "." + std::to_string(i);
+        std::string to = m_Path + "." + std::to_string(i + 1);
+        std::rename(from.c_str(), to.c_str());
+      }
+      std::rename(m_Path.c_str(), (m_Path + ".1").c_str());
+    }
+    return openFile();
+  }
+
+  void LogFileWriter::Write(LogLevel level, LogCategory category, u32 thread, u64 time,
+      const char* format, const u8* args, u32 bytes) {
+    if (!m_Data)
+      return;
+    auto it = m_Formats.find(format);
+    u32 len = it == m_Formats.end() ? (u32) strlen(format) : 0;
+    u64 needed = MESSAGE_BYTES + bytes + (it == m_Formats.end() ? FORMAT_BYTES + len : 0);
+    // leave a zero behind the last entry so readers know where to stop
+    if (m_Used + needed + 1 > m_FileSize) {
+      if (!rotate())
+        return;
+      it = m_Formats.end();
+      len = (u32) strlen(format);
+      needed = MESSAGE_BYTES + bytes + FORMAT_BYTES + len;
+      if (m_Used + needed + 1 > m_FileSize)
+        return;
+    }
+
+    auto put = [&](const void* src, u64 n) {
+      std::memcpy(m_Data + m_Used, src, n);
+      m_Used += n;
+    };
+    u32 id;
+    if (it == m_Formats.end()) {
+      id = (u32) m_Formats.size();
+      m_Formats.emplace(format, id);
+      LogEntry entry = LogEntry::Format;
+      put(&entry, 1);
+      put(&id, sizeof(id));
+      put(&len, sizeof(len));
+      put(format, len + 1);
+    } else {
+      id = it->second;
+    }
+    LogEntry entry = LogEntry::Message;
+    u8 lvl = (u8) level;
+    put(&entry, 1);
+    put(&lvl, 1);
+    put(&category, 1);
+    put(&thread, sizeof(thread));
+    put(&id, sizeof(id));
+    put(&time, sizeof(time));
+    put(&bytes, sizeof(bytes));
+    put(args, bytes);
+  }
+
+  LogFileReader::~LogFileReader() {
+    Close();
+  }
+
+  bool LogFileReader::Open(const char* path) {
+    Close();
+    m_Data = (const u8*) Platform::MapFile(path, m_Size);
+    if (!m_Data)
+      return false;
+    const LogFileHeader* header = (const LogFileHeader*) m_Data;
+    if (m_Size < sizeof(LogFileHeader) || std::memcmp(header->magic, LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC)) != 0
+        || header->version != LOG_FILE_VERSION) {
+      Close();
+      return false;
+    }
+    m_Pos = sizeof(LogFileHeader);
+    return true;
+  }
+
+  void LogFileReader::Close() {
+    if (m_Data)
+      Platform::UnmapFile(m_Data, m_Size);
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Pos = 0;
+    m_Formats.clear();
+  }
+
+  bool LogFileReader::Next(Message& msg) {
+    auto take = [&](void* dst, u64 n) {
+      if (m_Pos + n > m_Size)
+        return false;
+      std::memcpy(dst, m_Data + m_Pos, n);
+      m_Pos += n;
+      return true;
+    };
+    while (m_Data) {
+      LogEntry entry = LogEntry::End;
+      if (!take(&entry, 1))
+        return false;
+      if (entry == LogEntry::Format) {
+        u32 id = 0, len = 0;
+        if (!take(&id, sizeof(id)) || !take(&len, sizeof(len)) || m_Pos + len + 1 > m_Size
+            || id != m_Formats.size() || m_Data[m_Pos + len] != '\0')
+          return false;
+        m_Formats.push_back((const char*) m_Data + m_Pos);
+        m_Pos += len + 1;
+        continue;
+      }
+      if (entry != LogEntry::Message)
+        return false;
+      u8 level = 0, category = 0;
+      u32 id = 0;
+      if (!take(&level, 1) || !take(&category, 1) || !take(&msg.thread, sizeof(msg.thread))
+          || !take(&id, sizeof(id)) || !take(&msg.time, sizeof(msg.time)) || !take(&msg.bytes, sizeof(msg.bytes)))
+        return false;
+      if (id >= m_Formats.size() || level > LogLevel::Trace || category >= (u8) LogCategory::Count
+          || m_Pos + msg.bytes > m_Size)
+        return false;
+      msg.level = (LogLevel) level;
+      msg.category = (LogCategory) category;
+      msg.format = m_Formats[id];
+      msg.args = m_Data + m_Pos;
+      m_Pos += msg.bytes;
+      msg.wall_time = Header().wall_time + (msg.time - Header().start_time);
+      return true;
+    }
+    return false;
+  }
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/core/logger.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace octal {
+  /// Start of every binary log file
+  /// The header is followed by entries, each starting with a LogEntry byte. A
+  /// format is written once per file, the first time a message uses it, and
+  /// messages refer to it by id so they only carry their packed arguments.
+  struct LogFileHeader {
+    /// LOG_FILE_MAGIC
+    char magic[8];
+    /// LOG_FILE_VERSION
+    u32 version;
+    u32 reserved;
+    /// Platform::Ticks when the file was started
+    u64 start_time;
+    /// Wall clock time in nanoseconds since the unix epoch at start_time
+    u64 wall_time;
+  };
+
+  static constexpr char LOG_FILE_MAGIC[8] = {'O', 'C', 'T', 'L', 'O', 'G', '\0', '\0'};
+  static constexpr u32 LOG_FILE_VERSION = 1;
+
+  /// Kind of entry in a binary log file
+  /// Format: u32 id, u32 length, the characters and a terminator
+  /// Message: u8 level, u8 category, u32 thread, u32 format id, u64 time, u32 bytes, the arguments
+  enum class LogEntry : u8 {
+    /// Nothing was written past here
+    End = 0,
+    Format,
+    Message,
+  };
+
+  /// Writes messages to rotating binary log files
+  /// Files have a fixed size and are memory mapped. Once one is full it is
+  /// renamed to path.1, path.1 to path.2 and so on, and a new one is started.
+  class LogFileWriter {
+    public:
+      /// Destructor
+      ~LogFileWriter();
+
+      /// Start writing to a file, replacing it
+      /// @param path of the file
+      /// @param file_size bytes of each file
+      /// @param file_count full files to keep besides the one being written
+      /// @return false if the file couldn't be created
+      bool Open(const char* path, u64 file_size, u32 file_count);
+
+      /// Cut the file down to what was written and close it
+      void Close();
+
+      /// Add a message, rotating the files if it doesn't fit
+      /// @param format must outlive the writer, it is written once and then found by address
+      void Write(LogLevel level, LogCategory category, u32 thread, u64 time,
+          const char* format, const u8* args, u32 bytes);
+
+      /// Is a file open?
+      bool IsOpen() const { return m_Data != nullptr; }
+
+    private:
+      /// Create the file at m_Path and write its header
+      bool openFile();
+      /// Move the full file out of the way and start a new one
+      bool rotate();
+
+      std::string m_Path;
+      u64 m_FileSize{0};
+      u32 m_FileCount{0};
+      /// Mapping of the file being written
+      u8* m_Data{nullptr};
+      u64 m_Used{0};
+      /// Id of each format written to the current file
+      std::unordered_map<const char*, u32> m_Formats;
+  };
+
+  /// Reads the messages back out of a binary log file
+  class API LogFileReader {
+    public:
+      /// One message from the file
+      struct Message {
+        /// Platform::Ticks when it was logged
+        u64 time;
+        /// Wall clock time in nanoseconds since the unix epoch
+        u64 wall_time;
+        LogLevel level;
+        LogCategory category;
+        /// Index of the thread that logged it in the order threads first logged
+        u32 thread;
+        const char* format;
+        /// Packed arguments, see FormatLogMessage
+        const u8* args;
+        u32 bytes;
+      };
+
+      /// Destructor
+      ~LogFileReader();
+
+      /// Map a file to read
+      /// @return false if it couldn't be read or isn't a binary log
+      bool Open(const char* path);
+
+      /// Unmap the file
+      void Close();
+
+      /// Read the next message
+      /// @return false once there are no more or the rest of the file is damaged
+      bool Next(Message& msg);
+
+      /// Header of the open file
+      const LogFileHeader& Header() const { return *(const LogFileHeader*) m_Data; }
+
+    private:
+      const u8* m_Data{nullptr};
+      u64 m_Size{0};
+      u64 m_Pos{0};
+      /// Formats seen so far, by id
+      std::vector<const char*> m_Formats;
+  };
+}
@@ -1,54 +1,776 @@
 #include "octal/core/logger.h"
 #include "octal/core/asserts.h"
+#include "octal/core/logfile.h"
 #include "platform/platform.h"
 
-// TODO: remove
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace octal {
+  static const char* s_LevelStrings[6] = {
+    "[Fatal]: ", "[Error]: ", "[Warn]: ",
+    "[Info]: ", "[Debug]: ", "[Trace]: "
+  };
+
   void report_assertion_failure(const char* expr, const char* msg,  const char* file, i32 line) {
     Log(LogLevel::Fatal, "%s:%d assertion: %s failed because: \"%s.\"",
          file, line, expr, msg);
   }
 
-  bool InitLog() {
-    // TODO: create log file
+  /// Read an integer argument as the length modifier says it was passed
+  template<typename T, typename A>
+  static T intArg(char modifier, A& args) {
+    using S = std::conditional_t<std::is_signed_v<T>, signed char, unsigned char>;
+    using H = std::conditional_t<std::is_signed_v<T>, short, unsigned short>;
+    using I = std::conditional_t<std::is_signed_v<T>, int, unsigned int>;
+    using L = std::conditional_t<std::is_signed_v<T>, long, unsigned long>;
+    using Q = std::conditional_t<std::is_signed_v<T>, long long, unsigned long long>;
+    using J = std::conditional_t<std::is_signed_v<T>, intmax_t, uintmax_t>;
+    using Z = std::conditional_t<std::is_signed_v<T>, std::make_signed_t<size_t>, size_t>;
+    switch (modifier) {
+      case 'H': return (T) (S) va_arg(args, I);
+      case 'h': return (T) (H) va_arg(args, I);
+      case 'l': return (T) va_arg(args, L);
+      case 'Q': return (T) va_arg(args, Q);
+      case 'j': return (T) va_arg(args, J);
+      case 'z': return (T) va_arg(args, Z);
+      case 't': return (T) va_arg(args, ptrdiff_t);
+      default: return (T) va_arg(args, I);
+    }
+  }
+
+  /// Bytes a string argument takes once packed
+  static u32 stringBytes(u32 len) {
+    return (u32) sizeof(u32) + len + 1;
+  }
+
+  /// Copy the arguments of a format into a buffer
+  /// Run once without out to measure and once to write. Strings are cut short
+  /// so the total stays under limit.
+  /// @return bytes taken
+  template<bool WRITE>
+  static u32 packArgs(const char* fmt, va_list args, u8* out, u32 limit) {
+    u32 used = 0;
+    auto put = [&](const void* src, u32 bytes) {
+      if constexpr (WRITE)
+        std::memcpy(out + used, src, bytes);
+      used += bytes;
+    };
+    FormatSpec spec;
+    while (NextFormatSpec(fmt, spec)) {
+      fmt = spec.end;
+      if (used + 2 * sizeof(i64) + sizeof(long double) + stringBytes(0) > limit)
+        break;
+      for (u8 s = 0; s < spec.stars; ++s) {
+        i64 star = va_arg(args, int);
+        put(&star, sizeof(star));
+        // a negative precision counts as none
+        if (spec.star_precision && s + 1 == spec.stars)
+          spec.precision = star >= 0 ? (i32) star : -1;
+      }
+      switch (spec.kind) {
+        case ArgKind::None:
+          break;
+        case ArgKind::Signed: {
+          i64 v = intArg<i64>(spec.modifier, args);
+          put(&v, sizeof(v));
+          break;
+        }
+        case ArgKind::Unsigned: {
+          u64 v = intArg<u64>(spec.modifier, args);
+          put(&v, sizeof(v));
+          break;
+        }
+        case ArgKind::Double: {
+          f64 v = va_arg(args, f64);
+          put(&v, sizeof(v));
+          break;
+        }
+        case ArgKind::LongDouble: {
+          long double v = va_arg(args, long double);
+          put(&v, sizeof(v));
+          break;
+        }
+        case ArgKind::String: {
+          const char* str = va_arg(args, const char*);
+          if (!str)
+            str = "(null)";
+          // a precision means the string doesn't need a terminator
+          u32 len = (u32) (spec.precision >= 0 ? strnlen(str, spec.precision) : strlen(str));
+          len = std::min(len, limit - used - stringBytes(0));
+          put(&len, sizeof(len));
+          put(str, len);
+          put("", 1);
+          break;
+        }
+        case ArgKind::Pointer: {
+          u64 v = (u64) (uintptr_t) va_arg(args, void*);
+          put(&v, sizeof(v));
+          break;
+        }
+        case ArgKind::Skip:
+          va_arg(args, void*);
+          break;
+        case ArgKind::Star:
+          break;
+      }
+    }
+    return used;
+  }
+
+  /// Text being collected by the writer
+  /// Runs of messages at the same level are written with one call.
+  class LogOutput {
+    public:
+      /// Constructor
+      /// @param capacity bytes collected before writing
+      /// @param grow keep everything instead of writing it out, see Take
+      LogOutput(u32 capacity, bool grow = false) : m_Data(capacity), m_Grow(grow) {}
+
+      /// Start a message, writing out what we have if the level changes
+      void Begin(u8 level) {
+        if (level != m_Level)
+          Write();
+        m_Level = level;
+      }
+
+      /// Append text, cut short if a single message is longer than the buffer
+      void Append(const char* text, u64 len) {
+        while (len > 0) {
+          u64 room = m_Data.size() - 1 - m_Used;
+          if (room == 0) {
+            if (m_Grow)
+              m_Data.resize(m_Data.size() * 2);
+            else
+              Write();
+            room = m_Data.size() - 1 - m_Used;
+          }
+          u64 n = std::min(len, room);
+          std::memcpy(m_Data.data() + m_Used, text, n);
+          m_Used += n;
+          text += n;
+          len -= n;
+        }
+      }
+
+      /// snprintf onto the end
+      template<typename... Args>
+      void Format(const char* spec, Args... args) {
+        u64 room = m_Data.size() - m_Used;
+        i32 n = snprintf(m_Data.data() + m_Used, room, spec, args...);
+        if (n < 0)
+          return;
+        if ((u64) n >= room && m_Grow) {
+          m_Data.resize(m_Used + n + 1);
+          room = m_Data.size() - m_Used;
+          n = snprintf(m_Data.data() + m_Used, room, spec, args...);
+        } else if ((u64) n >= room && m_Used > 0) {
+          Write();
+          room = m_Data.size();
+          n = snprintf(m_Data.data(), room, spec, args...);
+        }
+        m_Used += std::min<u64>(n, room - 1);
+      }
+
+      /// Write out everything collected
+      void Write() {
+        if (m_Used == 0)
+          return;
+        m_Data[m_Used] = '\0';
+        Platform::WriteError(m_Data.data(), m_Level);
+        m_Used = 0;
+      }
+
+      /// Everything collected when growing
+      std::string Take() {
+        std::string text(m_Data.data(), m_Used);
+        m_Used = 0;
+        return text;
+      }
+
+    private:
+      std::vector<char> m_Data;
+      u64 m_Used{0};
+      u8 m_Level{0};
+      bool m_Grow;
+  };
+
+  /// snprintf one value with the '*' arguments in front of it
+  template<typename T>
+  static void formatValue(LogOutput& out, const char* spec, const i64* stars, u8 count, T value) {
+    switch (count) {
+      case 0: out.Format(spec, value); break;
+      case 1: out.Format(spec, (int) stars[0], value); break;
+      default: out.Format(spec, (int) stars[0], (int) stars[1], value); break;
+    }
+  }
+
+  /// Format a message from the arguments packed by packArgs
+  static void formatArgs(LogOutput& out, const char* fmt, const u8* args, const u8* end) {
+    FormatSpec spec;
+    auto take = [&](void* dst, u32 bytes) {
+      if (args + bytes > end)
+        return false;
+      std::memcpy(dst, args, bytes);
+      args += bytes;
+      return true;
+    };
+    while (NextFormatSpec(fmt, spec)) {
+      out.Append(fmt, spec.begin - fmt);
+      fmt = spec.end;
+      if (spec.kind == ArgKind::None) {
+        // %% prints one, unknown conversions are printed as they are and a lone % at the end not at all
+        if (spec.end - spec.begin > 1)
+          out.Append(spec.end[-1] == '%' ? "%" : spec.begin, spec.end[-1] == '%' ? 1 : spec.end - spec.begin);
+        continue;
+      }
+      if (spec.kind == ArgKind::Skip)
+        continue;
+      i64 stars[2] = {0, 0};
+      bool ok = true;
+      for (u8 s = 0; s < spec.stars; ++s)
+        ok = ok && take(&stars[s], sizeof(i64));
+      // rebuild the spec for the type the argument was stored as
+      char conv[64];
+      u64 prefix = std::min<u64>(spec.length - spec.begin, sizeof(conv) - 4);
+      std::memcpy(conv, spec.begin, prefix);
+      char* suffix = conv + prefix;
+      char c = spec.end[-1];
+      switch (spec.kind) {
+        case ArgKind::Signed:
+        case ArgKind::Unsigned: {
+          u64 v = 0;
+          ok = ok && take(&v, sizeof(v));
+          if (!ok)
+            break;
+          if (c == 'c') {
+            *suffix++ = c;
+            *suffix = '\0';
+            formatValue(out, conv, stars, spec.stars, (int) v);
+          } else {
+            *suffix++ = 'l';
+            *suffix++ = 'l';
+            *suffix++ = c;
+            *suffix = '\0';
+            if (spec.kind == ArgKind::Signed)
+              formatValue(out, conv, stars, spec.stars, (long long) v);
+            else
+              formatValue(out, conv, stars, spec.stars, (unsigned long long) v);
+          }
+          break;
+        }
+        case ArgKind::Double: {
+          f64 v = 0;
+          ok = ok && take(&v, sizeof(v));
+          if (!ok)
+            break;
+          *suffix++ = c;
+          *suffix = '\0';
+          formatValue(out, conv, stars, spec.stars, v);
+          break;
+        }
+        case ArgKind::LongDouble: {
+          long double v = 0;
+          ok = ok && take(&v, sizeof(v));
+          if (!ok)
+            break;
+          *suffix++ = 'L';
+          *suffix++ = c;
+          *suffix = '\0';
+          formatValue(out, conv, stars, spec.stars, v);
+          break;
+        }
+        case ArgKind::String: {
+          u32 len = 0;
+          ok = ok && take(&len, sizeof(len)) && args + len + 1 <= end;
+          if (!ok)
+            break;
+          *suffix++ = 's';
+          *suffix = '\0';
+          formatValue(out, conv, stars, spec.stars, (const char*) args);
+          args += len + 1;
+          break;
+        }
+        case ArgKind::Pointer: {
+          u64 v = 0;
+          ok = ok && take(&v, sizeof(v));
+          if (!ok)
+            break;
+          *suffix++ = 'p';
+          *suffix = '\0';
+          formatValue(out, conv, stars, spec.stars, (void*) (uintptr_t) v);
+          break;
+        }
+        default:
+          break;
+      }
+      // arguments were cut off, show the rest of the format as it is
+      if (!ok) {
+        out.Append(spec.begin, strlen(spec.begin));
+        return;
+      }
+    }
+    out.Append(fmt, strlen(fmt));
+  }
+
+  std::string FormatLogMessage(const char* format, const u8* args, u32 bytes) {
+    LogOutput out(256, true);
+    formatArgs(out, format, args, args + bytes);
+    return out.Take();
+  }
+
+  const char* LogLevelName(LogLevel level) {
+    switch (level) {
+      case LogLevel::Fatal: return "Fatal";
+      case LogLevel::Error: return "Error";
+      case LogLevel::Warn: return "Warn";
+      case LogLevel::Info: return "Info";
+      case LogLevel::Debug: return "Debug";
+      case LogLevel::Trace: return "Trace";
+      default: return "?";
+    }
+  }
+
+  /// Header of every message in a ring, followed by its packed arguments
+  struct LogRecord {
+    /// Bytes taken in the ring including this header, a multiple of 8
+    u32 size;
+    /// LogLevel, or WRAP for padding up to the end of the ring
+    u8 level;
+    /// LogCategory
+    u8 category;
+    /// Platform::Ticks when logged, to put the threads back in order
+    u64 time;
+    /// Format the arguments go with
+    const char* format;
+  };
+
+  /// Level of the padding record at the end of a ring
+  static constexpr u8 WRAP = 0xFF;
+
+  /// Single producer single consumer byte ring owned by one logging thread
+  struct LogRing {
+    /// Messages, capacity bytes
+    u8* data;
+    u64 capacity;
+    /// Written by the owning thread
+    alignas(64) std::atomic<u64> head{0};
+    /// The owner's last look at tail so it doesn't touch the writer's line every message
+    u64 cached_tail{0};
+    /// Head past which the owner may wake the writer again
+    u64 next_nudge{0};
+    /// Written by the writer thread
+    alignas(64) std::atomic<u64> tail{0};
+    /// Messages that didn't fit
+    std::atomic<u64> dropped{0};
+    /// Set once the owning thread exits, the writer frees the ring once drained
+    std::atomic<bool> orphaned{false};
+    /// Index of the owning thread in the binary log
+    u32 thread{0};
+  };
+
+  /// Everything the writer needs while running
+  struct LogState {
+    LogConfig config;
+    /// Every thread's ring, guarded by lock
+    std::vector<LogRing*> rings;
+    std::mutex lock;
+    /// Wakes the writer and those waiting on a flush
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    /// Flushes asked for and done
+    std::atomic<u64> flush_requested{0};
+    std::atomic<u64> flush_done{0};
+    std::atomic<bool> running{true};
+    std::thread writer;
+    /// Binary log, guarded by file_lock
+    LogFileWriter file;
+    std::mutex file_lock;
+    /// Threads given an index so far, the writer is 0
+    u32 threads{1};
+  };
+
+  /// Message waiting to be written by the writer
+  struct PendingRecord {
+    const LogRecord* record;
+    u32 thread;
+  };
+
+  /// State of the writer, null when messages are written right away
+  static std::atomic<LogState*> s_Log{nullptr};
+  /// Bumped on every InitLog so threads know their ring is from an old log
+  static std::atomic<u32> s_Generation{0};
+  /// Is the calling thread the writer?
+  static thread_local bool t_Writer = false;
+
+  /// The calling thread's ring
+  struct ThreadRing {
+    LogRing* ring{nullptr};
+    u32 generation{0};
+
+    ~ThreadRing() {
+      LogState* log = s_Log.load(std::memory_order_acquire);
+      if (ring && log && generation == s_Generation.load(std::memory_order_acquire))
+        ring->orphaned.store(true, std::memory_order_release);
+    }
+  };
+  static thread_local ThreadRing t_Ring;
+
+  static u64 now() {
+    return Platform::Ticks();
+  }
+
+  /// Get the calling thread's ring, making one on first use
+  static LogRing* threadRing(LogState* log) {
+    u32 generation = s_Generation.load(std::memory_order_acquire);
+    if (t_Ring.ring && t_Ring.generation == generation)
+      return t_Ring.ring;
+    LogRing* ring = new LogRing();
+    ring->capacity = log->config.buffer_size;
+    ring->data = (u8*) Platform::Allocate(ring->capacity, true, MemoryTag::Logger);
+    {
+      std::lock_guard<std::mutex> guard(log->lock);
+      ring->thread = log->threads++;
+      log->rings.push_back(ring);
+    }
+    t_Ring.ring = ring;
+    t_Ring.generation = generation;
+    return ring;
+  }
+
+  static void freeRing(LogRing* ring) {
+    Platform::Free(ring->data);
+    delete ring;
+  }
+
+  /// Make room for a message, padding to the end of the ring if it doesn't fit before it
+  /// @return where to write the message or null if it was dropped
+  static u8* reserve(LogState* log, LogRing* ring, u32 size) {
+    u64 head = ring->head.load(std::memory_order_relaxed);
+    u64 offset = head & (ring->capacity - 1);
+    u64 contiguous = ring->capacity - offset;
+    u64 needed = size <= contiguous ? size : contiguous + size;
+    while (head + needed - ring->cached_tail > ring->capacity) {
+      ring->cached_tail = ring->tail.load(std::memory_order_acquire);
+      if (head + needed - ring->cached_tail <= ring->capacity)
+        break;
+      if (log->config.overflow == LogOverflow::Drop) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      log->wake.notify_one();
+      std::this_thread::yield();
+    }
+    if (size > contiguous) {
+      LogRecord* pad = (LogRecord*) (ring->data + offset);
+      pad->size = (u32) contiguous;
+      pad->level = WRAP;
+      head += contiguous;
+      ring->head.store(head, std::memory_order_release);
+    }
+    // give the writer a nudge once it falls behind, waking it is a syscall so not every message
+    if (head >= ring->next_nudge && head + size - ring->cached_tail > ring->capacity / 2) {
+      ring->cached_tail = ring->tail.load(std::memory_order_acquire);
+      if (head + size - ring->cached_tail > ring->capacity / 2) {
+        log->wake.notify_one();
+        ring->next_nudge = head + ring->capacity / 8;
+      }
+    }
+    return ring->data + (head & (ring->capacity - 1));
+  }
+
+  /// Format one message as a line
+  static void formatRecord(LogOutput& out, const LogRecord* record) {
+    out.Begin(record->level);
+    out.Append(s_LevelStrings[record->level], strlen(s_LevelStrings[record->level]));
+    const u8* args = (const u8*) (record + 1);
+    formatArgs(out, record->format, args, (const u8*) record + record->size);
+    out.Append("\n", 1);
+  }
+
+  /// Add one message to the binary log
+  static void writeRecord(LogFileWriter& file, const LogRecord* record, u32 thread) {
+    const u8* args = (const u8*) (record + 1);
+    file.Write((LogLevel) record->level, (LogCategory) record->category, thread, record->time,
+        record->format, args, record->size - sizeof(LogRecord));
+  }
+
+  /// Write out everything queued in every ring
+  /// @param log the writer's state
+  /// @param out where to collect the text
+  /// @param pending, rings, heads scratch space kept between calls
+  static void drain(LogState* log, LogOutput& out, std::vector<PendingRecord>& pending,
+      std::vector<LogRing*>& rings, std::vector<u64>& heads) {
+    {
+      std::lock_guard<std::mutex> guard(log->lock);
+      rings = log->rings;
+    }
+    pending.clear();
+    heads.resize(rings.size());
+    u64 orphans = 0;
+    for (u64 i = 0; i < rings.size(); ++i) {
+      LogRing* ring = rings[i];
+      // the thread is done with the ring if it said so before we look at head
+      if (ring->orphaned.load(std::memory_order_acquire))
+        ++orphans;
+      u64 head = ring->head.load(std::memory_order_acquire);
+      u64 pos = ring->tail.load(std::memory_order_relaxed);
+      while (pos != head) {
+        const LogRecord* record = (const LogRecord*) (ring->data + (pos & (ring->capacity - 1)));
+        if (record->level != WRAP)
+          pending.push_back({record, ring->thread});
+        pos += record->size;
+      }
+      heads[i] = head;
+    }
+
+    // each ring is in order already, merge them by time
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingRecord& a, const PendingRecord& b) {
+      return a.record->time < b.record->time;
+    });
+    bool console = log->config.sink != LogSink::Binary;
+    if (console) {
+      for (const PendingRecord& p : pending) {
+        formatRecord(out, p.record);
+      }
+      out.Write();
+    }
+    if (log->config.sink != LogSink::Console) {
+      std::lock_guard<std::mutex> guard(log->file_lock);
+      for (const PendingRecord& p : pending) {
+        writeRecord(log->file, p.record, p.thread);
+      }
+    }
+
+    u64 dropped = 0;
+    for (u64 i = 0; i < rings.size(); ++i) {
+      rings[i]->tail.store(heads[i], std::memory_order_release);
+      dropped += rings[i]->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    if (dropped > 0) {
+      static const char* format = "Dropped %llu log messages, the log buffers were full";
+      if (console) {
+        out.Begin(LogLevel::Warn);
+        out.Append(s_LevelStrings[LogLevel::Warn], strlen(s_LevelStrings[LogLevel::Warn]));
+        out.Format(format, dropped);
+        out.Append("\n", 1);
+        out.Write();
+      }
+      if (log->config.sink != LogSink::Console) {
+        std::lock_guard<std::mutex> guard(log->file_lock);
+        log->file.Write(LogLevel::Warn, LogCategory::Core, 0, now(), format, (const u8*) &dropped, sizeof(dropped));
+      }
+    }
+
+    if (orphans > 0) {
+      std::lock_guard<std::mutex> guard(log->lock);
+      std::erase_if(log->rings, [&](LogRing* ring) {
+        bool done = ring->orphaned.load(std::memory_order_acquire)
+          && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+        if (done)
+          freeRing(ring);
+        return done;
+      });
+    }
+  }
+
+  /// Loop run by the writer thread
+  static void writerLoop(LogState* log) {
+    t_Writer = true;
+    LogOutput out(64 * 1024);
+    std::vector<PendingRecord> pending;
+    std::vector<LogRing*> rings;
+    std::vector<u64> heads;
+    while (true) {
+      bool running = log->running.load(std::memory_order_acquire);
+      u64 requested = log->flush_requested.load(std::memory_order_acquire);
+      drain(log, out, pending, rings, heads);
+      if (requested != log->flush_done.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(log->lock);
+        log->flush_done.store(requested, std::memory_order_release);
+        log->flushed.notify_all();
+      }
+      if (!running)
+        break;
+      // messages are written in batches every couple of milliseconds unless someone asks sooner
+      std::unique_lock<std::mutex> guard(log->lock);
+      log->wake.wait_for(guard, std::chrono::milliseconds(2), [&]() {
+        return !log->running.load(std::memory_order_acquire)
+          || log->flush_requested.load(std::memory_order_acquire) != requested;
+      });
+    }
+  }
+
+  bool InitLog(const LogConfig& config) {
+    if (s_Log.load(std::memory_order_acquire))
+      return false;
+    LogState* log = new LogState();
+    log->config = config;
+    // a ring must fit a few of the biggest messages
+    u32 size = 32 * 1024;
+    while (size < config.buffer_size)
+      size *= 2;
+    log->config.buffer_size = size;
+    bool file_failed = false;
+    if (config.sink != LogSink::Console && !log->file.Open(config.path, config.file_size, config.file_count)) {
+      log->config.sink = LogSink::Console;
+      file_failed = true;
+    }
+    s_Generation.fetch_add(1, std::memory_order_acq_rel);
+    log->writer = std::thread(writerLoop, log);
+    s_Log.store(log, std::memory_order_release);
+    if (file_failed)
+      WARN("Couldn't create log file %s, logging to the console instead", config.path);
     return true;
   }
 
   void ShutdownLog() {
-    // TODO: cleanup and shit
+    LogState* log = s_Log.exchange(nullptr, std::memory_order_acq_rel);
+    if (!log)
+      return;
+    {
+      std::lock_guard<std::mutex> guard(log->lock);
+      log->running.store(false, std::memory_order_release);
+    }
+    log->wake.notify_all();
+    // the writer drains everything once more on the way out
+    log->writer.join();
+    for (LogRing* ring : log->rings) {
+      freeRing(ring);
+    }
+    log->file.Close();
+    delete log;
   }
 
-  void Log(LogLevel lvl, const char* msg, ...) {
-    const char* lvl_string[6] = {
-      "[Fatal]: ", "[Error]: ", "[Warn]: ",
-      "[Info]: ", "[Debug]: ", "[Trace]: "
-    };
+  void FlushLog() {
+    LogState* log = s_Log.load(std::memory_order_acquire);
+    if (!log || t_Writer)
+      return;
+    std::unique_lock<std::mutex> guard(log->lock);
+    u64 request = log->flush_requested.fetch_add(1, std::memory_order_acq_rel) + 1;
+    log->wake.notify_one();
+    log->flushed.wait(guard, [&]() {
+      return log->flush_done.load(std::memory_order_acquire) >= request;
+    });
+  }
 
-    // error is lvl is less than 2
-    bool is_err = lvl < 2;
+  /// Message the calling thread is between LogBegin and LogEnd on
+  struct PendingLog {
+    /// Ring the message is in, null if it is written by LogEnd
+    LogRing* ring{nullptr};
+    LogRecord* record{nullptr};
+    /// Holds messages that are written right away
+    std::vector<u8> scratch;
+  };
+  static thread_local PendingLog t_Pending;
 
-    // store the output in a buffer because faster
-    // 32k limit on log entry
-    char out_buff[32000];
-    char out_msg[32000];
-    // reset to 0
-    std::memset(out_msg, 0, sizeof(out_msg));
+  u8* LogBegin(LogLevel level, LogCategory category, const char* format, u32 bytes) {
+    u32 size = (u32) ((sizeof(LogRecord) + bytes + 7) & ~7ull);
+    LogState* log = s_Log.load(std::memory_order_acquire);
+    u8* slot;
+    if (!log || t_Writer || level == LogLevel::Fatal) {
+      // whatever came before a fatal error should be seen before it
+      if (level == LogLevel::Fatal)
+        FlushLog();
+      t_Pending.scratch.resize(size);
+      slot = t_Pending.scratch.data();
+      t_Pending.ring = nullptr;
+    } else {
+      LogRing* ring = threadRing(log);
+      slot = reserve(log, ring, size);
+      if (!slot)
+        return nullptr;
+      t_Pending.ring = ring;
+    }
+    LogRecord* record = (LogRecord*) slot;
+    record->size = size;
+    record->level = (u8) level;
+    record->category = (u8) category;
+    record->time = now();
+    record->format = format;
+    t_Pending.record = record;
+    return slot + sizeof(LogRecord);
+  }
 
-    // put our arguments into the buffer
-    __builtin_va_list arg_ptr;
-    va_start(arg_ptr, msg);
-    vsnprintf(out_msg, 32000, msg, arg_ptr);
-    va_end(arg_ptr);
+  void LogEnd() {
+    LogRing* ring = t_Pending.ring;
+    if (!ring) {
+      LogState* log = s_Log.load(std::memory_order_acquire);
+      LogSink sink = log ? log->config.sink : LogSink::Console;
+      // the writer holds file_lock while draining so its own messages only go to the console
+      bool binary = sink != LogSink::Console && !t_Writer;
+      if (!binary || sink != LogSink::Binary || t_Pending.record->level == LogLevel::Fatal) {
+        // big enough for any one argument to be formatted whole
+        static thread_local LogOutput out(2 * LOG_MAX_ARG_BYTES);
+        formatRecord(out, t_Pending.record);
+        out.Write();
+      }
+      if (binary) {
+        u32 thread = threadRing(log)->thread;
+        std::lock_guard<std::mutex> guard(log->file_lock);
+        writeRecord(log->file, t_Pending.record, thread);
+      }
+      return;
+    }
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + t_Pending.record->size,
+        std::memory_order_release);
+  }
 
-    sprintf(out_buff, "%s%s\n", lvl_string[lvl], out_msg);
+  void Log(LogLevel lvl, const char* msg, ...) {
+    va_list args;
+    va_start(args, msg);
+    va_list measure;
+    va_copy(measure, args);
+    u32 bytes = packArgs<false>(msg, measure, nullptr, LOG_MAX_ARG_BYTES);
+    va_end(measure);
+    if (u8* out = LogBegin(lvl, LogCategory::General, msg, bytes)) {
+      packArgs<true>(msg, args, out, LOG_MAX_ARG_BYTES);
+      LogEnd();
+    }
+    va_end(args);
+  }
 
-    // TODO: platform specific
-    Platform::WriteError(out_buff, lvl);
+  /// Runtime level of each category
+  static std::atomic<u8> s_Levels[(u32) LogCategory::Count] = {
+    LOG_LEVEL_MAX, LOG_LEVEL_MAX, LOG_LEVEL_MAX, LOG_LEVEL_MAX, LOG_LEVEL_MAX, LOG_LEVEL_MAX,
+  };
+  static_assert((u32) LogCategory::Count == 6, "Give the new category a level");
+
+  LogLevel GetLogLevel(LogCategory category) {
+    return (LogLevel) s_Levels[(u32) category].load(std::memory_order_relaxed);
+  }
 
+  void SetLogLevel(LogCategory category, LogLevel level) {
+    s_Levels[(u32) category].store((u8) level, std::memory_order_relaxed);
   }
 
+  void SetLogLevel(LogLevel level) {
+    for (auto& l : s_Levels) {
+      l.store((u8) level, std::memory_order_relaxed);
+    }
+  }
+
+  const char* LogCategoryName(LogCategory category) {
+    switch (category) {
+      case LogCategory::General: return "General";
+      case LogCategory::Core: return "Core";
+      case LogCategory::ECS: return "ECS";
+      case LogCategory::Renderer: return "Renderer";
+      case LogCategory::Platform: return "Platform";
+      case LogCategory::Game: return "Game";
+      default: return "?";
+    }
+  }
 }
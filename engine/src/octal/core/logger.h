@@ -1,51 +1,73 @@
 #pragma once
 #include "octal/defines.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace octal {
-#define LOG_WARN_ENABLED 1
-#define LOG_INFO_ENABLED 1
-#define LOG_DEBUG_ENABLED 1
-#define LOG_TRACE_ENABLED 1
-
+  /// Most verbose level compiled in, messages past it compile to nothing
+  /// 0 only keeps Fatal, 5 keeps everything up to Trace. Define it before
+  /// including this to override.
+#ifndef LOG_LEVEL_MAX
 #if RELEASE == 1
-#define LOG_DEBUG_ENABLED 0
-#define LOG_TRACE_ENABLED 0
+#define LOG_LEVEL_MAX 3
+#else
+#define LOG_LEVEL_MAX 5
 #endif
+#endif
+
+#define LOG_WARN_ENABLED (LOG_LEVEL_MAX >= 2)
+#define LOG_INFO_ENABLED (LOG_LEVEL_MAX >= 3)
+#define LOG_DEBUG_ENABLED (LOG_LEVEL_MAX >= 4)
+#define LOG_TRACE_ENABLED (LOG_LEVEL_MAX >= 5)
+
+  /// Log to a category at a level, e.g. LOG_TO(ECS, Debug, "entity %d", id);
+  /// Levels past LOG_LEVEL_MAX are discarded at compile time and the arguments
+  /// are only evaluated when the category's runtime level lets the message through.
+#define LOG_TO(category, level, msg, ...)                                                \
+  do {                                                                                   \
+    if constexpr (octal::LogLevel::level <= LOG_LEVEL_MAX) {                             \
+      if (octal::LogLevel::level <= octal::GetLogLevel(octal::LogCategory::category))    \
+        octal::Log(octal::LogLevel::level, octal::LogCategory::category, msg, ##__VA_ARGS__); \
+    }                                                                                    \
+  } while (0)
 
   /// Log a fatal error
 #ifndef FATAL
-#define FATAL(msg, ...) Log(octal::LogLevel::Fatal, msg, ##__VA_ARGS__);
+#define FATAL(msg, ...) LOG_TO(General, Fatal, msg, ##__VA_ARGS__);
 #endif
 
   /// Log an error
 #ifndef ERROR
-#define ERROR(msg, ...) Log(octal::LogLevel::Error, msg, ##__VA_ARGS__);
+#define ERROR(msg, ...) LOG_TO(General, Error, msg, ##__VA_ARGS__);
 #endif
 
-#if LOG_WARN_ENABLED == 1
+#if LOG_WARN_ENABLED
   /// warn the user of something non-fatal
-#define WARN(msg, ...) Log(octal::LogLevel::Warn, msg, ##__VA_ARGS__);
+#define WARN(msg, ...) LOG_TO(General, Warn, msg, ##__VA_ARGS__);
 #else
 #define WARN(msg, ...)
 #endif
 
-#if LOG_INFO_ENABLED == 1
+#if LOG_INFO_ENABLED
   /// general info logging
-#define INFO(msg, ...) Log(octal::LogLevel::Info, msg, ##__VA_ARGS__);
+#define INFO(msg, ...) LOG_TO(General, Info, msg, ##__VA_ARGS__);
 #else
 #define INFO(msg, ...)
 #endif
 
-#if LOG_DEBUG_ENABLED == 1
+#if LOG_DEBUG_ENABLED
   /// logging for debug purposes
-#define DEBUG(msg, ...) Log(octal::LogLevel::Debug, msg, ##__VA_ARGS__);
+#define DEBUG(msg, ...) LOG_TO(General, Debug, msg, ##__VA_ARGS__);
 #else
 #define DEBUG(msg, ...)
 #endif
 
-#if LOG_TRACE_ENABLED == 1
+#if LOG_TRACE_ENABLED
   /// logging for tracing stuff
-#define TRACE(msg, ...) Log(octal::LogLevel::Trace, msg, ##__VA_ARGS__);
+#define TRACE(msg, ...) LOG_TO(General, Trace, msg, ##__VA_ARGS__);
 #else
 #define TRACE(msg, ...)
 #endif
@@ -61,14 +83,401 @@ namespace octal {
     Trace,
   };
 
+  /// Part of the engine a message comes from, each has its own runtime level
+  enum class LogCategory : u8 {
+    General,
+    Core,
+    ECS,
+    Renderer,
+    Platform,
+    Game,
+    /// Number of categories
+    Count,
+  };
+
+  /// What to do when a thread logs faster than the writer keeps up
+  enum class LogOverflow {
+    /// Drop the message, the writer reports how many were dropped
+    Drop,
+    /// Wait for the writer to make room
+    Block,
+  };
+
+  /// Where the writer puts messages
+  enum class LogSink {
+    /// Formatted text on the console
+    Console,
+    /// Binary files read back with octal-logdecode, see LogFileWriter
+    Binary,
+    /// Both of the above
+    Both,
+  };
+
+  /// Configuration of the background log writer
+  struct LogConfig {
+    /// Bytes of each thread's ring buffer, rounded up to a power of two
+    u32 buffer_size{256 * 1024};
+    /// What to do when a thread's ring buffer is full
+    LogOverflow overflow{LogOverflow::Drop};
+    /// Where messages go
+    LogSink sink{LogSink::Console};
+    /// Binary log file, older ones get .1, .2 and so on appended
+    const char* path{"octal.olog"};
+    /// Bytes of each binary log file
+    u64 file_size{64 * 1024 * 1024};
+    /// Older binary log files kept around
+    u32 file_count{4};
+  };
+
+  /// Most bytes of arguments a message carries, longer strings are cut short
+  static constexpr u32 LOG_MAX_ARG_BYTES = 4096;
+
   /// Setup logging for this application
-  API bool InitLog();
+  /// Starts the writer thread, until then messages are written on the calling thread.
+  /// @param config of the writer
+  API bool InitLog(const LogConfig& config = {});
   /// Shutdown logging for this application
+  /// Writes everything still queued, other threads must have stopped logging by now.
   API void ShutdownLog();
+  /// Wait until everything logged so far has been written
+  API void FlushLog();
+
+  /// Most verbose level a category lets through at runtime, LOG_LEVEL_MAX by default
+  API LogLevel GetLogLevel(LogCategory category);
+  /// Change the most verbose level a category lets through
+  API void SetLogLevel(LogCategory category, LogLevel level);
+  /// Change the most verbose level every category lets through
+  API void SetLogLevel(LogLevel level);
+  /// Name of a category for printing
+  API const char* LogCategoryName(LogCategory category);
+  /// Name of a level for printing
+  API const char* LogLevelName(LogLevel level);
+  /// Format a message from its packed arguments, as read from a binary log
+  API std::string FormatLogMessage(const char* format, const u8* args, u32 bytes);
 
   /// Helper to log an assertion failure
   API void report_assertion_failure(const char* expr, const char* msg,  const char* file, i32 line);
 
-  /// Log something! use the macros instead though
+  /// Log something without checking the format at compile time, use the macros instead
+  /// The arguments are copied into the calling thread's ring buffer and formatted
+  /// later by the writer thread, so msg must be a string literal. Fatal messages
+  /// flush everything before them and are written right away.
+#if defined(__GNUC__) || defined(__clang__)
+  __attribute__((format(printf, 2, 3)))
+#endif
   API void Log(LogLevel, const char* msg, ...);
+
+  /// Kind of argument a printf conversion takes
+  enum class ArgKind : u8 {
+    /// %% or an unknown conversion, no argument
+    None,
+    /// Stored as i64
+    Signed,
+    /// Stored as u64
+    Unsigned,
+    /// Stored as f64
+    Double,
+    LongDouble,
+    /// Stored as a u32 length followed by the characters and a terminator
+    String,
+    /// Stored as u64
+    Pointer,
+    /// %n, the argument is skipped
+    Skip,
+    /// A '*' width or precision, stored as i64
+    Star,
+  };
+
+  /// One conversion in a printf format
+  struct FormatSpec {
+    /// The '%' starting the conversion
+    const char* begin;
+    /// Start of the length modifier, flags, width and precision come before it
+    const char* length;
+    /// One past the conversion character
+    const char* end;
+    /// Number of '*' arguments before the value
+    u8 stars;
+    /// Precision given as a number, -1 if none
+    i32 precision;
+    /// Is the precision the last '*' argument?
+    bool star_precision;
+    /// Length modifier folded to one char: 'H' for hh, 'Q' for ll, otherwise as written
+    char modifier;
+    ArgKind kind;
+  };
+
+  /// Find the next conversion in a printf format
+  /// Used both to check formats at compile time and by the writer.
+  /// @return false if there are none left
+  constexpr bool NextFormatSpec(const char* fmt, FormatSpec& spec) {
+    auto any = [](char c, const char* set) {
+      for (; *set; ++set) {
+        if (c == *set)
+          return true;
+      }
+      return false;
+    };
+    const char* p = fmt;
+    while (*p && *p != '%')
+      ++p;
+    if (!*p)
+      return false;
+    spec.begin = p++;
+    spec.stars = 0;
+    spec.precision = -1;
+    spec.star_precision = false;
+    spec.modifier = 0;
+    while (*p && any(*p, "-+ #0"))
+      ++p;
+    if (*p == '*') {
+      ++spec.stars;
+      ++p;
+    }
+    while (*p >= '0' && *p <= '9')
+      ++p;
+    if (*p == '.') {
+      ++p;
+      if (*p == '*') {
+        ++spec.stars;
+        spec.star_precision = true;
+        ++p;
+      } else {
+        spec.precision = 0;
+        while (*p >= '0' && *p <= '9')
+          spec.precision = spec.precision * 10 + (*p++ - '0');
+      }
+    }
+    spec.length = p;
+    if (*p == 'h' || *p == 'l') {
+      spec.modifier = *p++;
+      if (*p == spec.modifier) {
+        spec.modifier = spec.modifier == 'h' ? 'H' : 'Q';
+        ++p;
+      }
+    } else if (*p && any(*p, "jztL")) {
+      spec.modifier = *p++;
+    }
+    switch (*p) {
+      case 'd': case 'i': spec.kind = ArgKind::Signed; break;
+      case 'u': case 'o': case 'x': case 'X': case 'c': spec.kind = ArgKind::Unsigned; break;
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec.kind = spec.modifier == 'L' ? ArgKind::LongDouble : ArgKind::Double;
+        break;
+      case 's': spec.kind = ArgKind::String; break;
+      case 'p': spec.kind = ArgKind::Pointer; break;
+      case 'n': spec.kind = ArgKind::Skip; break;
+      default: spec.kind = ArgKind::None; break;
+    }
+    spec.end = *p ? p + 1 : p;
+    return true;
+  }
+
+  // Not constexpr so a bad format stops the compile with the reason as the error
+  inline void log_format_has_too_few_arguments() {}
+  inline void log_format_has_too_many_arguments() {}
+  inline void log_format_conversion_does_not_match_argument() {}
+  inline void log_format_conversion_is_not_supported() {}
+  inline void log_format_has_too_many_arguments_to_pack() {}
+
+  /// Kind of argument a type can be logged as
+  template<typename T>
+  constexpr ArgKind LogArgKind() {
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, char*> || std::is_same_v<D, const char*>
+        || std::is_convertible_v<const D&, std::string_view>)
+      return ArgKind::String;
+    else if constexpr (std::is_integral_v<D> || std::is_enum_v<D>)
+      return ArgKind::Signed;
+    else if constexpr (std::is_same_v<D, long double>)
+      return ArgKind::LongDouble;
+    else if constexpr (std::is_floating_point_v<D>)
+      return ArgKind::Double;
+    else if constexpr (std::is_pointer_v<D> || std::is_null_pointer_v<D>)
+      return ArgKind::Pointer;
+    else
+      return ArgKind::None;
+  }
+
+  /// printf format checked against its arguments at compile time
+  /// Built implicitly from a string literal the way std::format_string is. The
+  /// conversions are parsed once while compiling so logging only copies the
+  /// arguments: integers are stored at their full width whatever the length
+  /// modifier says, so %d with a u64 prints the right number.
+  template<typename... Args>
+  class LogFormat {
+    public:
+      static constexpr u32 COUNT = sizeof...(Args);
+
+      template<u64 N>
+      consteval LogFormat(const char (&str)[N]) : m_Format(str) {
+        constexpr ArgKind types[COUNT + 1] = {LogArgKind<Args>()..., ArgKind::None};
+        if (COUNT > 64)
+          log_format_has_too_many_arguments_to_pack();
+        u32 arg = 0;
+        FormatSpec spec{};
+        const char* fmt = str;
+        while (NextFormatSpec(fmt, spec)) {
+          fmt = spec.end;
+          if (spec.kind == ArgKind::None) {
+            // only %% is allowed to take no argument
+            if (spec.end - spec.begin != 2 || spec.begin[1] != '%')
+              log_format_conversion_is_not_supported();
+            continue;
+          }
+          if (spec.kind == ArgKind::Skip)
+            log_format_conversion_is_not_supported();
+          for (u8 s = 0; s < spec.stars; ++s, ++arg) {
+            if (arg >= COUNT)
+              log_format_has_too_few_arguments();
+            if (types[arg] != ArgKind::Signed)
+              log_format_conversion_does_not_match_argument();
+            m_Kinds[arg] = ArgKind::Star;
+          }
+          if (arg >= COUNT)
+            log_format_has_too_few_arguments();
+          bool integer = spec.kind == ArgKind::Signed || spec.kind == ArgKind::Unsigned;
+          // %p prints any pointer, including strings
+          bool pointer = spec.kind == ArgKind::Pointer && (types[arg] == ArgKind::Pointer || types[arg] == ArgKind::String);
+          if (!(integer ? types[arg] == ArgKind::Signed : types[arg] == spec.kind || pointer))
+            log_format_conversion_does_not_match_argument();
+          m_Kinds[arg] = spec.kind;
+          m_Precision[arg] = spec.star_precision ? -2 : spec.precision;
+          ++arg;
+        }
+        if (arg != COUNT)
+          log_format_has_too_many_arguments();
+      }
+
+      /// The format itself
+      constexpr const char* Format() const { return m_Format; }
+      /// How the i-th argument is stored
+      constexpr ArgKind Kind(u32 i) const { return m_Kinds[i]; }
+      /// Precision of the i-th argument: -1 for none, -2 if it is the argument before it
+      constexpr i32 Precision(u32 i) const { return m_Precision[i]; }
+
+    private:
+      const char* m_Format;
+      ArgKind m_Kinds[COUNT + 1]{};
+      i32 m_Precision[COUNT + 1]{};
+  };
+
+  /// Start a message, used by Log
+  /// @return where to copy bytes of arguments to, null if the message was dropped
+  API u8* LogBegin(LogLevel level, LogCategory category, const char* format, u32 bytes);
+  /// Finish the message started by LogBegin on this thread
+  API void LogEnd();
+
+  /// Bytes an argument takes once stored, see ArgKind
+  /// @param len of the string if it is one, cut short to fit
+  /// @param star value of the last '*' argument
+  template<typename T>
+  u32 LogArgBytes(const T& arg, ArgKind kind, i32 precision, u32 budget, u32& len, i64& star) {
+    if constexpr (LogArgKind<T>() == ArgKind::String) {
+      if (kind == ArgKind::String) {
+        if (precision == -2)
+          precision = star >= 0 ? (i32) star : -1;
+        u64 n;
+        if constexpr (std::is_convertible_v<const T&, const char*>) {
+          const char* str = arg ? (const char*) arg : "(null)";
+          n = 0;
+          if (precision < 0) {
+            n = std::strlen(str);
+          } else {
+            // a precision means the string doesn't need a terminator
+            while (n < (u64) precision && str[n])
+              ++n;
+          }
+        } else {
+          n = std::string_view(arg).size();
+          if (precision >= 0 && n > (u64) precision)
+            n = precision;
+        }
+        len = (u32) (n < budget ? n : budget);
+        return (u32) sizeof(u32) + len + 1;
+      }
+    } else if constexpr (LogArgKind<T>() == ArgKind::Signed) {
+      if (kind == ArgKind::Star)
+        star = (i64) arg;
+    } else if constexpr (LogArgKind<T>() == ArgKind::LongDouble) {
+      return sizeof(long double);
+    }
+    return sizeof(u64);
+  }
+
+  /// Copy an argument to where LogBegin said
+  /// @return one past what was written
+  template<typename T>
+  u8* LogPackArg(u8* out, const T& arg, ArgKind kind, u32 len) {
+    auto put = [&](const void* src, u64 bytes) {
+      std::memcpy(out, src, bytes);
+      out += bytes;
+    };
+    if constexpr (LogArgKind<T>() == ArgKind::String) {
+      if (kind == ArgKind::String) {
+        const char* str;
+        if constexpr (std::is_convertible_v<const T&, const char*>)
+          str = arg ? (const char*) arg : "(null)";
+        else
+          str = std::string_view(arg).data();
+        put(&len, sizeof(len));
+        put(str, len);
+        *out++ = '\0';
+        return out;
+      }
+      // %p of a string
+      const void* ptr;
+      if constexpr (std::is_convertible_v<const T&, const char*>)
+        ptr = (const char*) arg;
+      else
+        ptr = std::string_view(arg).data();
+      u64 v = (u64) (uintptr_t) ptr;
+      put(&v, sizeof(v));
+    } else if constexpr (LogArgKind<T>() == ArgKind::Signed) {
+      using D = std::decay_t<T>;
+      using I = typename std::conditional_t<std::is_enum_v<D>, std::underlying_type<D>, std::type_identity<D>>::type;
+      u64 v;
+      if constexpr (std::is_same_v<I, bool>)
+        v = arg ? 1 : 0;
+      // unsigned conversions see the value at its own width, like printf would
+      else if (kind == ArgKind::Unsigned)
+        v = (u64) (std::make_unsigned_t<I>) arg;
+      else
+        v = (u64) (i64) arg;
+      put(&v, sizeof(v));
+    } else if constexpr (LogArgKind<T>() == ArgKind::LongDouble) {
+      put(&arg, sizeof(long double));
+    } else if constexpr (LogArgKind<T>() == ArgKind::Double) {
+      f64 v = arg;
+      put(&v, sizeof(v));
+    } else {
+      u64 v = (u64) (uintptr_t) arg;
+      put(&v, sizeof(v));
+    }
+    return out;
+  }
+
+  /// Log something with a format checked at compile time, use the macros instead
+  /// Only copies the arguments, formatting happens on the writer thread.
+  template<typename... Args>
+  void Log(LogLevel level, LogCategory category, LogFormat<std::type_identity_t<Args>...> fmt, const Args&... args) {
+    constexpr u32 COUNT = sizeof...(Args);
+    u32 lens[COUNT + 1] = {};
+    u32 bytes = 0;
+    if constexpr (COUNT > 0) {
+      // leave room for everything but strings whatever comes first
+      u32 budget = LOG_MAX_ARG_BYTES - COUNT * (u32) (sizeof(long double) + sizeof(u32) + 1);
+      i64 star = -1;
+      u32 i = 0;
+      ((bytes += LogArgBytes(args, fmt.Kind(i), fmt.Precision(i), bytes < budget ? budget - bytes : 0, lens[i], star), ++i), ...);
+    }
+    u8* out = LogBegin(level, category, fmt.Format(), bytes);
+    if (!out)
+      return;
+    if constexpr (COUNT > 0) {
+      u32 i = 0;
+      ((out = LogPackArg(out, args, fmt.Kind(i), lens[i]), ++i), ...);
+    }
+    LogEnd();
+  }
 }
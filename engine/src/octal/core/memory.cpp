@@ -0,0 +1,305 @@
+#include "octal/core/memory.h"
+#include "octal/core/asserts.h"
+#include "octal/core/jobs.h"
+#include "octal/core/logger.h"
+#include "platform/platform.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace octal {
+
+  /// Round a value up to a multiple of a power of two
+  static u64 alignUp(u64 value, u64 align) {
+    return (value + align - 1) & ~(align - 1);
+  }
+
+  LinearAllocator::LinearAllocator(u64 block_size, MemoryTag tag) : m_BlockSize(block_size), m_Tag(tag) {}
+
+  LinearAllocator::~LinearAllocator() {
+    for (Block& b : m_Blocks) {
+      Platform::Free(b.data);
+    }
+  }
+
+  void LinearAllocator::grow(u64 size) {
+    u64 bytes = std::max(m_BlockSize, alignUp(size, Platform::ALIGNMENT));
+    u8* data = (u8*) Platform::Allocate(bytes, true, m_Tag);
+    ASSERT(data, "Out of memory");
+    m_Blocks.push_back({data, bytes});
+    m_Capacity += bytes;
+    m_Offset = 0;
+  }
+
+  void* LinearAllocator::Allocate(u64 size, u64 align) {
+    ASSERT(align <= Platform::ALIGNMENT, "Linear allocations can't be aligned past a cache line");
+    u64 start = alignUp(m_Offset, align);
+    if (m_Blocks.empty() || start + size > m_Blocks.back().size) [[unlikely]] {
+      // whatever is left of the old block is wasted until the next reset
+      m_Used += m_Blocks.empty() ? 0 : m_Blocks.back().size - m_Offset;
+      grow(size);
+      start = 0;
+    }
+    m_Used += start - m_Offset + size;
+    m_Offset = start + size;
+    return m_Blocks.back().data + start;
+  }
+
+  void LinearAllocator::Reset() {
+    m_Peak = std::max(m_Peak, m_Used);
+    // one block that fits everything the frame needed
+    if (m_Blocks.size() > 1) {
+      for (Block& b : m_Blocks) {
+        Platform::Free(b.data);
+      }
+      m_Blocks.clear();
+      u64 total = m_Capacity;
+      m_Capacity = 0;
+      grow(total);
+    }
+    m_Offset = 0;
+    m_Used = 0;
+  }
+
+  PoolAllocator::PoolAllocator(u64 block_size, u64 align, u32 blocks_per_slab, MemoryTag tag)
+    : m_BlockSize(alignUp(std::max<u64>(block_size, sizeof(FreeBlock)), align)),
+      m_Align(align), m_BlocksPerSlab(blocks_per_slab), m_Tag(tag)
+  {
+    ASSERT(align <= Platform::ALIGNMENT, "Pool blocks can't be aligned past a cache line");
+  }
+
+  PoolAllocator::~PoolAllocator() {
+    if (m_Live != 0)
+      WARN("Pool of %d byte blocks destroyed with %d blocks still in use", (u32) m_BlockSize, m_Live);
+    for (void* slab : m_Slabs) {
+      Platform::Free(slab);
+    }
+  }
+
+  void PoolAllocator::grow() {
+    u8* slab = (u8*) Platform::Allocate(m_BlockSize * m_BlocksPerSlab, true, m_Tag);
+    ASSERT(slab, "Out of memory");
+    m_Slabs.push_back(slab);
+    // link backwards so blocks come out in address order
+    for (u32 i = m_BlocksPerSlab; i-- > 0;) {
+      FreeBlock* b = (FreeBlock*) (slab + i * m_BlockSize);
+      b->next = m_Free;
+      m_Free = b;
+    }
+  }
+
+  void* PoolAllocator::do_allocate(size_t bytes, size_t align) {
+    if (bytes <= m_BlockSize && align <= m_Align)
+      return Allocate();
+    return ::operator new(bytes, std::align_val_t(align));
+  }
+
+  void PoolAllocator::do_deallocate(void* block, size_t bytes, size_t align) {
+    if (bytes <= m_BlockSize && align <= m_Align)
+      Free(block);
+    else
+      ::operator delete(block, std::align_val_t(align));
+  }
+
+  void* TaggedResource::do_allocate(size_t bytes, size_t align) {
+    // the platform can't align past a cache line so those go uncounted to the heap
+    if (align > Platform::ALIGNMENT)
+      return ::operator new(bytes, std::align_val_t(align));
+    void* block = Platform::Allocate(bytes, align > 16, m_Tag);
+    if (!block)
+      throw std::bad_alloc();
+    return block;
+  }
+
+  void TaggedResource::do_deallocate(void* block, size_t, size_t align) {
+    if (align > Platform::ALIGNMENT)
+      ::operator delete(block, std::align_val_t(align));
+    else
+      Platform::Free(block);
+  }
+
+  /// Frame allocator of each worker plus one for threads outside the pool at index 0
+  static std::vector<Scope<LinearAllocator>> s_Frames;
+
+  void Memory::Init(u64 frame_bytes) {
+    Shutdown();
+    u32 count = JobSystem::WorkerCount() + 1;
+    for (u32 i = 0; i < count; ++i) {
+      s_Frames.push_back(CreateScope<LinearAllocator>(frame_bytes));
+    }
+  }
+
+  void Memory::Shutdown() {
+    s_Frames.clear();
+  }
+
+  LinearAllocator& Memory::Frame() {
+    u32 idx = (u32) (JobSystem::WorkerIndex() + 1);
+    ASSERT(idx < s_Frames.size(), "Memory::Init hasn't been called");
+    return *s_Frames[idx];
+  }
+
+  std::pmr::memory_resource* Memory::Resource(MemoryTag tag) {
+    // never destroyed so containers in statics can still free into them
+    static TaggedResource* s_Resources = [] {
+      TaggedResource* resources = (TaggedResource*) ::operator new(sizeof(TaggedResource) * (u32) MemoryTag::Count);
+      for (u32 t = 0; t < (u32) MemoryTag::Count; ++t) {
+        new (&resources[t]) TaggedResource((MemoryTag) t);
+      }
+      return resources;
+    }();
+    return &s_Resources[(u32) tag];
+  }
+
+  std::pmr::memory_resource* Memory::FrameResource() {
+    u32 idx = (u32) (JobSystem::WorkerIndex() + 1);
+    if (idx >= s_Frames.size())
+      return std::pmr::new_delete_resource();
+    return s_Frames[idx].get();
+  }
+
+  void Memory::EndFrame() {
+    for (auto& frame : s_Frames) {
+      frame->Reset();
+    }
+    Sample();
+  }
+
+  static constexpr u32 TAG_COUNT = (u32) MemoryTag::Count;
+
+  /// Counters of one thread, only ever written by that thread
+  struct Shard {
+    std::atomic<i64> live[TAG_COUNT]{};
+    std::atomic<u64> allocations[TAG_COUNT]{};
+    std::atomic<u64> frees[TAG_COUNT]{};
+
+    /// Add another shard's counters to this one
+    void Add(const Shard& other) {
+      for (u32 t = 0; t < TAG_COUNT; ++t) {
+        live[t] += other.live[t].load(std::memory_order_relaxed);
+        allocations[t] += other.allocations[t].load(std::memory_order_relaxed);
+        frees[t] += other.frees[t].load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  /// Every thread's shard plus what is needed to add them up
+  struct ShardRegistry {
+    std::mutex lock;
+    std::vector<Shard*> shards;
+    /// Counters of threads that have exited
+    Shard retired;
+    u64 peak[TAG_COUNT]{};
+    u64 budget[TAG_COUNT]{};
+    /// Has the tag been warned about being over budget since it was last under?
+    bool over[TAG_COUNT]{};
+  };
+
+  /// Never destroyed so threads and statics can still free memory during shutdown
+  static ShardRegistry& registry() {
+    static ShardRegistry* s_Registry = new ShardRegistry();
+    return *s_Registry;
+  }
+
+  /// Registers the calling thread's shard and folds it into the retired counters when the thread exits
+  struct ThreadShard {
+    Shard shard;
+
+    ThreadShard() {
+      ShardRegistry& r = registry();
+      std::lock_guard<std::mutex> guard(r.lock);
+      r.shards.push_back(&shard);
+    }
+
+    ~ThreadShard() {
+      ShardRegistry& r = registry();
+      std::lock_guard<std::mutex> guard(r.lock);
+      r.retired.Add(shard);
+      std::erase(r.shards, &shard);
+    }
+  };
+
+  static thread_local ThreadShard t_Shard;
+
+  void Memory::Track(MemoryTag tag, i64 bytes) {
+    Shard& s = t_Shard.shard;
+    u32 t = (u32) tag;
+    // only this thread writes its shard so a plain load and store is enough
+    s.live[t].store(s.live[t].load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    if (bytes >= 0)
+      s.allocations[t].store(s.allocations[t].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    else
+      s.frees[t].store(s.frees[t].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  /// Add up every shard, the registry must be locked
+  static void total(ShardRegistry& r, MemoryStats* out) {
+    Shard sum;
+    sum.Add(r.retired);
+    for (Shard* s : r.shards) {
+      sum.Add(*s);
+    }
+    for (u32 t = 0; t < TAG_COUNT; ++t) {
+      // blocks freed on another thread can make a shard go negative for a while
+      i64 live = sum.live[t].load();
+      out[t].live_bytes = live > 0 ? (u64) live : 0;
+      r.peak[t] = std::max(r.peak[t], out[t].live_bytes);
+      out[t].peak_bytes = r.peak[t];
+      out[t].allocations = sum.allocations[t].load();
+      out[t].frees = sum.frees[t].load();
+    }
+  }
+
+  MemoryStats Memory::Stats(MemoryTag tag) {
+    MemoryStats all[TAG_COUNT];
+    Sample(all);
+    return all[(u32) tag];
+  }
+
+  void Memory::Sample(MemoryStats* out) {
+    MemoryStats all[TAG_COUNT];
+    ShardRegistry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    total(r, all);
+    for (u32 t = 0; t < TAG_COUNT; ++t) {
+      bool over = r.budget[t] != 0 && all[t].live_bytes > r.budget[t];
+      if (over && !r.over[t]) {
+        WARN("%s memory is over budget, %llu of %llu bytes", TagName((MemoryTag) t), all[t].live_bytes, r.budget[t]);
+      }
+      r.over[t] = over;
+    }
+    if (out)
+      std::copy(all, all + TAG_COUNT, out);
+  }
+
+  void Memory::SetBudget(MemoryTag tag, u64 bytes) {
+    ShardRegistry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.budget[(u32) tag] = bytes;
+    r.over[(u32) tag] = false;
+  }
+
+  void Memory::Dump() {
+    MemoryStats all[TAG_COUNT];
+    Sample(all);
+    INFO("Memory      live KB     peak KB      allocs       frees");
+    for (u32 t = 0; t < TAG_COUNT; ++t) {
+      const MemoryStats& s = all[t];
+      if (s.allocations == 0)
+        continue;
+      INFO("%-8s %10llu  %10llu  %10llu  %10llu", TagName((MemoryTag) t),
+          s.live_bytes / 1024, s.peak_bytes / 1024, s.allocations, s.frees);
+    }
+  }
+
+  const char* Memory::TagName(MemoryTag tag) {
+    switch (tag) {
+      case MemoryTag::Unknown: return "Unknown";
+      case MemoryTag::ECS: return "ECS";
+      case MemoryTag::Logger: return "Logger";
+      case MemoryTag::Jobs: return "Jobs";
+      case MemoryTag::Frame: return "Frame";
+      default: return "?";
+    }
+  }
+}
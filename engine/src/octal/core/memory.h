@@ -0,0 +1,259 @@
+#pragma once
+#include "octal/defines.h"
+#include "platform/platform.h"
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace octal {
+
+  /// Hands out memory by bumping an offset, everything is freed at once by Reset
+  /// Memory comes in blocks from the platform. When a frame needs more than one
+  /// block, Reset swaps them for a single block as big as all of them so later
+  /// frames of the same size never allocate. Nothing allocated here has its
+  /// destructor called. Not thread safe, each thread needs its own.
+  /// It is also a memory resource so std::pmr containers can allocate from it.
+  class LinearAllocator : public std::pmr::memory_resource {
+    public:
+      /// Constructor
+      /// @param block_size bytes of the first block, more blocks are at least this big
+      /// @param tag the blocks are counted against
+      API LinearAllocator(u64 block_size = 1024 * 1024, MemoryTag tag = MemoryTag::Frame);
+      API ~LinearAllocator();
+
+      LinearAllocator(const LinearAllocator&) = delete;
+      LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+      /// Allocate memory that lives until the next Reset
+      /// @param size in bytes
+      /// @param align power of two, at most Platform::ALIGNMENT
+      API void* Allocate(u64 size, u64 align = alignof(std::max_align_t));
+
+      /// Allocate an uninitialized array
+      /// @param count number of elements
+      template<typename T>
+      T* AllocateArray(u64 count) {
+        return (T*) Allocate(count * sizeof(T), alignof(T));
+      }
+
+      /// Free everything allocated so far
+      API void Reset();
+
+      /// Bytes handed out since the last reset, including padding
+      u64 Used() const { return m_Used; }
+
+      /// Most bytes used between two resets
+      u64 Peak() const { return m_Peak; }
+
+      /// Bytes of every block together
+      u64 Capacity() const { return m_Capacity; }
+
+    private:
+      /// A block of memory from the platform
+      struct Block {
+        u8* data;
+        u64 size;
+      };
+
+      void* do_allocate(size_t bytes, size_t align) override {
+        return Allocate(bytes, align);
+      }
+      /// Memory is only given back by Reset
+      void do_deallocate(void*, size_t, size_t) override {}
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+      }
+
+      /// Add a block with room for at least size bytes
+      void grow(u64 size);
+
+      /// Blocks in the order they were added, only the last one has room left
+      std::vector<Block> m_Blocks;
+      /// Offset into the last block
+      u64 m_Offset{0};
+      /// Size of new blocks
+      u64 m_BlockSize;
+      /// Tag the blocks are counted against
+      MemoryTag m_Tag;
+      /// Bytes used since the last reset
+      u64 m_Used{0};
+      /// Most bytes used between two resets
+      u64 m_Peak{0};
+      /// Bytes of every block
+      u64 m_Capacity{0};
+  };
+
+  /// Hands out blocks of one size from a free list
+  /// Blocks are carved out of slabs that are only given back when the pool is
+  /// destroyed, so freeing and allocating again never reaches the platform.
+  /// Not thread safe.
+  /// As a memory resource it serves requests that fit in a block and passes
+  /// bigger ones to the global heap.
+  class PoolAllocator : public std::pmr::memory_resource {
+    public:
+      /// Constructor
+      /// @param block_size bytes of each block, at least a pointer
+      /// @param align of each block, a power of two up to Platform::ALIGNMENT
+      /// @param blocks_per_slab blocks allocated from the platform at a time
+      /// @param tag the slabs are counted against
+      API PoolAllocator(u64 block_size, u64 align = alignof(std::max_align_t), u32 blocks_per_slab = 64,
+          MemoryTag tag = MemoryTag::Unknown);
+      API ~PoolAllocator();
+
+      PoolAllocator(const PoolAllocator&) = delete;
+      PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+      /// Take a block off the free list, growing the pool if it is empty
+      void* Allocate() {
+        if (!m_Free) [[unlikely]]
+          grow();
+        FreeBlock* block = m_Free;
+        m_Free = block->next;
+        ++m_Live;
+        return block;
+      }
+
+      /// Put a block back on the free list
+      /// @param block from Allocate of this pool
+      void Free(void* block) {
+        FreeBlock* b = (FreeBlock*) block;
+        b->next = m_Free;
+        m_Free = b;
+        --m_Live;
+      }
+
+      /// Size of each block
+      u64 BlockSize() const { return m_BlockSize; }
+
+      /// Alignment of each block
+      u64 Alignment() const { return m_Align; }
+
+      /// Number of blocks handed out right now
+      u32 Live() const { return m_Live; }
+
+      /// Number of blocks in every slab together
+      u32 Capacity() const { return (u32) m_Slabs.size() * m_BlocksPerSlab; }
+
+    private:
+      /// A free block holds the next one
+      struct FreeBlock {
+        FreeBlock* next;
+      };
+
+      void* do_allocate(size_t bytes, size_t align) override;
+      void do_deallocate(void* block, size_t bytes, size_t align) override;
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+      }
+
+      /// Allocate a slab and put its blocks on the free list
+      void grow();
+
+      /// Every slab from the platform
+      std::vector<void*> m_Slabs;
+      /// First free block or null
+      FreeBlock* m_Free{nullptr};
+      /// Size of each block, rounded up to the alignment
+      u64 m_BlockSize;
+      /// Alignment of each block
+      u64 m_Align;
+      /// Blocks in each slab
+      u32 m_BlocksPerSlab;
+      /// Blocks handed out
+      u32 m_Live{0};
+      /// Tag the slabs are counted against
+      MemoryTag m_Tag;
+  };
+
+  /// Memory resource that allocates from the platform under a tag
+  /// Lets std::pmr containers show up in the memory stats of their subsystem.
+  /// Alignments past a cache line go to the global heap and aren't counted.
+  class TaggedResource : public std::pmr::memory_resource {
+    public:
+      /// Constructor
+      /// @param tag allocations are counted against
+      TaggedResource(MemoryTag tag) : m_Tag(tag) {};
+
+    private:
+      void* do_allocate(size_t bytes, size_t align) override;
+      void do_deallocate(void* block, size_t, size_t align) override;
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+      }
+
+      /// Tag allocations are counted against
+      MemoryTag m_Tag;
+  };
+
+  /// Allocation counters of one memory tag
+  struct MemoryStats {
+    /// Bytes allocated and not freed yet
+    u64 live_bytes;
+    /// Most live bytes seen by Memory::Sample
+    u64 peak_bytes;
+    /// Number of allocations ever made
+    u64 allocations;
+    /// Number of allocations freed
+    u64 frees;
+  };
+
+  /// Per frame scratch memory and memory stats
+  /// Each job system worker, and the threads outside of it, gets a LinearAllocator
+  /// that is reset at the end of every frame. Anything allocated from it must
+  /// not be used after the frame it was allocated in.
+  /// Every block from Platform::Allocate is counted against its tag. Each thread
+  /// counts into its own shard so allocating never contends, and the shards are
+  /// only added up when stats are asked for. Peaks are sampled at that point and
+  /// at the end of every frame.
+  class Memory {
+    public:
+      /// Create the frame allocators, after JobSystem::Init so every worker gets one
+      /// @param frame_bytes size of each thread's first block
+      API static void Init(u64 frame_bytes = 1024 * 1024);
+
+      /// Free the frame allocators
+      API static void Shutdown();
+
+      /// Frame allocator of the calling thread
+      /// Threads outside of the job system share one so only one of them may use it.
+      API static LinearAllocator& Frame();
+
+      /// Memory resource counting against a tag, shared by every container of that subsystem
+      /// @param tag allocations are counted against
+      API static std::pmr::memory_resource* Resource(MemoryTag tag);
+
+      /// Frame allocator of the calling thread as a memory resource for std::pmr containers
+      /// The global heap when Init hasn't been called, so code using it also runs outside the application.
+      API static std::pmr::memory_resource* FrameResource();
+
+      /// Free everything allocated from every frame allocator
+      /// Called by the application once a frame is done, while no jobs are running.
+      /// Also samples the memory stats.
+      API static void EndFrame();
+
+      /// Count an allocation or free against a tag on the calling thread's shard
+      /// @param tag what the memory is used for
+      /// @param bytes size of an allocation, or minus the size of a free
+      API static void Track(MemoryTag tag, i64 bytes);
+
+      /// Add up the shards of every thread for one tag
+      /// @param tag to get the stats of
+      API static MemoryStats Stats(MemoryTag tag);
+
+      /// Add up every tag, updating the peaks and warning about tags over budget
+      /// @param out stats of each tag, indexed by tag, or null
+      API static void Sample(MemoryStats* out = nullptr);
+
+      /// Warn once when a tag has more live bytes than this at a sample
+      /// @param tag to limit
+      /// @param bytes the budget, 0 for none
+      API static void SetBudget(MemoryTag tag, u64 bytes);
+
+      /// Log the stats of every tag that has been used
+      API static void Dump();
+
+      /// Name of a tag for printing
+      API static const char* TagName(MemoryTag tag);
+  };
+}
@@ -0,0 +1,125 @@
+#include "octal/core/timer.h"
+#include "octal/core/logger.h"
+#include "octal/core/asserts.h"
+#include "platform/platform.h"
+#include <algorithm>
+#include <thread>
+
+namespace octal {
+  /// Guess at how late sleeps wake before we've seen any
+  static constexpr u64 INITIAL_OVERSLEEP = Platform::TICKS_PER_SECOND / 1000;
+  /// Least and most ticks spent spinning before a deadline
+  static constexpr u64 MIN_SPIN = Platform::TICKS_PER_SECOND / 5000;
+  static constexpr u64 MAX_SPIN = Platform::TICKS_PER_SECOND / 250;
+
+  TimeSamples::TimeSamples(u32 window) : m_Samples(std::max<u32>(window, 1)) { }
+
+  void TimeSamples::Add(u64 ticks) {
+    m_Samples[m_Next] = ticks;
+    m_Next = (m_Next + 1) % (u32) m_Samples.size();
+    m_Count = std::min<u32>(m_Count + 1, (u32) m_Samples.size());
+  }
+
+  void TimeSamples::Clear() {
+    m_Next = 0;
+    m_Count = 0;
+  }
+
+  FrameStats TimeSamples::Stats() const {
+    FrameStats stats;
+    if (m_Count == 0)
+      return stats;
+    std::vector<u64> sorted(m_Samples.begin(), m_Samples.begin() + m_Count);
+    std::sort(sorted.begin(), sorted.end());
+    u64 total = 0;
+    for (u64 sample : sorted) {
+      total += sample;
+    }
+    const f64 seconds = 1.0 / (f64) Platform::TICKS_PER_SECOND;
+    stats.frames = m_Count;
+    stats.min = sorted.front() * seconds;
+    stats.max = sorted.back() * seconds;
+    stats.avg = (f64) total / m_Count * seconds;
+    // nearest rank
+    u32 rank = (u32) ((m_Count * 99 + 99) / 100);
+    stats.p99 = sorted[rank - 1] * seconds;
+    return stats;
+  }
+
+  FrameTimer::FrameTimer(u32 window) : m_Samples(window) {
+    Reset();
+  }
+
+  void FrameTimer::Reset() {
+    m_Samples.Clear();
+    m_Frames = 0;
+    m_DeltaTicks = 0;
+    m_Delta = 0.0;
+    m_Last = Platform::Ticks();
+  }
+
+  f64 FrameTimer::Tick() {
+    u64 now = Platform::Ticks();
+    m_DeltaTicks = now - m_Last;
+    m_Delta = (f64) m_DeltaTicks / (f64) Platform::TICKS_PER_SECOND;
+    m_Last = now;
+    ++m_Frames;
+    m_Samples.Add(m_DeltaTicks);
+    return m_Delta;
+  }
+
+  FixedTimestep::FixedTimestep(f64 step, u32 max_steps)
+    : m_StepSize(step), m_Step((u64) (step * Platform::TICKS_PER_SECOND)), m_MaxSteps(std::max<u32>(max_steps, 1)) {
+    ASSERT(m_Step > 0, "Fixed timestep must be at least a nanosecond");
+  }
+
+  void FixedTimestep::Advance(u64 ticks) {
+    m_Accumulator = std::min(m_Accumulator + ticks, m_Step * m_MaxSteps);
+  }
+
+  bool FixedTimestep::Step() {
+    if (m_Accumulator < m_Step)
+      return false;
+    m_Accumulator -= m_Step;
+    return true;
+  }
+
+  FramePacer::FramePacer(f64 fps) : m_Oversleep(INITIAL_OVERSLEEP) {
+    SetTarget(fps);
+  }
+
+  void FramePacer::SetTarget(f64 fps) {
+    m_Target = fps > 0.0 ? fps : 0.0;
+    m_Period = m_Target > 0.0 ? (u64) (Platform::TICKS_PER_SECOND / m_Target) : 0;
+    Reset();
+  }
+
+  void FramePacer::Reset() {
+    m_Deadline = Platform::Ticks();
+    m_Late.Clear();
+  }
+
+  void FramePacer::Wait() {
+    if (m_Period == 0)
+      return;
+    u64 now = Platform::Ticks();
+    m_Deadline += m_Period;
+    if (now >= m_Deadline) {
+      m_Deadline = now;
+      return;
+    }
+    u64 spin = std::clamp(m_Oversleep + m_Oversleep / 2, MIN_SPIN, MAX_SPIN);
+    if (m_Deadline - now > spin) {
+      u64 wake = m_Deadline - spin;
+      Platform::SleepUntil(wake);
+      u64 woke = Platform::Ticks();
+      u64 late = woke > wake ? woke - wake : 0;
+      m_Oversleep = std::max(late, m_Oversleep - m_Oversleep / 16);
+    }
+    // the scheduler can't be trusted with the last bit, keep the core until it's time
+    while ((now = Platform::Ticks()) < m_Deadline) {
+      std::this_thread::yield();
+    }
+    m_Late.Add(now - m_Deadline);
+  }
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "octal/defines.h"
+#include <vector>
+
+namespace octal {
+  /// Times over the last few frames, in seconds
+  struct FrameStats {
+    f64 min{0.0};
+    f64 avg{0.0};
+    /// 99th percentile, what the slowest frames look like
+    f64 p99{0.0};
+    f64 max{0.0};
+    /// Frames the numbers are taken over
+    u32 frames{0};
+  };
+
+  /// The last few of some time measured every frame
+  class API TimeSamples {
+    public:
+      /// Constructor
+      /// @param window samples the stats are taken over
+      TimeSamples(u32 window = 240);
+
+      /// Add a sample, pushing out the oldest once the window is full
+      /// @param ticks of Platform::Ticks
+      void Add(u64 ticks);
+
+      /// Forget every sample
+      void Clear();
+
+      /// Work out the stats over the window, sorts a copy of it so not every frame
+      FrameStats Stats() const;
+
+    private:
+      /// A ring of samples
+      std::vector<u64> m_Samples;
+      /// Where the next sample goes
+      u32 m_Next{0};
+      u32 m_Count{0};
+  };
+
+  /// Times frames on Platform::Ticks and keeps a window of them for FrameStats
+  class API FrameTimer {
+    public:
+      /// Constructor
+      /// @param window frames the stats are taken over
+      FrameTimer(u32 window = 240);
+
+      /// Start timing from now, forgetting every frame so far
+      void Reset();
+
+      /// Mark the end of a frame
+      /// @return seconds since the last Tick or Reset
+      f64 Tick();
+
+      /// Seconds the last frame took
+      f64 Delta() const { return m_Delta; }
+      /// Ticks the last frame took
+      u64 DeltaTicks() const { return m_DeltaTicks; }
+      /// Platform::Ticks at the last Tick or Reset
+      u64 Last() const { return m_Last; }
+      /// Frames ticked since Reset
+      u64 Frames() const { return m_Frames; }
+
+      /// Frame times over the window
+      FrameStats Stats() const { return m_Samples.Stats(); }
+
+    private:
+      /// Ticks each frame in the window took
+      TimeSamples m_Samples;
+      u64 m_Last{0};
+      u64 m_DeltaTicks{0};
+      f64 m_Delta{0.0};
+      u64 m_Frames{0};
+  };
+
+  /// Steps a simulation at a fixed rate whatever the frame rate
+  /// Frame times are added with Advance and Step is called until it says no.
+  /// Time is kept in ticks so steps don't drift.
+  class API FixedTimestep {
+    public:
+      /// Constructor
+      /// @param step seconds each step covers
+      /// @param max_steps most steps a frame can owe, time past that is dropped
+      ///        so a slow frame doesn't snowball into slower ones
+      FixedTimestep(f64 step = 1.0 / 60.0, u32 max_steps = 8);
+
+      /// Add time that has passed
+      /// @param ticks of Platform::Ticks
+      void Advance(u64 ticks);
+
+      /// Take a step if one is due
+      /// @return true if the caller should step the simulation once
+      bool Step();
+
+      /// Seconds each step covers
+      f64 StepSize() const { return m_StepSize; }
+
+      /// How far into the next step we are, from 0 to 1, to interpolate by
+      f64 Alpha() const { return (f64) m_Accumulator / (f64) m_Step; }
+
+      /// Forget any time owed
+      void Reset() { m_Accumulator = 0; }
+
+    private:
+      f64 m_StepSize;
+      /// Ticks each step covers
+      u64 m_Step;
+      /// Ticks owed
+      u64 m_Accumulator{0};
+      u32 m_MaxSteps;
+  };
+
+  /// Holds frames to a target rate
+  /// Sleeps until just before each frame is due and spins the rest of the way,
+  /// so frames start within a few microseconds of their deadline without
+  /// burning a core the whole time. The spin margin follows how late the
+  /// scheduler has been waking us up.
+  class API FramePacer {
+    public:
+      /// Constructor
+      /// @param fps frames a second to aim for, 0 for no limit
+      FramePacer(f64 fps = 0.0);
+
+      /// Change the rate, the next frame is due a whole frame from now
+      /// @param fps frames a second to aim for, 0 for no limit
+      void SetTarget(f64 fps);
+      /// Frames a second aimed for, 0 for no limit
+      f64 Target() const { return m_Target; }
+
+      /// Start pacing from now
+      void Reset();
+
+      /// Wait until the next frame is due, returns right away without a target
+      /// A frame that ran long starts the next one right away rather than
+      /// rushing later frames to catch up.
+      void Wait();
+
+      /// How late each wait woke up past its deadline
+      FrameStats Jitter() const { return m_Late.Stats(); }
+
+    private:
+      f64 m_Target{0.0};
+      /// Ticks per frame, 0 for no limit
+      u64 m_Period{0};
+      /// When the last frame was due
+      u64 m_Deadline{0};
+      /// How late sleeps have been waking, decays so one bad wake doesn't stick
+      u64 m_Oversleep;
+      /// How late each wait was
+      TimeSamples m_Late;
+  };
+}
@@ -110,6 +110,3 @@ STATIC_ASSERT(sizeof(f64) == 8, "Expected f64 to be 8 bytes.");
 #endif
 #endif
 
-
-/// Limit to the number of entities
-#define MAX_ENTITIES 5000
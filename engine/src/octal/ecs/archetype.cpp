@@ -0,0 +1,398 @@
+#include "octal/ecs/archetype.h"
+#include "octal/core/asserts.h"
+#include "platform/platform.h"
+#include <algorithm>
+#include <cstring>
+
+namespace octal {
+
+  /// Round a value up to a multiple of align
+  static u32 alignUp(u32 value, u32 align) {
+    return (value + align - 1) & ~(align - 1);
+  }
+
+  Archetype::Archetype(const Signature& sig, std::vector<ComponentInfo> types, PoolAllocator* pool)
+    : m_Signature(sig), m_Types(std::move(types))
+  {
+    // size of one entity across every column
+    u32 row_bytes = sizeof(u32);
+    for (auto& info : m_Types) {
+      row_bytes += info.size;
+      m_ChunkAlign = std::max(m_ChunkAlign, info.align);
+    }
+
+    // lays out the columns for a given capacity and returns the bytes used
+    auto layout = [&](u32 capacity) {
+      m_Offsets.clear();
+      u32 offset = sizeof(u32) * capacity;
+      for (auto& info : m_Types) {
+        offset = alignUp(offset, info.align);
+        m_Offsets.push_back(offset);
+        offset += info.size * capacity;
+      }
+      return offset;
+    };
+
+    // guess from the row size then back off until the padding fits too
+    m_Capacity = CHUNK_SIZE / row_bytes;
+    while (m_Capacity > 0 && layout(m_Capacity) > CHUNK_SIZE) {
+      --m_Capacity;
+    }
+    // a single entity is too big for a chunk so make the chunk bigger
+    if (m_Capacity == 0) {
+      m_Capacity = 1;
+      m_ChunkBytes = alignUp(layout(1), m_ChunkAlign);
+    }
+
+    // added and changed tick for every component plus one per column
+    m_TickCount = (u32) m_Types.size() * (2 * m_Capacity + 1);
+
+    for (u32 i = 0; i < m_Types.size(); ++i) {
+      u32 tid = m_Types[i].id;
+      if (tid >= m_ColumnOf.size())
+        m_ColumnOf.resize(tid + 1, -1);
+      m_ColumnOf[tid] = (i32) i;
+    }
+
+    // oversized chunks and unusual alignments come from the heap
+    if (pool && m_ChunkBytes == pool->BlockSize() && m_ChunkAlign <= pool->Alignment())
+      m_Pool = pool;
+  }
+
+  Archetype::~Archetype() {
+    Clear();
+  }
+
+  void Archetype::Clear() {
+    for (u32 c = 0; c < m_Chunks.size(); ++c) {
+      for (u32 r = 0; r < m_Chunks[c].count; ++r) {
+        DestroyRow(c, r);
+      }
+      freeChunk(m_Chunks[c].data);
+      Platform::Free(m_Chunks[c].ticks);
+    }
+    m_Chunks.clear();
+    m_Size = 0;
+  }
+
+  u8* Archetype::allocateChunk() {
+    if (m_Pool)
+      return (u8*) m_Pool->Allocate();
+    return (u8*) ::operator new(m_ChunkBytes, std::align_val_t(m_ChunkAlign));
+  }
+
+  void Archetype::freeChunk(u8* data) {
+    if (m_Pool)
+      m_Pool->Free(data);
+    else
+      ::operator delete(data, std::align_val_t(m_ChunkAlign));
+  }
+
+  u32* Archetype::allocateTicks() {
+    u32* ticks = (u32*) Platform::Allocate(m_TickCount * sizeof(u32), false, MemoryTag::ECS);
+    ASSERT(ticks, "Out of memory");
+    memset(ticks, 0, m_TickCount * sizeof(u32));
+    return ticks;
+  }
+
+  void Archetype::Push(u32 id, u32& chunk, u32& row) {
+    // grab a new chunk if the last one is full
+    if (m_Chunks.empty() || m_Chunks.back().count == m_Capacity) {
+      u8* data = allocateChunk();
+      m_Chunks.push_back({data, 0, allocateTicks()});
+    }
+    chunk = (u32) m_Chunks.size() - 1;
+    Chunk& c = m_Chunks.back();
+    row = c.count++;
+    Entities(c)[row] = id;
+    ++m_Size;
+  }
+
+  void Archetype::DestroyRow(u32 chunk, u32 row) {
+    for (u32 i = 0; i < m_Types.size(); ++i) {
+      m_Types[i].destroy(At(chunk, i, row));
+    }
+  }
+
+  u32 Archetype::Fill(u32 chunk, u32 row) {
+    ASSERT(!m_Chunks.empty(), "Filling a row of an empty archetype");
+    u32 last_chunk = (u32) m_Chunks.size() - 1;
+    Chunk& last = m_Chunks.back();
+    u32 last_row = last.count - 1;
+    u32 moved = 0;
+
+    // move the last row into the hole unless the hole is the last row
+    if (chunk != last_chunk || row != last_row) {
+      for (u32 i = 0; i < m_Types.size(); ++i) {
+        m_Types[i].relocate(At(chunk, i, row), At(last_chunk, i, last_row));
+        Stamp(chunk, i, row, AddedTicks(last, i)[last_row], ChangedTicks(last, i)[last_row]);
+      }
+      moved = Entities(last)[last_row];
+      Entities(m_Chunks[chunk])[row] = moved;
+    }
+
+    --last.count;
+    --m_Size;
+    // give back chunks as soon as they are empty
+    if (last.count == 0) {
+      freeChunk(last.data);
+      Platform::Free(last.ticks);
+      m_Chunks.pop_back();
+    }
+    return moved;
+  }
+
+  void Archetype::Replicate(u32 chunk, u32 column, u32 begin, u32 end, const void* src, u32 tick) {
+    const ComponentInfo& info = m_Types[column];
+    Chunk& c = m_Chunks[chunk];
+    if (begin < end) {
+      if (info.trivial) {
+        // copy one then keep copying everything done so far
+        u8* first = (u8*) At(chunk, column, begin);
+        memcpy(first, src, info.size);
+        for (u32 done = 1; done < end - begin;) {
+          u32 n = std::min(done, end - begin - done);
+          memcpy(first + done * info.size, first, n * info.size);
+          done += n;
+        }
+      } else {
+        ASSERT(info.copy, "Copying a component that isn't copy constructible");
+        for (u32 r = begin; r < end; ++r)
+          info.copy(At(chunk, column, r), src);
+      }
+      std::fill(AddedTicks(c, column) + begin, AddedTicks(c, column) + end, tick);
+      std::fill(ChangedTicks(c, column) + begin, ChangedTicks(c, column) + end, tick);
+      ColumnTick(c, column) = tick;
+    }
+  }
+
+  void Archetype::CopyFrom(const Archetype& other) {
+    // keep the chunks, only what is in them goes
+    for (u32 c = 0; c < m_Chunks.size(); ++c) {
+      for (u32 r = 0; r < m_Chunks[c].count; ++r) {
+        DestroyRow(c, r);
+      }
+    }
+    while (m_Chunks.size() > other.m_Chunks.size()) {
+      freeChunk(m_Chunks.back().data);
+      Platform::Free(m_Chunks.back().ticks);
+      m_Chunks.pop_back();
+    }
+    for (u32 k = 0; k < other.m_Chunks.size(); ++k) {
+      const Chunk& from = other.m_Chunks[k];
+      if (k == m_Chunks.size())
+        m_Chunks.push_back({allocateChunk(), 0, allocateTicks()});
+      Chunk& c = m_Chunks[k];
+      c.count = from.count;
+      memcpy(c.ticks, from.ticks, m_TickCount * sizeof(u32));
+      memcpy(Entities(c), from.data, from.count * sizeof(u32));
+      for (u32 i = 0; i < m_Types.size(); ++i) {
+        const ComponentInfo& info = m_Types[i];
+        const u8* src = from.data + m_Offsets[i];
+        if (info.trivial) {
+          memcpy(Data(c, i), src, from.count * info.size);
+          continue;
+        }
+        ASSERT(info.copy, "Copying a component that isn't copy constructible");
+        for (u32 r = 0; r < from.count; ++r)
+          info.copy((u8*) Data(c, i) + r * info.size, src + r * info.size);
+      }
+    }
+    m_Size = other.m_Size;
+  }
+
+  void ArchetypeStorage::Instantiate(u32 prefab, const u32* ids, u32 count) {
+    Archetype* arch = ArchetypeOf(prefab);
+    if (!arch || count == 0)
+      return;
+    // rows are reserved first so each column is filled in one pass
+    u32 first_chunk = 0, first_row = 0;
+    for (u32 i = 0; i < count; ++i) {
+      Record& rec = record(ids[i]);
+      ASSERT(!rec.archetype, "Instantiating into an entity that already has components");
+      rec.archetype = arch;
+      arch->Push(ids[i], rec.chunk, rec.row);
+      if (i == 0) {
+        first_chunk = rec.chunk;
+        first_row = rec.row;
+      }
+    }
+    // chunks never move so the prefab's components stay put while rows are pushed
+    const Record& src = m_Records[EntityIndex(prefab)];
+    u32 last_chunk = arch->ChunkCount() - 1;
+    for (u32 col = 0; col < arch->Types().size(); ++col) {
+      const void* comp = arch->At(src.chunk, col, src.row);
+      for (u32 c = first_chunk; c <= last_chunk; ++c) {
+        u32 begin = c == first_chunk ? first_row : 0;
+        arch->Replicate(c, col, begin, arch->GetChunk(c).count, comp, *m_Tick);
+      }
+    }
+  }
+
+  void ArchetypeStorage::CopyFrom(const ArchetypeStorage& other) {
+    // archetypes are put in the same order as the other's so views iterate the same way
+    u32 count = (u32) other.m_ArchetypeList.size();
+    for (u32 i = 0; i < count; ++i) {
+      const Archetype* from = other.m_ArchetypeList[i];
+      auto itr = m_Archetypes.find(from->GetSignature());
+      Archetype* arch = itr != m_Archetypes.end() ? itr->second.get()
+        : getArchetype(from->GetSignature(), from->Types());
+      std::swap(m_ArchetypeList[i], m_ArchetypeList[arch->m_ListIndex]);
+      m_ArchetypeList[arch->m_ListIndex]->m_ListIndex = arch->m_ListIndex;
+      arch->m_ListIndex = i;
+      arch->CopyFrom(*from);
+    }
+    // archetypes only this storage has stay around empty
+    for (u32 i = count; i < m_ArchetypeList.size(); ++i) {
+      m_ArchetypeList[i]->Clear();
+    }
+    m_Records = other.m_Records;
+    for (Record& rec : m_Records) {
+      if (rec.archetype)
+        rec.archetype = m_ArchetypeList[rec.archetype->m_ListIndex];
+    }
+  }
+
+  void ArchetypeStorage::EntityDestroyed(u32 id) {
+    u32 idx = EntityIndex(id);
+    if (idx >= m_Records.size())
+      return;
+    Record& rec = m_Records[idx];
+    if (!rec.archetype)
+      return;
+    rec.archetype->DestroyRow(rec.chunk, rec.row);
+    u32 moved = rec.archetype->Fill(rec.chunk, rec.row);
+    if (moved) {
+      m_Records[EntityIndex(moved)].chunk = rec.chunk;
+      m_Records[EntityIndex(moved)].row = rec.row;
+    }
+    rec = Record{};
+  }
+
+  void ArchetypeStorage::Match(const Signature& sig, std::vector<Archetype*>& out) const {
+    for (Archetype* arch : m_ArchetypeList) {
+      if (arch->GetSignature().Contains(sig))
+        out.push_back(arch);
+    }
+  }
+
+  ArchetypeStorage::Record& ArchetypeStorage::record(u32 id) {
+    u32 idx = EntityIndex(id);
+    if (idx >= m_Records.size())
+      m_Records.resize(idx + 1);
+    return m_Records[idx];
+  }
+
+  bool ArchetypeStorage::remove(u32 id, u32 tid) {
+    u32 idx = EntityIndex(id);
+    if (idx >= m_Records.size())
+      return false;
+    Record& rec = m_Records[idx];
+    // nothing to remove
+    if (!rec.archetype || rec.archetype->Column(tid) < 0)
+      return false;
+
+    Archetype* dst = withoutComponent(rec.archetype, tid);
+    if (dst) {
+      move(id, dst);
+    } else {
+      // that was the last component
+      EntityDestroyed(id);
+    }
+    return true;
+  }
+
+  void ArchetypeStorage::move(u32 id, Archetype* dst) {
+    Record& rec = m_Records[EntityIndex(id)];
+    Archetype* src = rec.archetype;
+    u32 chunk, row;
+    dst->Push(id, chunk, row);
+
+    if (src) {
+      // carry over what both archetypes have and destroy the rest
+      for (u32 i = 0; i < src->m_Types.size(); ++i) {
+        const ComponentInfo& info = src->m_Types[i];
+        i32 col = dst->Column(info.id);
+        if (col >= 0) {
+          info.relocate(dst->At(chunk, col, row), src->At(rec.chunk, i, rec.row));
+          Chunk& from = src->GetChunk(rec.chunk);
+          dst->Stamp(chunk, col, row, src->AddedTicks(from, i)[rec.row], src->ChangedTicks(from, i)[rec.row]);
+        } else {
+          info.destroy(src->At(rec.chunk, i, rec.row));
+        }
+      }
+      u32 moved = src->Fill(rec.chunk, rec.row);
+      if (moved) {
+        m_Records[EntityIndex(moved)].chunk = rec.chunk;
+        m_Records[EntityIndex(moved)].row = rec.row;
+      }
+    }
+
+    rec.archetype = dst;
+    rec.chunk = chunk;
+    rec.row = row;
+  }
+
+  Archetype* ArchetypeStorage::withComponent(Archetype* src, const ComponentInfo& info) {
+    if (src) {
+      auto itr = src->m_AddEdges.find(info.id);
+      if (itr != src->m_AddEdges.end())
+        return itr->second;
+    }
+
+    Signature sig;
+    std::vector<ComponentInfo> types;
+    if (src) {
+      sig = src->m_Signature;
+      types = src->m_Types;
+    }
+    sig.Set(info.id);
+    // keep the columns sorted by type id
+    auto pos = std::lower_bound(types.begin(), types.end(), info.id,
+        [](const ComponentInfo& a, u32 id) { return a.id < id; });
+    types.insert(pos, info);
+
+    Archetype* dst = getArchetype(sig, std::move(types));
+    if (src) {
+      src->m_AddEdges[info.id] = dst;
+      dst->m_RemoveEdges[info.id] = src;
+    }
+    return dst;
+  }
+
+  Archetype* ArchetypeStorage::withoutComponent(Archetype* src, u32 tid) {
+    auto itr = src->m_RemoveEdges.find(tid);
+    if (itr != src->m_RemoveEdges.end())
+      return itr->second;
+
+    Signature sig = src->m_Signature;
+    sig.Reset(tid);
+    if (sig.Empty())
+      return nullptr;
+
+    std::vector<ComponentInfo> types;
+    for (auto& info : src->m_Types) {
+      if (info.id != tid)
+        types.push_back(info);
+    }
+
+    Archetype* dst = getArchetype(sig, std::move(types));
+    src->m_RemoveEdges[tid] = dst;
+    dst->m_AddEdges[tid] = src;
+    return dst;
+  }
+
+  Archetype* ArchetypeStorage::getArchetype(const Signature& sig, std::vector<ComponentInfo> types) {
+    auto itr = m_Archetypes.find(sig);
+    if (itr != m_Archetypes.end())
+      return itr->second.get();
+
+    INFO("Adding archetype with %d component types", (u32) types.size());
+    auto arch = CreateScope<Archetype>(sig, std::move(types), &m_ChunkPool);
+    Archetype* ret = arch.get();
+    m_Archetypes.emplace(sig, std::move(arch));
+    ret->m_ListIndex = (u32) m_ArchetypeList.size();
+    m_ArchetypeList.push_back(ret);
+    return ret;
+  }
+}
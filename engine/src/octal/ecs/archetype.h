@@ -0,0 +1,370 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/core/logger.h"
+#include "octal/core/memory.h"
+#include "octal/ecs/components.h"
+#include "octal/ecs/entityid.h"
+#include "octal/ecs/signature.h"
+#include "octal/ecs/typeid.h"
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace octal {
+
+  /// A fixed size block of memory holding the components of some entities of one archetype
+  /// The entity ids come first followed by one column per component type (SoA)
+  struct Chunk {
+    /// Start of the block
+    u8* data;
+    /// Number of entities stored in the block
+    u32 count;
+    /// Change ticks of the block, see Archetype::AddedTicks
+    u32* ticks;
+  };
+
+  /// All the entities that have exactly the same set of components
+  /// Their components are packed into chunks so iterating them is linear
+  class Archetype {
+    public:
+      /// Size of a single chunk in bytes
+      static constexpr u32 CHUNK_SIZE = 16 * 1024;
+
+      /// Create an archetype
+      /// @param sig the set of component types in this archetype
+      /// @param types description of each component type, sorted by id
+      /// @param pool of CHUNK_SIZE blocks to take chunks from, null to use the heap
+      Archetype(const Signature& sig, std::vector<ComponentInfo> types, PoolAllocator* pool = nullptr);
+      /// Destroys every component still stored and frees the chunks
+      ~Archetype();
+
+      /// The set of component types in this archetype
+      const Signature& GetSignature() const { return m_Signature; }
+
+      /// The component types in this archetype sorted by id
+      const std::vector<ComponentInfo>& Types() const { return m_Types; }
+
+      /// Number of entities that fit in a single chunk
+      u32 Capacity() const { return m_Capacity; }
+
+      /// Number of chunks currently allocated
+      u32 ChunkCount() const { return (u32) m_Chunks.size(); }
+
+      /// Number of entities in this archetype
+      u32 Size() const { return m_Size; }
+
+      /// Get a chunk
+      /// @param i index of the chunk
+      Chunk& GetChunk(u32 i) { return m_Chunks[i]; }
+
+      /// Find the column holding a component type
+      /// @param tid the type id of the component
+      /// @return the index of the column or -1 if this archetype doesn't have the type
+      i32 Column(u32 tid) const {
+        return tid < m_ColumnOf.size() ? m_ColumnOf[tid] : -1;
+      }
+
+      /// The entity ids stored in a chunk
+      u32* Entities(Chunk& chunk) const {
+        return (u32*) chunk.data;
+      }
+
+      /// Start of a column in a chunk
+      /// @param chunk the chunk to look in
+      /// @param column index of the column from Column()
+      void* Data(Chunk& chunk, u32 column) const {
+        return chunk.data + m_Offsets[column];
+      }
+
+      /// Address of a single component
+      /// @param chunk index of the chunk
+      /// @param column index of the column
+      /// @param row index of the entity in the chunk
+      void* At(u32 chunk, u32 column, u32 row) {
+        return m_Chunks[chunk].data + m_Offsets[column] + row * m_Types[column].size;
+      }
+
+      /// Tick each component of a column in a chunk was added in
+      /// Ticks are kept apart from the component data so columns stay packed
+      u32* AddedTicks(Chunk& chunk, u32 column) const {
+        return chunk.ticks + column * m_Capacity;
+      }
+
+      /// Tick each component of a column in a chunk was last changed in
+      u32* ChangedTicks(Chunk& chunk, u32 column) const {
+        return chunk.ticks + (m_Types.size() + column) * m_Capacity;
+      }
+
+      /// Newest tick any component of a column in a chunk was added or changed in
+      /// Lets filtered views skip whole chunks that haven't changed
+      u32& ColumnTick(Chunk& chunk, u32 column) const {
+        return chunk.ticks[2 * m_Types.size() * m_Capacity + column];
+      }
+
+      /// Set the ticks of a single component
+      /// @param chunk index of the chunk
+      /// @param column index of the column
+      /// @param row index of the entity in the chunk
+      /// @param added tick the component was added in
+      /// @param changed tick the component was last changed in
+      void Stamp(u32 chunk, u32 column, u32 row, u32 added, u32 changed) {
+        Chunk& c = m_Chunks[chunk];
+        AddedTicks(c, column)[row] = added;
+        ChangedTicks(c, column)[row] = changed;
+        u32& newest = ColumnTick(c, column);
+        if (changed > newest)
+          newest = changed;
+      }
+
+      /// Mark a single component as changed
+      /// @param chunk the chunk the component is in
+      /// @param column index of the column
+      /// @param row index of the entity in the chunk
+      /// @param tick the current tick
+      void Touch(Chunk& chunk, u32 column, u32 row, u32 tick) {
+        ChangedTicks(chunk, column)[row] = tick;
+        ColumnTick(chunk, column) = tick;
+      }
+
+      /// Reserve a row at the end of the archetype for an entity
+      /// The component memory of the row is left uninitialized
+      /// @param id of the entity
+      /// @param chunk set to the chunk the entity was placed in
+      /// @param row set to the row the entity was placed in
+      void Push(u32 id, u32& chunk, u32& row);
+
+      /// Destroy the components of a row, leaving it as raw memory
+      /// @param chunk index of the chunk
+      /// @param row index of the row in the chunk
+      void DestroyRow(u32 chunk, u32 row);
+
+      /// Copy construct a component into a range of rows of one chunk
+      /// Trivially copyable components are copied in blocks that double in size.
+      /// @param chunk index of the chunk
+      /// @param column index of the column
+      /// @param begin first row, its memory must be uninitialized like the rest
+      /// @param end row past the last one
+      /// @param src the component to copy
+      /// @param tick stamped as the added and changed tick of every copy
+      void Replicate(u32 chunk, u32 column, u32 begin, u32 end, const void* src, u32 tick);
+
+      /// Replace every entity and component with a copy of another archetype with the same signature
+      /// Chunks this archetype already has are reused.
+      void CopyFrom(const Archetype& other);
+
+      /// Destroy every component and give back the chunks
+      void Clear();
+
+      /// Fill a row whose components have been destroyed or moved out with the last row
+      /// @param chunk index of the chunk
+      /// @param row index of the row in the chunk
+      /// @return the id of the entity that was moved into the row or 0 if none was
+      u32 Fill(u32 chunk, u32 row);
+
+    private:
+      friend class ArchetypeStorage;
+
+      /// Get the memory for a new chunk
+      u8* allocateChunk();
+
+      /// Give back the memory of a chunk
+      void freeChunk(u8* data);
+
+      /// Get zeroed change ticks for a new chunk, counted against MemoryTag::ECS
+      u32* allocateTicks();
+
+      /// Set of component types in this archetype
+      Signature m_Signature;
+
+      /// Description of each column
+      std::vector<ComponentInfo> m_Types;
+
+      /// Byte offset of each column from the start of a chunk
+      std::vector<u32> m_Offsets;
+
+      /// Column index of each type id or -1
+      std::vector<i32> m_ColumnOf;
+
+      /// Allocated chunks, every chunk except the last is full
+      std::vector<Chunk> m_Chunks;
+
+      /// Size of a chunk, only bigger than CHUNK_SIZE if a single entity doesn't fit
+      u32 m_ChunkBytes{CHUNK_SIZE};
+
+      /// Number of ticks stored for each chunk
+      u32 m_TickCount{0};
+
+      /// Alignment of chunk memory
+      u32 m_ChunkAlign{64};
+
+      /// Pool chunks come from, null if they don't fit its blocks
+      PoolAllocator* m_Pool{nullptr};
+
+      /// Entities per chunk
+      u32 m_Capacity{0};
+
+      /// Number of entities in this archetype
+      u32 m_Size{0};
+
+      /// Position in ArchetypeStorage's list of archetypes
+      u32 m_ListIndex{0};
+
+      /// Archetype reached by adding a component type to this one
+      std::unordered_map<u32, Archetype*> m_AddEdges;
+
+      /// Archetype reached by removing a component type from this one
+      std::unordered_map<u32, Archetype*> m_RemoveEdges;
+  };
+
+  /// Stores components grouped by archetype rather than by component type
+  /// Entities move between archetypes when components are added or removed
+  class ArchetypeStorage {
+    private:
+      /// Snapshots place loaded entities directly
+      friend class Snapshot;
+
+      /// Where an entity lives
+      struct Record {
+        /// Archetype of the entity, or null if it has no components
+        Archetype* archetype{nullptr};
+        /// Chunk the entity is in
+        u32 chunk{0};
+        /// Row of the chunk the entity is in
+        u32 row{0};
+      };
+
+      /// Location of each entity indexed by the index part of its id
+      std::vector<Record> m_Records;
+
+      /// Chunks of every archetype, so chunks freed by one are reused without
+      /// reaching the heap. Declared before the archetypes so it outlives them.
+      PoolAllocator m_ChunkPool{Archetype::CHUNK_SIZE, 64, 16, MemoryTag::ECS};
+
+      /// Every archetype by its signature
+      std::unordered_map<Signature, Scope<Archetype>, Signature::Hash> m_Archetypes;
+
+      /// Every archetype in creation order, for iteration
+      std::vector<Archetype*> m_ArchetypeList;
+
+      /// Current change tick of the ecs
+      const u32* m_Tick;
+
+    public:
+      /// Constructor
+      /// @param tick the current change tick of the ecs that owns this storage
+      ArchetypeStorage(const u32* tick) : m_Tick(tick) {};
+      /// Destructor
+      ~ArchetypeStorage() {};
+
+      /// Create a new component, moving the entity to its new archetype
+      /// @param id the id of the entity to add
+      /// @param args the arguments to the constructor of the component
+      template<typename C, typename... Args>
+      void Add(u32 id, Args&&... args) {
+        u32 tid = TypeId<C>();
+        Record& rec = record(id);
+        if (rec.archetype && rec.archetype->Column(tid) >= 0) {
+          WARN("Entity %d already has this component! Skipping...", id);
+          return;
+        }
+        Archetype* dst = withComponent(rec.archetype, ComponentInfo::Create<C>(tid));
+        move(id, dst);
+        // everything else was moved over so construct the new component
+        u32 col = (u32) dst->Column(tid);
+        new (dst->At(rec.chunk, col, rec.row)) C(std::forward<Args>(args)...);
+        dst->Stamp(rec.chunk, col, rec.row, *m_Tick, *m_Tick);
+      }
+
+      /// Remove a component, moving the entity to its new archetype
+      /// @param id the id of the entity to remove from
+      /// @return false if the entity had no component to remove
+      template<typename C>
+      bool Remove(u32 id) {
+        return remove(id, TypeId<C>());
+      }
+
+      /// Get a reference to the component for this entity
+      /// Components that aren't const are marked as changed
+      /// @param id of the entity whos component we are getting
+      template<typename C>
+      C* Get(u32 id) {
+        u32 idx = EntityIndex(id);
+        if (idx >= m_Records.size())
+          return nullptr;
+        Record& rec = m_Records[idx];
+        if (!rec.archetype)
+          return nullptr;
+        i32 col = rec.archetype->Column(TypeId<C>());
+        if (col < 0)
+          return nullptr;
+        if constexpr (!std::is_const_v<C>) {
+          rec.archetype->Touch(rec.archetype->GetChunk(rec.chunk), col, rec.row, *m_Tick);
+        }
+        return (C*) rec.archetype->At(rec.chunk, col, rec.row);
+      }
+
+      /// The archetype an entity is in
+      /// @param id of the entity
+      /// @return the archetype, or null if the entity has no components
+      Archetype* ArchetypeOf(u32 id) const {
+        u32 idx = EntityIndex(id);
+        return idx < m_Records.size() ? m_Records[idx].archetype : nullptr;
+      }
+
+      /// Destroy all of an entity's components
+      /// @param id of the entity that was destroyed
+      void EntityDestroyed(u32 id);
+
+      /// Give many entities a copy of every component of another entity
+      /// They are all placed in the archetype of the prefab at once.
+      /// @param prefab the entity to copy
+      /// @param ids the entities to copy to, must not have any components yet
+      /// @param count number of entities
+      void Instantiate(u32 prefab, const u32* ids, u32 count);
+
+      /// Replace every archetype and entity with a copy of another storage
+      /// Archetypes both storages have are reused along with their chunks, only
+      /// archetypes and chunks this storage is short of are allocated.
+      void CopyFrom(const ArchetypeStorage& other);
+
+      /// The set of type ids for some component types
+      template<typename... Cs>
+      static Signature SignatureOf() {
+        Signature sig;
+        (sig.Set(TypeId<Cs>()), ...);
+        return sig;
+      }
+
+      /// Every archetype that has at least the components in a signature
+      /// @param sig the components to look for
+      /// @param out vector to fill with the matching archetypes
+      void Match(const Signature& sig, std::vector<Archetype*>& out) const;
+
+    private:
+      /// Get the record of an entity, growing the records if needed
+      Record& record(u32 id);
+
+      /// Remove a component by type id
+      /// @return false if the entity had no component to remove
+      bool remove(u32 id, u32 tid);
+
+      /// Move an entity to another archetype
+      /// Components that both archetypes have are moved along with their ticks, others in the old archetype are destroyed.
+      /// Components only in the new archetype are left uninitialized.
+      /// @param id of the entity
+      /// @param dst the archetype to move to
+      void move(u32 id, Archetype* dst);
+
+      /// Get or create the archetype with the components of src plus one more
+      Archetype* withComponent(Archetype* src, const ComponentInfo& info);
+
+      /// Get or create the archetype with the components of src minus one
+      /// @return the archetype, or null if no components are left
+      Archetype* withoutComponent(Archetype* src, u32 tid);
+
+      /// Get or create the archetype with a given set of components
+      Archetype* getArchetype(const Signature& sig, std::vector<ComponentInfo> types);
+  };
+}
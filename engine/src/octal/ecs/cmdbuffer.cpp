@@ -0,0 +1,72 @@
+#include "octal/ecs/cmdbuffer.h"
+#include "octal/core/memory.h"
+#include <algorithm>
+
+namespace octal {
+
+  CommandBuffer::~CommandBuffer() {
+    Reset();
+  }
+
+  void CommandBuffer::Playback(ECS& ecs, CommandBuffer** buffers, u32 count) {
+    // entities created while recording come alive first
+    ecs.CommitReserved();
+
+    u64 total = 0;
+    for (u32 i = 0; i < count; ++i) {
+      total += buffers[i]->m_Commands.size();
+    }
+    std::pmr::vector<Command> all(Memory::FrameResource());
+    all.reserve(total);
+    for (u32 i = 0; i < count; ++i) {
+      all.insert(all.end(), buffers[i]->m_Commands.begin(), buffers[i]->m_Commands.end());
+    }
+    // group by type but keep the recorded order within a type
+    std::stable_sort(all.begin(), all.end(),
+        [](const Command& a, const Command& b) { return a.key < b.key; });
+
+    for (auto& cmd : all) {
+      cmd.apply(ecs, cmd.id, cmd.data);
+    }
+
+    // the data has been moved out and destroyed so just forget about it
+    for (u32 i = 0; i < count; ++i) {
+      buffers[i]->m_Commands.clear();
+      buffers[i]->rewind();
+    }
+  }
+
+  void CommandBuffer::Reset() {
+    for (auto& cmd : m_Commands) {
+      if (cmd.discard)
+        cmd.discard(cmd.data);
+    }
+    m_Commands.clear();
+    rewind();
+  }
+
+  void* CommandBuffer::allocate(u64 size, u64 align) {
+    while (true) {
+      if (m_Current == m_Blocks.size()) {
+        u64 block_size = std::max(BLOCK_SIZE, size + align);
+        m_Blocks.push_back({Scope<u8[]>(new u8[block_size]), block_size, 0});
+      }
+      Block& block = m_Blocks[m_Current];
+      u64 base = (u64) block.data.get();
+      u64 start = (base + block.used + align - 1) & ~(align - 1);
+      if (start + size <= base + block.size) {
+        block.used = start + size - base;
+        return (void*) start;
+      }
+      // doesn't fit so move on to the next block
+      ++m_Current;
+    }
+  }
+
+  void CommandBuffer::rewind() {
+    for (auto& block : m_Blocks) {
+      block.used = 0;
+    }
+    m_Current = 0;
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/ecs/ecs.h"
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace octal {
+
+  /// Records structural changes to an ECS so they can be applied later
+  /// Adding or removing components while a view is being iterated would move
+  /// components around underneath it, so systems record their changes here
+  /// and they are played back together at a sync point. Component data lives
+  /// in an arena owned by the buffer that is reused between playbacks.
+  /// A single buffer must only be used by one thread at a time.
+  class CommandBuffer {
+    public:
+      /// Size of each block of the arena
+      static constexpr u64 BLOCK_SIZE = 64 * 1024;
+
+      /// Constructor
+      CommandBuffer() {};
+      /// Destroys any component data that was never played back
+      ~CommandBuffer();
+
+      /// Create an entity
+      /// The id is usable right away but the entity isn't alive until playback
+      /// @param ecs the ecs the entity will belong to
+      /// @return the id of the new entity
+      u32 CreateEntity(ECS& ecs) {
+        return ecs.ReserveEntity();
+      }
+
+      /// Destroy an entity at playback
+      /// @param id of the entity
+      void DestroyEntity(u32 id) {
+        m_Commands.push_back({DESTROY, id, nullptr,
+            [](ECS& ecs, u32 id, void*) { ecs.DestroyEntity(id); },
+            nullptr});
+      }
+
+      /// Add a component at playback, dropped if the entity is dead by then
+      /// @param id of the entity
+      /// @param args arguments to the constructor of the component, which is built now
+      template<typename C, typename... Args>
+      void AddComponent(u32 id, Args&&... args) {
+        void* data = allocate(sizeof(C), alignof(C));
+        new (data) C(std::forward<Args>(args)...);
+        m_Commands.push_back({TypeId<C>(), id, data,
+            [](ECS& ecs, u32 id, void* data) {
+              C* comp = (C*) data;
+              // the entity may have been destroyed since this was recorded
+              if (ecs.IsAlive(id))
+                ecs.AddComponent(id, std::move(*comp));
+              comp->~C();
+            },
+            [](void* data) { ((C*) data)->~C(); }});
+      }
+
+      /// Remove a component at playback
+      /// @param id of the entity
+      template<typename C>
+      void RemoveComponent(u32 id) {
+        m_Commands.push_back({TypeId<C>(), id, nullptr,
+            [](ECS& ecs, u32 id, void*) { ecs.template RemoveComponent<C>(id); },
+            nullptr});
+      }
+
+      /// Number of commands waiting to be played back
+      u32 Size() const { return (u32) m_Commands.size(); }
+
+      /// Apply every recorded command and clear the buffer
+      /// @param ecs to apply the commands to
+      void Playback(ECS& ecs) {
+        CommandBuffer* self = this;
+        Playback(ecs, &self, 1);
+      }
+
+      /// Apply the commands of several buffers together and clear them
+      /// Commands are grouped by component type so each store is visited in one
+      /// go, keeping the recorded order for the same type. Destroys go last.
+      /// @param ecs to apply the commands to
+      /// @param buffers to play back, in order
+      /// @param count number of buffers
+      static void Playback(ECS& ecs, CommandBuffer** buffers, u32 count);
+
+      /// Throw away every recorded command
+      void Reset();
+
+    private:
+      /// Sort key used for destroying entities so they come after everything else
+      static constexpr u32 DESTROY = ~0u;
+
+      /// A recorded change
+      struct Command {
+        /// Type id of the component, or DESTROY
+        u32 key;
+        /// Entity to change
+        u32 id;
+        /// Component data in the arena, if any
+        void* data;
+        /// Applies the change
+        void (*apply)(ECS& ecs, u32 id, void* data);
+        /// Destroys the data if the command is thrown away
+        void (*discard)(void* data);
+      };
+
+      /// A block of the arena
+      struct Block {
+        Scope<u8[]> data;
+        u64 size;
+        u64 used;
+      };
+
+      /// Bump allocate from the arena
+      void* allocate(u64 size, u64 align);
+
+      /// Rewind the arena without freeing its blocks
+      void rewind();
+
+      /// Recorded commands in order
+      std::vector<Command> m_Commands;
+
+      /// Blocks of the arena
+      std::vector<Block> m_Blocks;
+
+      /// Block we are allocating from
+      u32 m_Current{0};
+  };
+}
@@ -1,8 +1,109 @@
 #pragma once
+#include "octal/defines.h"
+#include "octal/math/math.h"
+#include "octal/ecs/typeid.h"
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace octal {
 
   /// Dummy type for all components to inherit from
   struct Component {};
 
+  /// Position, rotation and scale of an entity relative to its parent
+  /// World matrices are kept up to date by TransformHierarchy
+  struct Transform : Component {
+    vec3 position;
+    quat rotation;
+    vec3 scale{1.0f};
+
+    Transform(const vec3& position = {}, const quat& rotation = {}, const vec3& scale = vec3(1.0f))
+      : position(position), rotation(rotation), scale(scale) {}
+
+    /// Matrix from this transform's space to its parent's
+    mat4 Local() const { return Compose(position, rotation, scale); }
+  };
+
+  /// Matrix from an entity's space to the world, written by TransformHierarchy
+  struct WorldTransform : Component {
+    mat4 matrix;
+  };
+
+  /// Makes an entity the child of another, its Transform is then relative to the parent
+  struct Parent : Component {
+    /// Id of the parent entity
+    u32 entity;
+
+    Parent(u32 entity = 0) : entity(entity) {}
+  };
+
+  /// Relation owning an entity by another, used as ECS::Relate<ChildOf>(child, parent)
+  /// Destroying the parent destroys the child. Transforms still follow Parent.
+  struct ChildOf {
+    static constexpr bool CASCADE = true;
+  };
+
+  /// Bounding box of an entity in its own space
+  /// Spatial indexes use it with the WorldTransform, entities without one are points
+  struct Bounds : Component {
+    AABB box;
+
+    Bounds(const AABB& box = {}) : box(box) {}
+  };
+
+  /// Type erased description of a component type
+  /// Used by storage that keeps components of many types in raw memory
+  struct ComponentInfo {
+    /// Type id of the component
+    u32 id;
+    /// Size of the component in bytes
+    u32 size;
+    /// Alignment of the component in bytes
+    u32 align;
+    /// Hash of the type's name, the same in every binary
+    u64 hash;
+    /// Can the component be copied as raw bytes?
+    bool trivial;
+    /// Move construct a component into raw memory at dst and destroy the one at src
+    void (*relocate)(void* dst, void* src);
+    /// Destroy the component at ptr
+    void (*destroy)(void* ptr);
+    /// Copy construct a component into raw memory at dst, null if the type can't be copied
+    void (*copy)(void* dst, const void* src);
+
+    /// Describe a component type
+    /// @param id the type id of C
+    template<typename C>
+    static ComponentInfo Create(u32 id) {
+      return {
+        id,
+        (u32) sizeof(C),
+        (u32) alignof(C),
+        TypeHash<C>(),
+        std::is_trivially_copyable_v<C>,
+        [](void* dst, void* src) {
+          new (dst) C(std::move(*(C*) src));
+          ((C*) src)->~C();
+        },
+        [](void* ptr) {
+          ((C*) ptr)->~C();
+        },
+        copier<C>(),
+      };
+    }
+
+    /// The copy function of a type, or null if it can't be copied
+    template<typename C>
+    static constexpr auto copier() -> void (*)(void*, const void*) {
+      if constexpr (std::is_copy_constructible_v<C>) {
+        return [](void* dst, const void* src) {
+          new (dst) C(*(const C*) src);
+        };
+      } else {
+        return nullptr;
+      }
+    }
+  };
+
 }
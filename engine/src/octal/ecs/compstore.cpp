@@ -1,3 +1,97 @@
 #include "octal/ecs/compstore.h"
+#include <cstring>
 namespace octal {
+
+  /// Allocate a page of the sparse index with every slot empty
+  static u32* allocatePage() {
+    u32* page = (u32*) Platform::Allocate(CompStoreBase::PAGE_SIZE * sizeof(u32), false, MemoryTag::ECS);
+    ASSERT(page, "Out of memory");
+    return page;
+  }
+
+  CompStoreBase::~CompStoreBase() {
+    for (u32* page : m_Sparse) {
+      Platform::Free(page);
+    }
+  }
+
+  u32& CompStoreBase::slot(u32 id) {
+    u32 idx = EntityIndex(id);
+    u32 page = idx / PAGE_SIZE;
+    // grow the page table to cover this id
+    if (page >= m_Sparse.size()) {
+      m_Sparse.resize(page + 1);
+    }
+    // only allocate the page once something lives in it
+    if (!m_Sparse[page]) {
+      m_Sparse[page] = allocatePage();
+      memset(m_Sparse[page], 0, PAGE_SIZE * sizeof(u32));
+    }
+    return m_Sparse[page][idx % PAGE_SIZE];
+  }
+
+  u32 CompStoreBase::insert(u32 id) {
+    u32 idx = (u32) m_Dense.size();
+    m_Dense.push_back(id);
+    m_Added.push_back(*m_Tick);
+    m_Changed.push_back(*m_Tick);
+    slot(id) = idx + 1;
+    return idx;
+  }
+
+  void CompStoreBase::erase(u32 id) {
+    u32& s = slot(id);
+    u32 idx = s - 1;
+    u32 last_id = m_Dense.back();
+    // move the last entity into the hole and point its slot there
+    m_Dense[idx] = last_id;
+    m_Added[idx] = m_Added.back();
+    m_Changed[idx] = m_Changed.back();
+    slot(last_id) = idx + 1;
+    m_Dense.pop_back();
+    m_Added.pop_back();
+    m_Changed.pop_back();
+    // clear after the move in case this was the last entity
+    s = 0;
+  }
+
+  void CompStoreBase::load(const u32* entities, u32 count) {
+    m_Dense.assign(entities, entities + count);
+    m_Added.assign(count, *m_Tick);
+    m_Changed.assign(count, *m_Tick);
+    for (u32 i = 0; i < count; ++i) {
+      slot(entities[i]) = i + 1;
+    }
+  }
+
+  void CompStoreBase::insert(const u32* ids, u32 count) {
+    u32 first = (u32) m_Dense.size();
+    m_Dense.insert(m_Dense.end(), ids, ids + count);
+    m_Added.resize(first + count, *m_Tick);
+    m_Changed.resize(first + count, *m_Tick);
+    for (u32 i = 0; i < count; ++i) {
+      slot(ids[i]) = first + i + 1;
+    }
+  }
+
+  void CompStoreBase::copyFrom(const CompStoreBase& other) {
+    for (size_t p = other.m_Sparse.size(); p < m_Sparse.size(); ++p) {
+      Platform::Free(m_Sparse[p]);
+    }
+    m_Sparse.resize(other.m_Sparse.size(), nullptr);
+    for (size_t p = 0; p < other.m_Sparse.size(); ++p) {
+      if (!other.m_Sparse[p]) {
+        Platform::Free(m_Sparse[p]);
+        m_Sparse[p] = nullptr;
+        continue;
+      }
+      // keep pages that are already allocated
+      if (!m_Sparse[p])
+        m_Sparse[p] = allocatePage();
+      memcpy(m_Sparse[p], other.m_Sparse[p], PAGE_SIZE * sizeof(u32));
+    }
+    m_Dense = other.m_Dense;
+    m_Added = other.m_Added;
+    m_Changed = other.m_Changed;
+  }
 }
@@ -1,23 +1,187 @@
 #pragma once
 #include "octal/defines.h"
 #include "octal/core/logger.h"
+#include "octal/core/asserts.h"
+#include "octal/core/memory.h"
 #include "octal/ecs/components.h"
+#include "octal/ecs/entityid.h"
 #include "platform/platform.h"
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
 
 namespace octal {
 
+  template<typename... Cs>
+  class View;
+
   /// Virtual class for which component storage is derived
+  /// Owns the sparse set that maps entity ids to indices in the packed arrays.
+  /// The sparse index is keyed by the index part of the id, while the packed
+  /// entity array keeps the full id.
+  /// The sparse index is split into pages that are only allocated once an id
+  /// inside of them is given a component, so memory grows with the components
+  /// that actually exist rather than with the highest possible entity id.
+  /// Each component also remembers the change tick it was added and last changed in.
+  /// Everything a store holds is counted against MemoryTag::ECS.
   class CompStoreBase {
     public:
-    /// Creates a component storage container
-    /// @param max maximum number of entities
-    CompStoreBase() {};
+      /// Number of entity ids covered by a single page of the sparse index
+      static constexpr u32 PAGE_SIZE = 4096;
+
+      /// Creates a component storage container
+      /// @param tick the current change tick of the ecs that owns this store
+      /// @param info description of the component type stored
+      CompStoreBase(const u32* tick, const ComponentInfo& info) : m_Tick(tick), m_Info(info) {};
+
+      /// Virtual destructor
+      virtual ~CompStoreBase();
+
+      CompStoreBase(const CompStoreBase&) = delete;
+      CompStoreBase& operator=(const CompStoreBase&) = delete;
+
+      /// Notify the component store that an entity was destroyed
+      virtual void EntityDestroyed(u32 id) = 0;
+
+      /// Packed array of the components in this store as raw bytes
+      virtual const void* RawData() const = 0;
+
+      /// Replace everything in an empty store with packed components copied from raw memory
+      /// Only possible for trivially copyable components. Every component is
+      /// stamped as added in the current tick.
+      /// @param entities the owner of each component
+      /// @param data the components, aligned for the component type
+      /// @param count number of components
+      virtual void Load(const u32* entities, const void* data, u32 count) = 0;
+
+      /// Give many entities a copy of another entity's component
+      /// @param src the entity to copy from, must have a component here
+      /// @param ids the entities to copy to, must not have components here yet
+      /// @param count number of entities
+      virtual void Copy(u32 src, const u32* ids, u32 count) = 0;
+
+      /// Create an empty store for the same component type
+      /// @param tick the current change tick of the ecs that will own the store
+      virtual Scope<CompStoreBase> CreateEmpty(const u32* tick) const = 0;
+
+      /// Replace everything in this store with a copy of another store of the same type
+      /// Change ticks are copied too.
+      virtual void CopyFrom(const CompStoreBase& other) = 0;
+
+      /// Description of the component type stored
+      const ComponentInfo& Info() const {
+        return m_Info;
+      }
+
+      /// Does this entity have a component in this store?
+      /// @param id of the entity to check
+      bool Has(u32 id) const {
+        return index(id) != 0;
+      }
+
+      /// Number of components in this store
+      u32 Size() const {
+        return (u32) m_Dense.size();
+      }
+
+      /// Packed array of the entities that own the components in this store
+      /// Entity at index i owns the component at index i
+      const u32* Entities() const {
+        return m_Dense.data();
+      }
+
+      /// Tick each component was added in, in the same order as Entities
+      const u32* AddedTicks() const {
+        return m_Added.data();
+      }
+
+      /// Tick each component was last changed in, in the same order as Entities
+      const u32* ChangedTicks() const {
+        return m_Changed.data();
+      }
+
+      /// Mark an entity's component as changed in the current tick
+      /// @param id of the entity
+      void MarkChanged(u32 id) {
+        u32 idx = index(id);
+        if (idx != 0)
+          m_Changed[idx - 1] = *m_Tick;
+      }
+
+    protected:
+      /// Views look up the dense index of components directly
+      template<typename... Cs>
+      friend class View;
+
+      /// Get the dense index of an entity's component
+      /// @param id of the entity
+      /// @return the index plus one, or 0 if the entity has no component here
+      u32 index(u32 id) const {
+        u32 idx = EntityIndex(id);
+        u32 page = idx / PAGE_SIZE;
+        if (page >= m_Sparse.size() || !m_Sparse[page])
+          return 0;
+        return m_Sparse[page][idx % PAGE_SIZE];
+      }
+
+      /// Allocator every array of a store comes from
+      static std::pmr::memory_resource* resource() {
+        return Memory::Resource(MemoryTag::ECS);
+      }
+
+      /// Add an entity to the end of the packed array
+      /// @param id of the entity we are adding
+      /// @return the dense index the entity's component should go in
+      u32 insert(u32 id);
+
+      /// Remove an entity from the packed array by swapping the last entity into its place
+      /// Derived classes must move their component data the same way before calling this
+      /// @param id of the entity we are removing
+      void erase(u32 id);
+
+      /// Mark the component at a dense index as changed in the current tick
+      void touch(u32 idx) {
+        m_Changed[idx] = *m_Tick;
+      }
+
+      /// Fill the packed arrays of an empty store in one go
+      /// Derived classes copy their component data in the same order
+      /// @param entities the owner of each component
+      /// @param count number of entities
+      void load(const u32* entities, u32 count);
+
+      /// Add many entities to the end of the packed array
+      /// @param ids of the entities
+      /// @param count number of entities
+      void insert(const u32* ids, u32 count);
+
+      /// Copy the packed arrays and sparse index of another store
+      void copyFrom(const CompStoreBase& other);
+
+      /// Current change tick of the ecs
+      const u32* m_Tick;
 
-    /// Virtual destructor
-    virtual ~CompStoreBase() {};
+      /// Description of the component type stored
+      ComponentInfo m_Info;
 
-    /// Notify the component store that an entity was destroyed
-    virtual void EntityDestroyed(u32 id) = 0;
+    private:
+      /// Get the slot in the sparse index for an entity, allocating its page if needed
+      /// @param id of the entity
+      u32& slot(u32 id);
+
+      /// Pages of the sparse index
+      /// Each slot stores the dense index of the entity's component plus one so that 0 means none
+      /// Null for pages nothing has lived in yet
+      std::pmr::vector<u32*> m_Sparse{resource()};
+
+      /// get the Id of an entity based on the index of its component
+      std::pmr::vector<u32> m_Dense{resource()};
+
+      /// Tick each component was added in, parallel to m_Dense
+      std::pmr::vector<u32> m_Added{resource()};
+
+      /// Tick each component was last changed in, parallel to m_Dense
+      std::pmr::vector<u32> m_Changed{resource()};
   };
 
   /// Template class for component storage
@@ -26,20 +190,11 @@ namespace octal {
   template<typename C>
   class CompStore : public CompStoreBase {
     private:
-      /// storage
-      std::array<C, MAX_ENTITIES> m_Store;
-
-      /// get the storage index of a component based on the entity id
-      std::array<u32, MAX_ENTITIES> m_Id2Idx{0};
-
-      /// get the Id of an entity based on the index of its component
-      std::array<u32, MAX_ENTITIES> m_Idx2Id{0};
-      
-      /// the index of the last used component
-      u32 m_LastIdx{1};
+      /// storage, in the same order as the entities in the dense array
+      std::pmr::vector<C> m_Store{resource()};
 
     public:
-      CompStore() { };
+      CompStore(const u32* tick) : CompStoreBase(tick, ComponentInfo::Create<C>(TypeId<C>())) { };
       ~CompStore() override { }
 
 
@@ -48,64 +203,107 @@ namespace octal {
       /// @param args the arguments to the constructor of the entity
       template<typename... Args>
       void Add(u32 id, Args&&... args) {
-        DEBUG("Adding component at %d", m_LastIdx);
-        // store the component in the closest available spot
-        m_Store[m_LastIdx] = C(args...);
-        // store the index of the component data at the index of the id
-        m_Id2Idx[id] = m_LastIdx;
-        m_Idx2Id[m_LastIdx] = id;
-        // increase the last index
-        ++m_LastIdx;
+        if (Has(id)) {
+          WARN("Entity %d already has this component! Skipping...", id);
+          return;
+        }
+        LOG_TO(ECS, Debug, "Adding component at %d", Size());
+        insert(id);
+        // store the component at the end of the packed array
+        m_Store.emplace_back(std::forward<Args>(args)...);
       }
 
       /// Remove a component
       /// @param id the id of the entity to remove from
-      void Remove(u32 id) {
-        // decrease the last idx counter so it "points" to the last item
-        --m_LastIdx;
-
-        // if this is the last added component
-        if (m_Id2Idx[id] == m_LastIdx) {
-          // we can just remove it from the end and erase
-          Platform::MemZero(&m_Store[m_LastIdx], sizeof(C));
-          // reset to -1 for no component
-          m_Id2Idx[id] = 0;
-          m_Idx2Id[m_LastIdx] = 0;
-          return;
-        }
-        // new place is the index of the id we are removing
-        u32 new_idx = m_Id2Idx[id];
-        // update the idx of this index to null
-        m_Id2Idx[id] = 0;
-
-        // first get the id of the last component
-        u32 last_id = m_Idx2Id[m_LastIdx];
-        // update the arrays
-        m_Id2Idx[last_id] = new_idx;
-        m_Idx2Id[new_idx] = last_id;
-        m_Idx2Id[m_LastIdx] = 0;
-
-        // move the component
-        m_Store[new_idx] = m_Store[m_LastIdx];
+      /// @return false if the entity had no component to remove
+      bool Remove(u32 id) {
+        u32 idx = index(id);
+        // nothing to remove
+        if (idx == 0)
+          return false;
+        --idx;
 
-        // clear the memory
-        Platform::MemZero(&m_Store[m_LastIdx], sizeof(C));
+        // move the last component into the hole unless this is the last one
+        if (idx != m_Store.size() - 1) {
+          m_Store[idx] = std::move(m_Store.back());
+        }
+        m_Store.pop_back();
+        // keep the entity array in the same order
+        erase(id);
+        return true;
       }
 
-      /// Get a reference to the component for this entity
+      /// Get a reference to the component for this entity, marking it as changed
       /// @param id of the entity whos component we are getting
       C* Get(u32 id) {
         // get index
-        u32 idx = m_Id2Idx[id];
-        DEBUG("looking up data for address: %d", idx);
+        u32 idx = index(id);
+        LOG_TO(ECS, Debug, "looking up data for address: %d", idx);
         if (idx == 0)
           return nullptr;
+        touch(idx - 1);
         // return reference
-        return &m_Store[idx];
+        return &m_Store[idx - 1];
+      }
+
+      /// Get a read only reference to the component for this entity
+      /// @param id of the entity whos component we are getting
+      const C* Read(u32 id) const {
+        u32 idx = index(id);
+        if (idx == 0)
+          return nullptr;
+        return &m_Store[idx - 1];
+      }
+
+      /// Packed array of the components in this store
+      C* Data() {
+        return m_Store.data();
       }
 
       void EntityDestroyed(u32 id) override {
         Remove(id);
       }
+
+      const void* RawData() const override {
+        return m_Store.data();
+      }
+
+      void Load(const u32* entities, const void* data, u32 count) override {
+        ASSERT(Size() == 0, "Loading into a store that isn't empty");
+        if constexpr (std::is_trivially_copyable_v<C>) {
+          load(entities, count);
+          // a range of trivially copyable values is copied as one block
+          const C* comps = (const C*) data;
+          m_Store.assign(comps, comps + count);
+        } else {
+          ASSERT(false, "Only trivially copyable components can be loaded from raw memory");
+        }
+      }
+
+      void Copy(u32 src, const u32* ids, u32 count) override {
+        if constexpr (std::is_copy_constructible_v<C>) {
+          u32 idx = index(src);
+          ASSERT(idx != 0, "Copying a component the entity doesn't have");
+          // the source could move when the array grows
+          C comp = m_Store[idx - 1];
+          insert(ids, count);
+          m_Store.insert(m_Store.end(), count, comp);
+        } else {
+          ASSERT(false, "Copying a component that isn't copy constructible");
+        }
+      }
+
+      Scope<CompStoreBase> CreateEmpty(const u32* tick) const override {
+        return CreateScope<CompStore<C>>(tick);
+      }
+
+      void CopyFrom(const CompStoreBase& other) override {
+        if constexpr (std::is_copy_assignable_v<C>) {
+          copyFrom(other);
+          m_Store = ((const CompStore<C>&) other).m_Store;
+        } else {
+          ASSERT(false, "Copying a component that isn't copy assignable");
+        }
+      }
   };
 }
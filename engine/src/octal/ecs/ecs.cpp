@@ -1,4 +1,80 @@
 #include "octal/ecs/ecs.h"
+
+namespace octal {
+  /// Make every store in dst a copy of the one in src, assigning into stores dst already has
+  template<typename T>
+  static void copyStores(const std::vector<Scope<T>>& src, std::vector<Scope<T>>& dst) {
+    if (dst.size() < src.size())
+      dst.resize(src.size());
+    for (size_t tid = 0; tid < dst.size(); ++tid) {
+      const T* from = tid < src.size() ? src[tid].get() : nullptr;
+      if (!from)
+        dst[tid].reset();
+      else if (dst[tid])
+        *dst[tid] = *from;
+      else
+        dst[tid] = CreateScope<T>(*from);
+    }
+  }
+
+  void ECS::CopyTo(ECS& dst) const {
+    ASSERT(m_Storage == dst.m_Storage, "Copying between ecs with different storage");
+    ASSERT(m_Reserved.load() == 0, "Copying an ecs with reserved entities");
+    dst.m_Entities = m_Entities;
+    dst.m_FreeHead = m_FreeHead;
+    dst.m_ReservePool.clear();
+    dst.m_Signatures = m_Signatures;
+    dst.m_LivingEntities = m_LivingEntities;
+    dst.m_Tick = m_Tick;
+    dst.m_Removed = m_Removed;
+    copyStores(m_Relations, dst.m_Relations);
+    // keep what the other ecs has registered on its own
+    if (dst.m_Infos.size() < m_Infos.size())
+      dst.m_Infos.resize(m_Infos.size());
+    for (size_t tid = 0; tid < m_Infos.size(); ++tid) {
+      if (m_Infos[tid].size)
+        dst.m_Infos[tid] = m_Infos[tid];
+    }
+    if (m_Storage == Storage::Archetype) {
+      dst.m_Archetypes.CopyFrom(m_Archetypes);
+      return;
+    }
+    copyStores(m_Tags, dst.m_Tags);
+    if (dst.m_CompStorage.size() < m_CompStorage.size())
+      dst.m_CompStorage.resize(m_CompStorage.size());
+    for (size_t tid = 0; tid < dst.m_CompStorage.size(); ++tid) {
+      const CompStoreBase* src = tid < m_CompStorage.size() ? m_CompStorage[tid].get() : nullptr;
+      if (!src) {
+        // the other ecs has a type this one never used
+        if (dst.m_CompStorage[tid])
+          dst.m_CompStorage[tid] = dst.m_CompStorage[tid]->CreateEmpty(&dst.m_Tick);
+        continue;
+      }
+      if (!dst.m_CompStorage[tid])
+        dst.m_CompStorage[tid] = src->CreateEmpty(&dst.m_Tick);
+      dst.m_CompStorage[tid]->CopyFrom(*src);
+    }
+  }
+
+  void ECS::destroyRelations(u32 id) {
+    for (auto& rel : m_Relations) {
+      if (rel)
+        rel->EntityDestroyed(id, m_Orphans);
+    }
+    // orphans destroyed below come back through here and are left for this loop,
+    // so a long cascade doesn't nest a call per link
+    if (m_DestroyingOrphans)
+      return;
+    m_DestroyingOrphans = true;
+    while (!m_Orphans.empty()) {
+      u32 orphan = m_Orphans.back();
+      m_Orphans.pop_back();
+      if (IsAlive(orphan))
+        DestroyEntity(orphan);
+    }
+    m_DestroyingOrphans = false;
+  }
+}
 /*
 namespace octal {
   ECS::ECS()
@@ -65,7 +141,7 @@ namespace octal {
 
   template<typename C>
   CompStore<C>& ECS::getComponentStore() {
-    u8 tid = IdGenerator<Component>::TypeId<C>();
+    u32 tid = TypeId<C>();
 
     // if the length of the comp storage vector is less than our id then that means we gotta add it
     if (tid < m_CompStorage.size()) {
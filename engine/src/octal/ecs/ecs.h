@@ -3,64 +3,108 @@
 #include "octal/core/logger.h"
 #include "octal/core/asserts.h"
 #include "octal/ecs/components.h"
+#include "octal/ecs/typeid.h"
 #include "octal/ecs/compstore.h"
+#include "octal/ecs/archetype.h"
+#include "octal/ecs/entityid.h"
+#include "octal/ecs/signature.h"
+#include "octal/ecs/view.h"
+#include "octal/ecs/relation.h"
+#include "octal/ecs/tagstore.h"
 #include <algorithm>
+#include <atomic>
 #include <typeinfo>
 #include <type_traits>
-#include <deque>
 #include <vector>
 
 
 namespace octal {
-  // T is the base class. We need to do this to set the static s_Types variable.
-  // we also use it to make sure that the types given are derived from T
-  // May be useful if we need to do this with things other than components
-
-  /// Helper to generate Component type ids
-  template<class T>
-  class IdGenerator {
-    private:
-      /// The number of types we have
-      static u8 s_Types;
-
+  /// Entity Component Manager
+  class ECS {
     public:
-      /// Creates a unique numerical representation of a type that is derived from Component
-      /// @return a number representing the type given
-      template<typename C>
-      static const u8 TypeId() {
-        // assert that C is derived from T
-        constexpr bool is_derived = std::is_base_of<T, C>::value;
-        //STATIC_ASSERT(is_derived, "Attempt to check id of type that is not derived from Component");
-        // create a new type if we can
-        static const u8 tid = s_Types++;
-        return tid;
+      /// How components are stored
+      enum class Storage {
+        /// One packed sparse set per component type
+        SparseSet,
+        /// Entities with the same set of components share chunks with one column per type
+        Archetype,
       };
-  };
-  template<class T> u8 IdGenerator<T>::s_Types = 0;
 
-  /// Entity Component Manager
-  class ECS {
     private:
+      /// Which backend is storing our components
+      Storage m_Storage;
 
-      /// Stores ids of unused entities
-      std::deque<u32> m_EntityIds;
+      /// Id of every entity slot, indexed by the index part of the id
+      /// Living entities store their own id. Free slots store the index of the
+      /// next free slot along with the version their next entity will get, which
+      /// makes this an intrusive free list. Slot 0 is reserved for null.
+      std::pmr::vector<u32> m_Entities{1, 0, Memory::Resource(MemoryTag::ECS)};
+
+      /// Index of the first free slot or 0 if there are none
+      u32 m_FreeHead{0};
+
+      /// The component types each entity has, indexed like m_Entities
+      /// Only kept with sparse set storage, archetypes already know this
+      std::vector<Signature> m_Signatures{1};
 
       /// The number of living entities right now
-      u32 m_LivingEntities;
+      u32 m_LivingEntities{0};
+
+      /// Number of ids reserved by ReserveEntity that aren't alive yet
+      std::atomic<u32> m_Reserved{0};
+
+      /// The first free slots along the free list, handed out by ReserveEntity
+      /// before it reserves past the end of m_Entities. Only valid while the free
+      /// list is untouched, so anything that changes it clears this.
+      std::vector<u32> m_ReservePool;
+
+      /// Roughly how many ids get reserved between commits, sizes m_ReservePool
+      u32 m_ReserveHint{0};
 
       /// Vector of component storage
       std::vector<Scope<CompStoreBase>> m_CompStorage;
 
+      /// Bits of each tag component type with sparse set storage, indexed by type id
+      std::vector<Scope<TagStore>> m_Tags;
+
+      /// Current change tick, stamped on every component that is added or changed
+      /// Starts at 1 so that a tick of 0 means before anything happened
+      u32 m_Tick{1};
+
+      /// A component that was removed from an entity
+      struct Removal {
+        /// Entity the component was removed from
+        u32 id;
+        /// Tick the component was removed in
+        u32 tick;
+      };
+
+      /// Log of removed components for each type id, oldest first
+      std::vector<std::vector<Removal>> m_Removed;
+
+      /// Component storage when using archetypes
+      ArchetypeStorage m_Archetypes;
+
+      /// Description of every registered or stored component type, indexed by type id
+      /// Types that haven't been seen yet have a size of 0
+      std::vector<ComponentInfo> m_Infos;
+
+      /// Pairs of each relation kind, indexed by the type id of the relation
+      std::vector<Scope<RelationStore>> m_Relations;
+      /// Sources of cascading relations waiting to be destroyed
+      std::vector<u32> m_Orphans;
+      bool m_DestroyingOrphans{false};
+
+      /// Free slots PrepareReserve sets aside even when little has been reserved
+      static constexpr u32 RESERVE_POOL_MIN = 64;
+
+      /// Snapshots read and write the entity table and storage directly
+      friend class Snapshot;
+
     public:
       /// Constructor
-      /// @param max maximum number of entities in this system
-      ECS(){ 
-        // populate the queue
-        // id of 0 is reserved for null
-        for (int i = 1; i < MAX_ENTITIES; ++i) {
-          m_EntityIds.push_back(i);
-        }
-      };
+      /// @param storage how components should be stored
+      ECS(Storage storage = Storage::SparseSet) : m_Storage(storage), m_Archetypes(&m_Tick) { };
 
 
       /// Destructor
@@ -69,47 +113,223 @@ namespace octal {
       /// Creates a new entity
       /// @return a fresh new unused EntityId
       u32 CreateEntity() {
-        // make sure we can even create a new entity
-        ASSERT(m_LivingEntities < MAX_ENTITIES, "Max entities exceeded");
-        // set our return value to the frontmost entity id
-        u32 ret = m_EntityIds.front();
-        // pop the id off the front
-        m_EntityIds.pop_front();
+        // reserved ids sit past the end of the table so claim them first
+        if (m_Reserved.load(std::memory_order_relaxed) > 0)
+          CommitReserved();
+        m_ReservePool.clear();
+        u32 ret;
+        if (m_FreeHead == 0) {
+          // no ids to recycle so grow
+          u32 idx = (u32) m_Entities.size();
+          ASSERT(idx <= ENTITY_INDEX_MASK, "Entity ids exhausted");
+          ret = MakeEntityId(idx, 0);
+          m_Entities.push_back(ret);
+          if (m_Storage == Storage::SparseSet) {
+            m_Signatures.emplace_back();
+          }
+        } else {
+          // pop the first free slot off the list
+          u32 idx = m_FreeHead;
+          u32 slot = m_Entities[idx];
+          m_FreeHead = EntityIndex(slot);
+          ret = MakeEntityId(idx, EntityVersion(slot));
+          m_Entities[idx] = ret;
+        }
         // increase number of living entities
         ++m_LivingEntities;
         return ret;
       }
 
+      /// Create many entities at once
+      /// Free slots are recycled first, then the entity table grows once for the rest.
+      /// @param count number of entities to create
+      /// @param out filled with the ids of the new entities, must have room for count
+      void CreateEntities(u32 count, u32* out) {
+        if (m_Reserved.load(std::memory_order_relaxed) > 0)
+          CommitReserved();
+        m_ReservePool.clear();
+        u32 i = 0;
+        for (; i < count && m_FreeHead != 0; ++i) {
+          u32 idx = m_FreeHead;
+          u32 slot = m_Entities[idx];
+          m_FreeHead = EntityIndex(slot);
+          out[i] = m_Entities[idx] = MakeEntityId(idx, EntityVersion(slot));
+        }
+        u32 first = (u32) m_Entities.size();
+        u32 grow = count - i;
+        ASSERT(grow == 0 || first + grow - 1 <= ENTITY_INDEX_MASK, "Entity ids exhausted");
+        m_Entities.resize(first + grow);
+        for (u32 k = 0; k < grow; ++k) {
+          out[i + k] = m_Entities[first + k] = MakeEntityId(first + k, 0);
+        }
+        if (m_Storage == Storage::SparseSet) {
+          m_Signatures.resize(m_Entities.size());
+        }
+        m_LivingEntities += count;
+      }
+
+      /// Set aside free slots for ReserveEntity to recycle
+      /// Call before ids are reserved, without it every reserved id grows the
+      /// entity table. Takes enough for about twice what was reserved lately.
+      void PrepareReserve() {
+        if (m_Reserved.load(std::memory_order_relaxed) > 0)
+          CommitReserved();
+        m_ReservePool.clear();
+        u32 want = std::max(RESERVE_POOL_MIN, 2 * m_ReserveHint);
+        for (u32 idx = m_FreeHead; idx != 0 && m_ReservePool.size() < want; idx = EntityIndex(m_Entities[idx])) {
+          m_ReservePool.push_back(idx);
+        }
+      }
+
+      /// Reserve an entity id, safe to call from multiple threads
+      /// Recycles the slots set aside by PrepareReserve first, then reserves
+      /// past the end of the table. The entity isn't alive until CommitReserved
+      /// is called. No other changes to the entities may happen while ids are
+      /// being reserved.
+      /// @return the id the entity will have
+      u32 ReserveEntity() {
+        u32 n = m_Reserved.fetch_add(1, std::memory_order_relaxed);
+        if (n < m_ReservePool.size()) {
+          u32 idx = m_ReservePool[n];
+          return MakeEntityId(idx, EntityVersion(m_Entities[idx]));
+        }
+        u32 idx = (u32) (m_Entities.size() + n - m_ReservePool.size());
+        ASSERT(idx <= ENTITY_INDEX_MASK, "Entity ids exhausted");
+        return MakeEntityId(idx, 0);
+      }
+
+      /// Bring every reserved entity to life
+      void CommitReserved() {
+        u32 count = m_Reserved.exchange(0, std::memory_order_acq_rel);
+        m_ReserveHint = std::max(count, m_ReserveHint - m_ReserveHint / 4);
+        // the pool is the front of the free list so the recycled slots pop off in order
+        u32 recycled = std::min(count, (u32) m_ReservePool.size());
+        for (u32 i = 0; i < recycled; ++i) {
+          u32 idx = m_FreeHead;
+          ASSERT(idx == m_ReservePool[i], "Free list changed while ids were reserved");
+          u32 slot = m_Entities[idx];
+          m_FreeHead = EntityIndex(slot);
+          m_Entities[idx] = MakeEntityId(idx, EntityVersion(slot));
+        }
+        m_ReservePool.clear();
+        for (u32 i = recycled; i < count; ++i) {
+          m_Entities.push_back(MakeEntityId((u32) m_Entities.size(), 0));
+          if (m_Storage == Storage::SparseSet) {
+            m_Signatures.emplace_back();
+          }
+        }
+        m_LivingEntities += count;
+      }
+
+      /// Is this entity alive?
+      /// Ids of destroyed entities stay dead even after their index is reused
+      /// @param id of the entity to check
+      bool IsAlive(u32 id) const {
+        u32 idx = EntityIndex(id);
+        return idx != 0 && idx < m_Entities.size() && m_Entities[idx] == id;
+      }
+
 
       /// Destroys and entity
       /// @param id of entity that we no longer need anymore
       void DestroyEntity(u32 id) {
-        ASSERT(id < MAX_ENTITIES, "Invalid entity id given");
         // check if this entity has already been returned
-        auto itr = std::find(m_EntityIds.begin(), m_EntityIds.end(), id);
-        if (itr != m_EntityIds.end()) {
-          WARN("Entity already %d destroyed! Skipping...", id);
+        if (!IsAlive(id)) {
+          WARN("Entity %d already destroyed! Skipping...", id);
           return;
         }
+        u32 idx = EntityIndex(id);
         // remove all the entity's components
-        for (auto& itr : m_CompStorage) {
-          itr->EntityDestroyed(id);
+        if (m_Storage == Storage::Archetype) {
+          if (Archetype* arch = m_Archetypes.ArchetypeOf(id)) {
+            for (auto& info : arch->Types())
+              logRemoved(info.id, id);
+          }
+          m_Archetypes.EntityDestroyed(id);
+        } else {
+          // only visit the stores this entity actually has a component in
+          Signature& sig = m_Signatures[idx];
+          sig.ForEach([&](u32 tid) {
+            if (isTag(tid))
+              m_Tags[tid]->Remove(id);
+            else
+              m_CompStorage[tid]->EntityDestroyed(id);
+            logRemoved(tid, id);
+          });
+          sig.Clear();
         }
-        // add to back of list
-        m_EntityIds.push_back(id);
+        // push the slot onto the free list and bump the version
+        m_Entities[idx] = MakeEntityId(m_FreeHead, EntityVersion(id) + 1);
+        m_FreeHead = idx;
+        m_ReservePool.clear();
         // reduce number of living entities
         --m_LivingEntities;
+        if (!m_Relations.empty())
+          destroyRelations(id);
       }
 
+      /// The number of living entities right now
+      u32 EntityCount() const { return m_LivingEntities; }
 
-      /// Creates and adds a component to a given entity
+
+      /// Construct a component in place on a given entity
       /// @param id of the entity we want to add the component to
       /// @param args arguments to the constructor of that component
-      //template<class C, typename... Args>
-      template<typename... Args, typename C = std::common_type_t<Args...>>
-      void AddComponent(u32 id, Args&&... args) {
-        auto cs = getComponentStore<C>();
-        cs->template Add<C>(id, std::forward<C>(args...));
+      template<typename C, typename... Args>
+      void Emplace(u32 id, Args&&... args) {
+        ASSERT(IsAlive(id), "Adding a component to a dead entity");
+        if (m_Storage == Storage::Archetype) {
+          m_Archetypes.Add<C>(id, std::forward<Args>(args)...);
+          return;
+        }
+        if constexpr (IsTag<C>) {
+          getTagStore<C>()->Add(id);
+        } else {
+          getComponentStore<C>()->Add(id, std::forward<Args>(args)...);
+        }
+        m_Signatures[EntityIndex(id)].Set(TypeId<C>());
+      }
+
+
+      /// Give many entities a copy of every component of another entity
+      /// Each component type is copied into its storage in one go.
+      /// @param prefab the entity to copy
+      /// @param ids the entities to copy to, must not have any components yet
+      /// @param count number of entities
+      void Instantiate(u32 prefab, const u32* ids, u32 count) {
+        ASSERT(IsAlive(prefab), "Instantiating a dead entity");
+        if (m_Storage == Storage::Archetype) {
+          m_Archetypes.Instantiate(prefab, ids, count);
+          return;
+        }
+        const Signature sig = m_Signatures[EntityIndex(prefab)];
+        sig.ForEach([&](u32 tid) {
+          if (isTag(tid)) {
+            for (u32 i = 0; i < count; ++i)
+              m_Tags[tid]->Add(ids[i]);
+          } else {
+            m_CompStorage[tid]->Copy(prefab, ids, count);
+          }
+        });
+        for (u32 i = 0; i < count; ++i) {
+          m_Signatures[EntityIndex(ids[i])] = sig;
+        }
+      }
+
+
+      /// Make another ecs an exact copy of this one
+      /// Entity ids, components and change ticks are all copied, and storage
+      /// that already exists in the other ecs is reused.
+      /// @param dst the ecs to copy into, must use the same kind of storage
+      void CopyTo(ECS& dst) const;
+
+
+      /// Adds a component to a given entity by moving or copying it
+      /// @param id of the entity we want to add the component to
+      /// @param comp the component to add
+      template<typename C>
+      void AddComponent(u32 id, C&& comp) {
+        Emplace<std::remove_cvref_t<C>>(id, std::forward<C>(comp));
       }
 
 
@@ -117,32 +337,310 @@ namespace octal {
       /// @param id of the entity we want to remove the component from
       template<typename C>
       void RemoveComponent(u32 id) {
-        auto cs = getComponentStore<C>();
-        cs->Remove(id);
+        if (!IsAlive(id))
+          return;
+        if (m_Storage == Storage::Archetype) {
+          if (m_Archetypes.Remove<C>(id))
+            logRemoved(TypeId<C>(), id);
+          return;
+        }
+        bool removed;
+        if constexpr (IsTag<C>) {
+          removed = getTagStore<C>()->Remove(id);
+        } else {
+          removed = getComponentStore<C>()->Remove(id);
+        }
+        if (removed)
+          logRemoved(TypeId<C>(), id);
+        m_Signatures[EntityIndex(id)].Reset(TypeId<C>());
       }
 
 
       /// Returns a pointer to a component owned by this entity
+      /// Asking for a component that isn't const marks it as changed.
+      /// Every entity with a tag gets the same pointer.
       /// @param id of the entity we want the component of
       template<typename C>
       C* GetComponent(u32 id) {
-        auto cs = getComponentStore<C>();
-        return cs->Get(id);
+        // stale ids would otherwise find whatever reused their index
+        if (!IsAlive(id))
+          return nullptr;
+        if (m_Storage == Storage::Archetype) {
+          return m_Archetypes.Get<C>(id);
+        }
+        if constexpr (IsTag<C>) {
+          return getTagStore<std::remove_const_t<C>>()->Has(id) ? TagStore::Instance<C>() : nullptr;
+        } else if constexpr (std::is_const_v<C>) {
+          return getComponentStore<std::remove_const_t<C>>()->Read(id);
+        } else {
+          return getComponentStore<C>()->Get(id);
+        }
+      }
+
+
+      /// Mark a component as changed without getting it
+      /// @param id of the entity that owns the component
+      template<typename C>
+      void MarkChanged(u32 id) {
+        GetComponent<C>(id);
+      }
+
+
+      /// Get a view over every entity that has all of the components Cs
+      /// Tags can't be viewed since they have no data, filter on them with View::With instead.
+      /// @return a view that can be iterated or used with Each
+      template<typename... Cs>
+      octal::View<Cs...> View() {
+        static_assert(!(IsTag<Cs> || ...), "Tags are filtered with View::With and View::Without");
+        if (m_Storage == Storage::Archetype) {
+          return octal::View<Cs...>(m_Tick, &m_Archetypes);
+        }
+        return octal::View<Cs...>(m_Tick, &m_Tags, getComponentStore<std::remove_const_t<Cs>>()...);
+      }
+
+
+      /// Call a function on every entity that has all of the tags Ts
+      /// With sparse set storage the bits of every tag are combined a block of words at a time.
+      /// @param func called as func(u32 id)
+      template<typename... Ts, typename F>
+      void EachTagged(F&& func) {
+        static_assert(sizeof...(Ts) > 0 && (IsTag<Ts> && ...), "EachTagged only takes tags");
+        if (m_Storage == Storage::Archetype) {
+          std::vector<Archetype*> matches;
+          m_Archetypes.Match(ArchetypeStorage::SignatureOf<Ts...>(), matches);
+          for (Archetype* arch : matches) {
+            for (u32 c = 0; c < arch->ChunkCount(); ++c) {
+              Chunk& chunk = arch->GetChunk(c);
+              const u32* ents = arch->Entities(chunk);
+              for (u32 r = 0; r < chunk.count; ++r)
+                func(ents[r]);
+            }
+          }
+          return;
+        }
+        const TagStore* stores[] = {findTagStore<Ts>()...};
+        for (const TagStore* s : stores) {
+          if (!s)
+            return;
+        }
+        TagStore::EachAll(stores, sizeof...(Ts), [&](u32 idx) {
+          func(m_Entities[idx]);
+        });
+      }
+
+
+      /// Count the entities that have all of the tags Ts
+      template<typename... Ts>
+      u32 CountTagged() {
+        static_assert(sizeof...(Ts) > 0 && (IsTag<Ts> && ...), "CountTagged only takes tags");
+        if (m_Storage == Storage::Archetype) {
+          std::vector<Archetype*> matches;
+          m_Archetypes.Match(ArchetypeStorage::SignatureOf<Ts...>(), matches);
+          u32 count = 0;
+          for (Archetype* arch : matches)
+            count += arch->Size();
+          return count;
+        }
+        const TagStore* stores[] = {findTagStore<Ts>()...};
+        for (const TagStore* s : stores) {
+          if (!s)
+            return 0;
+        }
+        return TagStore::CountAll(stores, sizeof...(Ts));
+      }
+
+
+      /// The change tick that components are being stamped with
+      u32 CurrentTick() const { return m_Tick; }
+
+      /// Start a new change tick
+      /// Everything added, changed or removed from now on is newer than the returned tick.
+      /// A consumer keeps the tick from its last call and passes it to the
+      /// Added and Changed view filters or EachRemoved to see only what is new.
+      /// Must not be called while components are being changed on other threads.
+      /// @return the tick that just ended
+      u32 NextTick() { return m_Tick++; }
+
+
+      /// Call a function for every entity that lost a component of type C after a tick
+      /// Destroyed entities count as losing all of their components.
+      /// @param since only removals newer than this tick are visited
+      /// @param func called as func(u32 id) with the id the entity had
+      template<typename C, typename F>
+      void EachRemoved(u32 since, F&& func) const {
+        u32 tid = TypeId<C>();
+        if (tid >= m_Removed.size())
+          return;
+        for (const Removal& r : m_Removed[tid]) {
+          if (r.tick > since)
+            func(r.id);
+        }
+      }
+
+
+      /// Forget removed components older than a tick
+      /// @param before removals from ticks before this one are dropped
+      void TrimRemoved(u32 before) {
+        for (auto& log : m_Removed) {
+          auto keep = std::find_if(log.begin(), log.end(),
+              [before](const Removal& r) { return r.tick >= before; });
+          log.erase(log.begin(), keep);
+        }
+      }
+
+
+      /// Make sure the storage for some component types exists
+      /// Storage is otherwise created on first use, which isn't safe to do from multiple threads
+      template<typename... Cs>
+      void Register() {
+        (describe<std::remove_const_t<Cs>>(), ...);
+        if (m_Storage == Storage::SparseSet) {
+          (registerStore<std::remove_const_t<Cs>>(), ...);
+        }
+      }
+
+
+      /// How this ECS stores its components
+      Storage GetStorage() const { return m_Storage; }
+
+
+      /// Point an entity at another through a relation of kind R, like (ChildOf, parent)
+      /// An entity has at most one target per relation kind, relating it again
+      /// replaces the old target. If R has `static constexpr bool CASCADE = true`
+      /// destroying the target destroys the entity too, otherwise the pair is
+      /// just forgotten.
+      /// @param source the entity the relation belongs to
+      /// @param target the entity it points at
+      template<typename R>
+      void Relate(u32 source, u32 target) {
+        ASSERT(IsAlive(source) && IsAlive(target), "Relating a dead entity");
+        ASSERT(source != target, "Relating an entity to itself");
+        getRelationStore<R>()->Relate(source, target);
+      }
+
+
+      /// Remove the relation of kind R from an entity
+      /// @param source the entity the relation belongs to
+      template<typename R>
+      void Unrelate(u32 source) {
+        if (RelationStore* rel = findRelationStore<R>())
+          rel->Unrelate(source);
+      }
+
+
+      /// Target of an entity's relation of kind R
+      /// @param source the entity the relation belongs to
+      /// @return the target or 0 if it doesn't have one
+      template<typename R>
+      u32 Target(u32 source) const {
+        const RelationStore* rel = findRelationStore<R>();
+        return rel && IsAlive(source) ? rel->Target(source) : 0;
+      }
+
+
+      /// Call a function on every entity whose relation of kind R points at a target
+      /// Relations of kind R must not change while this runs.
+      /// @param target the entity pointed at
+      /// @param func called as func(u32 source)
+      template<typename R, typename F>
+      void EachSource(u32 target, F&& func) const {
+        if (const RelationStore* rel = findRelationStore<R>())
+          rel->EachSource(target, std::forward<F>(func));
       }
 
 
     private:
+      /// Forget the relations of a destroyed entity and destroy the sources of cascading ones
+      void destroyRelations(u32 id);
+
+      /// Find the pairs of a relation kind, null if it has never been used
+      template<typename R>
+      RelationStore* findRelationStore() const {
+        u32 tid = TypeId<R>();
+        return tid < m_Relations.size() ? m_Relations[tid].get() : nullptr;
+      }
+
+      /// Find or create the pairs of a relation kind
+      template<typename R>
+      RelationStore* getRelationStore() {
+        u32 tid = TypeId<R>();
+        if (tid < m_Relations.size() && m_Relations[tid]) [[likely]]
+          return m_Relations[tid].get();
+        if (m_Relations.size() <= tid)
+          m_Relations.resize(tid + 1);
+        bool cascade = false;
+        if constexpr (requires { R::CASCADE; })
+          cascade = R::CASCADE;
+        m_Relations[tid] = CreateScope<RelationStore>(cascade);
+        return m_Relations[tid].get();
+      }
+
+      /// Remember the description of a component type
+      template<typename C>
+      void describe() {
+        u32 tid = TypeId<C>();
+        if (tid >= m_Infos.size())
+          m_Infos.resize(tid + 1);
+        m_Infos[tid] = ComponentInfo::Create<C>(tid);
+      }
+
+      /// Is a type id one of a tag with sparse set storage?
+      bool isTag(u32 tid) const {
+        return tid < m_Tags.size() && m_Tags[tid];
+      }
+
+      /// Find the bits of a tag, null if no entity has had it yet
+      template<typename T>
+      const TagStore* findTagStore() const {
+        u32 tid = TypeId<T>();
+        return tid < m_Tags.size() ? m_Tags[tid].get() : nullptr;
+      }
+
+      /// Find or create the bits of a tag
+      template<typename T>
+      TagStore* getTagStore() {
+        u32 tid = TypeId<T>();
+        if (tid < m_Tags.size() && m_Tags[tid]) [[likely]]
+          return m_Tags[tid].get();
+        if (m_Tags.size() <= tid)
+          m_Tags.resize(tid + 1);
+        INFO("Adding tag type %d", tid);
+        describe<T>();
+        m_Tags[tid] = CreateScope<TagStore>();
+        return m_Tags[tid].get();
+      }
+
+      /// Create the storage of a component type, whichever kind it needs
+      template<typename C>
+      void registerStore() {
+        if constexpr (IsTag<C>)
+          getTagStore<C>();
+        else
+          getComponentStore<C>();
+      }
+
+      /// Remember that an entity lost a component
+      void logRemoved(u32 tid, u32 id) {
+        if (tid >= m_Removed.size())
+          m_Removed.resize(tid + 1);
+        m_Removed[tid].push_back({id, m_Tick});
+      }
+
       /// Helper for creating or finding an component store
       template<typename C>
         CompStore<C>* getComponentStore() {
-          u8 tid = IdGenerator<Component>::TypeId<C>();
+          u32 tid = TypeId<C>();
+
+          // stores are indexed by type id, which may be registered in any order
+          if (tid < m_CompStorage.size() && m_CompStorage[tid]) [[likely]]
+            return (CompStore<C>*) m_CompStorage[tid].get();
 
-          // if the length of the comp storage vector is less than our id then that means we gotta add it
           if (m_CompStorage.size() <= tid) {
-            INFO("Adding component type %d", tid);
-            m_CompStorage.push_back(CreateScope<CompStore<C>>());
+            m_CompStorage.resize(tid + 1);
           }
-
+          INFO("Adding component type %d", tid);
+          describe<C>();
+          m_CompStorage[tid] = CreateScope<CompStore<C>>(&m_Tick);
           return  (CompStore<C>*) m_CompStorage[tid].get();
         }
 
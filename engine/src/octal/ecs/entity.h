@@ -24,11 +24,29 @@ namespace octal {
 
     public:
 
-      /// Add component to this entity
+      /// Id of this entity in its scene's ECS
+      u32 Id() const {
+        return m_id;
+      }
+
+      /// Make this entity a child of another, its Transform is then relative to the parent
+      /// @param parent the entity to follow, must be in the same scene
+      void SetParent(const Entity& parent) {
+        m_Scene->m_ecs.Emplace<Parent>(m_id, parent.m_id);
+      }
+
+      /// Construct a component in place on this entity
       /// @param args the arguments to create that type of component
-      template<typename... Args, typename C = std::common_type_t<Args...>>
-      void AddComponent(Args&&... args) {
-        m_Scene->m_ecs.AddComponent<C>(m_id, std::forward<C>(args...));
+      template<typename C, typename... Args>
+      void Emplace(Args&&... args) {
+        m_Scene->m_ecs.Emplace<C>(m_id, std::forward<Args>(args)...);
+      }
+
+      /// Add component to this entity
+      /// @param comp the component to move or copy in
+      template<typename C>
+      void AddComponent(C&& comp) {
+        m_Scene->m_ecs.AddComponent(m_id, std::forward<C>(comp));
       }
 
       /// Removes component of type C from this entity
@@ -37,6 +55,30 @@ namespace octal {
         m_Scene->m_ecs.RemoveComponent<C>(m_id);
       }
 
+      /// Is this entity still alive in its scene?
+      bool IsAlive() const {
+        return m_Scene->m_ecs.IsAlive(m_id);
+      }
+
+      /// Point this entity at another through a relation of kind R
+      /// @param target the entity to point at, must be in the same scene
+      template<typename R>
+      void Relate(const Entity& target) {
+        m_Scene->m_ecs.Relate<R>(m_id, target.m_id);
+      }
+
+      /// Remove this entity's relation of kind R
+      template<typename R>
+      void Unrelate() {
+        m_Scene->m_ecs.Unrelate<R>(m_id);
+      }
+
+      /// Id of the target of this entity's relation of kind R, or 0 if it has none
+      template<typename R>
+      u32 Target() const {
+        return m_Scene->m_ecs.Target<R>(m_id);
+      }
+
       // TODO: should be a reference counted pointer
       /// Gets a refernce to the component of type C on this entity
       /// @returns a reference to the component
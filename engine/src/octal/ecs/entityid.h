@@ -0,0 +1,34 @@
+#pragma once
+#include "octal/defines.h"
+
+namespace octal {
+
+  // Entity ids are 32 bit handles. The low bits are an index into the entity
+  // tables and the high bits are a version that is bumped every time the
+  // index is recycled, so a handle to a destroyed entity never matches the
+  // entity that reuses its index. An id of 0 is reserved for null.
+
+  /// Number of bits of an entity id used for the index
+  constexpr u32 ENTITY_INDEX_BITS = 22;
+  /// Mask for the index bits of an entity id
+  constexpr u32 ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+  /// Mask for the version of an entity id once shifted down
+  constexpr u32 ENTITY_VERSION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+
+  /// Get the index part of an entity id
+  constexpr u32 EntityIndex(u32 id) {
+    return id & ENTITY_INDEX_MASK;
+  }
+
+  /// Get the version part of an entity id
+  constexpr u32 EntityVersion(u32 id) {
+    return id >> ENTITY_INDEX_BITS;
+  }
+
+  /// Build an entity id
+  /// @param index of the entity
+  /// @param version of the entity, wraps around
+  constexpr u32 MakeEntityId(u32 index, u32 version) {
+    return ((version & ENTITY_VERSION_MASK) << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+  }
+}
@@ -0,0 +1,63 @@
+#include "octal/ecs/relation.h"
+
+namespace octal {
+
+  RelationStore::Link& RelationStore::link(u32 id) {
+    u32 idx = EntityIndex(id);
+    if (idx >= m_Links.size())
+      m_Links.resize(idx + 1);
+    Link& l = m_Links[idx];
+    // destroyed entities leave their link cleared, so only the id is stale
+    if (l.self != id)
+      l = {id};
+    return l;
+  }
+
+  void RelationStore::Relate(u32 source, u32 target) {
+    Unrelate(source);
+    // grow the table for both before holding on to either
+    link(target);
+    Link& s = link(source);
+    Link& t = m_Links[EntityIndex(target)];
+    s.target = target;
+    s.prev = 0;
+    s.next = t.first;
+    if (t.first != 0)
+      m_Links[EntityIndex(t.first)].prev = source;
+    t.first = source;
+    ++m_Count;
+  }
+
+  void RelationStore::Unrelate(u32 source) {
+    u32 idx = EntityIndex(source);
+    if (idx >= m_Links.size() || m_Links[idx].self != source || m_Links[idx].target == 0)
+      return;
+    Link& s = m_Links[idx];
+    if (s.prev != 0)
+      m_Links[EntityIndex(s.prev)].next = s.next;
+    else
+      m_Links[EntityIndex(s.target)].first = s.next;
+    if (s.next != 0)
+      m_Links[EntityIndex(s.next)].prev = s.prev;
+    s.target = s.next = s.prev = 0;
+    --m_Count;
+  }
+
+  void RelationStore::EntityDestroyed(u32 id, std::vector<u32>& orphans) {
+    u32 idx = EntityIndex(id);
+    if (idx >= m_Links.size() || m_Links[idx].self != id)
+      return;
+    Unrelate(id);
+    // detach every source, their own next links are cleared as we go
+    for (u32 s = m_Links[idx].first; s != 0;) {
+      Link& l = m_Links[EntityIndex(s)];
+      u32 next = l.next;
+      if (m_Cascade)
+        orphans.push_back(s);
+      l.target = l.next = l.prev = 0;
+      --m_Count;
+      s = next;
+    }
+    m_Links[idx] = {};
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/core/memory.h"
+#include "octal/ecs/entityid.h"
+#include <memory_resource>
+#include <vector>
+
+namespace octal {
+
+  /// Pairs of entities linked by one kind of relation, like (ChildOf, parent)
+  /// Each entity has at most one target per relation kind, and the entities
+  /// pointing at a target are kept as an intrusive list through the same table,
+  /// so a pair costs nothing beyond the 20 bytes every entity index up to the
+  /// highest one used already has. Relating, unrelating and walking the sources
+  /// of a target never allocate once the table has grown.
+  class RelationStore {
+    public:
+      /// Constructor
+      /// @param cascade should destroying a target destroy its sources too?
+      RelationStore(bool cascade) : m_Cascade(cascade) {};
+      /// Copies count against MemoryTag::ECS like the original
+      RelationStore(const RelationStore& other)
+        : m_Links(other.m_Links, Memory::Resource(MemoryTag::ECS)), m_Count(other.m_Count), m_Cascade(other.m_Cascade) {};
+      RelationStore& operator=(const RelationStore&) = default;
+
+      /// Point an entity at a target, replacing the target it had
+      /// @param source the entity the relation belongs to
+      /// @param target the entity it points at
+      void Relate(u32 source, u32 target);
+
+      /// Remove the target of an entity if it has one
+      /// @param source the entity the relation belongs to
+      void Unrelate(u32 source);
+
+      /// Target of an entity
+      /// @param source the entity the relation belongs to
+      /// @return the target or 0 if the entity doesn't have one
+      u32 Target(u32 source) const {
+        u32 idx = EntityIndex(source);
+        if (idx >= m_Links.size() || m_Links[idx].self != source)
+          return 0;
+        return m_Links[idx].target;
+      }
+
+      /// Call a function on every entity pointing at a target, in no particular order
+      /// Relations of this kind must not change while this runs.
+      /// @param target the entity pointed at
+      /// @param func called as func(u32 source)
+      template<typename F>
+      void EachSource(u32 target, F&& func) const {
+        u32 idx = EntityIndex(target);
+        if (idx >= m_Links.size() || m_Links[idx].self != target)
+          return;
+        for (u32 s = m_Links[idx].first; s != 0; s = m_Links[EntityIndex(s)].next) {
+          func(s);
+        }
+      }
+
+      /// Forget every pair an entity is part of, on either side
+      /// @param id of the destroyed entity
+      /// @param orphans sources that pointed at the entity are added here if this relation cascades
+      void EntityDestroyed(u32 id, std::vector<u32>& orphans);
+
+      /// Should destroying a target destroy its sources too?
+      bool Cascades() const { return m_Cascade; }
+
+      /// Number of pairs
+      u32 Size() const { return m_Count; }
+
+    private:
+      /// Both sides of the relation for one entity index
+      struct Link {
+        /// Id of the entity the link was last used by, so stale ids find nothing
+        u32 self{0};
+        /// Entity pointed at or 0
+        u32 target{0};
+        /// First entity pointing at this one or 0
+        u32 first{0};
+        /// Neighbours in the target's list of sources or 0
+        u32 next{0};
+        u32 prev{0};
+      };
+      static_assert(sizeof(Link) == 20, "Update the size in the class comment");
+
+      /// Link of an entity, growing the table and taking over stale links
+      Link& link(u32 id);
+
+      /// Every link, indexed by the index part of the entity id
+      std::pmr::vector<Link> m_Links{Memory::Resource(MemoryTag::ECS)};
+
+      /// Number of pairs
+      u32 m_Count{0};
+
+      /// Should destroying a target destroy its sources too?
+      bool m_Cascade;
+  };
+}
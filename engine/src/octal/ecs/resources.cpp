@@ -0,0 +1,44 @@
+#include "octal/ecs/resources.h"
+#include "octal/core/logger.h"
+
+namespace octal {
+
+  void Resources::release(Slot& slot) {
+    if (!slot.data)
+      return;
+    slot.info.destroy(slot.data);
+    ::operator delete(slot.data, std::align_val_t(slot.info.align));
+    slot.data = nullptr;
+  }
+
+  void Resources::Clear() {
+    for (Slot& slot : m_Slots) {
+      release(slot);
+    }
+  }
+
+  void Resources::CopyTo(Resources& dst) const {
+    if (dst.m_Slots.size() < m_Slots.size())
+      dst.m_Slots.resize(m_Slots.size());
+    for (size_t tid = 0; tid < dst.m_Slots.size(); ++tid) {
+      Slot& slot = dst.m_Slots[tid];
+      const Slot* src = tid < m_Slots.size() && m_Slots[tid].data ? &m_Slots[tid] : nullptr;
+      if (src && !src->info.copy) {
+        WARN("Resource type %d can't be copied and is skipped", (u32) tid);
+        src = nullptr;
+      }
+      if (!src) {
+        release(slot);
+        continue;
+      }
+      // a resource of the same type keeps its memory
+      if (slot.data) {
+        slot.info.destroy(slot.data);
+      } else {
+        slot.info = src->info;
+        slot.data = ::operator new(src->info.size, std::align_val_t(src->info.align));
+      }
+      src->info.copy(slot.data, src->data);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/ecs/components.h"
+#include "octal/ecs/typeid.h"
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace octal {
+
+  /// One instance of each of any number of types, like the input state or the frame time
+  /// Global state doesn't belong to any entity, so rather than giving it a
+  /// component store of its own it lives here. Each resource is allocated once
+  /// and stays at the same address until it is removed, so hot code can keep
+  /// the pointer and reach it with a single load.
+  class Resources {
+    public:
+      /// Constructor
+      Resources() {};
+
+      /// Destroys every resource
+      ~Resources() { Clear(); }
+
+      Resources(const Resources&) = delete;
+      Resources& operator=(const Resources&) = delete;
+
+      /// Construct a resource in place, replacing the one of the same type
+      /// A replaced resource keeps its address.
+      /// @param args arguments to the constructor of T
+      /// @return the new resource
+      template<typename T, typename... Args>
+      T& Set(Args&&... args) {
+        u32 tid = TypeId<T>();
+        if (tid >= m_Slots.size())
+          m_Slots.resize(tid + 1);
+        Slot& slot = m_Slots[tid];
+        if (slot.data) {
+          slot.info.destroy(slot.data);
+        } else {
+          slot.info = ComponentInfo::Create<T>(tid);
+          slot.data = ::operator new(slot.info.size, std::align_val_t(slot.info.align));
+        }
+        return *new (slot.data) T(std::forward<Args>(args)...);
+      }
+
+      /// Get a resource
+      /// @return the resource or null if there isn't one of type T
+      template<typename T>
+      T* Get() {
+        u32 tid = TypeId<T>();
+        return tid < m_Slots.size() ? (T*) m_Slots[tid].data : nullptr;
+      }
+
+      /// Get a resource that is only read
+      template<typename T>
+      const T* Get() const {
+        u32 tid = TypeId<T>();
+        return tid < m_Slots.size() ? (const T*) m_Slots[tid].data : nullptr;
+      }
+
+      /// Destroy a resource if there is one of type T
+      template<typename T>
+      void Remove() {
+        u32 tid = TypeId<T>();
+        if (tid < m_Slots.size())
+          release(m_Slots[tid]);
+      }
+
+      /// Destroy every resource
+      void Clear();
+
+      /// Replace the resources of another set with copies of these
+      /// Resources that can't be copied are skipped with a warning. Resources
+      /// the other set already has are copied into in place and keep their address.
+      /// @param dst the set to copy into
+      void CopyTo(Resources& dst) const;
+
+    private:
+      /// Memory of one resource type
+      struct Slot {
+        /// The resource or null
+        void* data{nullptr};
+        /// How to destroy and copy it
+        ComponentInfo info{};
+      };
+
+      /// Destroy the resource in a slot and free its memory
+      static void release(Slot& slot);
+
+      /// Slot of each type, indexed by type id
+      std::vector<Slot> m_Slots;
+  };
+}
@@ -1,5 +1,7 @@
 #include "octal/ecs/scene.h"
 #include "octal/ecs/entity.h"
+#include "octal/ecs/snapshot.h"
+#include "octal/core/memory.h"
 
 namespace octal {
 
@@ -10,4 +12,96 @@ namespace octal {
   void Scene::DestroyEntity(Entity e) {
     m_ecs.DestroyEntity(e.m_id);
   }
+
+  std::vector<Entity> Scene::Instantiate(Entity prefab, u32 count) {
+    ASSERT(prefab.m_Scene == this, "Instantiating an entity from another scene");
+    std::vector<u32> ids(count);
+    m_ecs.CreateEntities(count, ids.data());
+    m_ecs.Instantiate(prefab.m_id, ids.data(), count);
+    std::vector<Entity> ret;
+    ret.reserve(count);
+    for (u32 id : ids) {
+      ret.push_back(Entity(id, this));
+    }
+    return ret;
+  }
+
+  Scope<Scene> Scene::Clone() const {
+    auto scene = CreateScope<Scene>(m_ecs.GetStorage());
+    CopyTo(*scene);
+    return scene;
+  }
+
+  void Scene::CopyTo(Scene& dst) const {
+    m_ecs.CopyTo(dst.m_ecs);
+    m_Resources.CopyTo(dst.m_Resources);
+    dst.m_Transforms = m_Transforms;
+    dst.m_LastUpdateTick = m_LastUpdateTick;
+    if (dst.m_Spatial)
+      dst.m_Spatial->Reset();
+  }
+
+  void Scene::Update(f64 dt) {
+    u32 start = m_ecs.NextTick() + 1;
+    // buffers can't be added once systems are running
+    prepareCommands();
+    // entities created by systems recycle free slots
+    m_ecs.PrepareReserve();
+    m_Scheduler.Run(dt);
+    Flush();
+    m_Transforms.Update(m_ecs);
+    if (m_Spatial)
+      m_Spatial->Update(m_ecs);
+    m_ecs.TrimRemoved(m_LastUpdateTick);
+    m_LastUpdateTick = start;
+  }
+
+  void Scene::prepareCommands() {
+    u32 count = JobSystem::WorkerCount();
+    while (m_Commands.size() < count) {
+      m_Commands.push_back(CreateScope<CommandBuffer>());
+    }
+  }
+
+  CommandBuffer& Scene::Commands() {
+    i32 worker = JobSystem::WorkerIndex();
+    if (worker >= 0) {
+      // only happens outside of Update
+      if ((u32) worker >= m_Commands.size())
+        prepareCommands();
+      return *m_Commands[worker];
+    }
+    std::lock_guard<std::mutex> guard(m_ExternalLock);
+    std::thread::id self = std::this_thread::get_id();
+    for (auto& [thread, cmds] : m_External) {
+      if (thread == self)
+        return *cmds;
+    }
+    m_External.push_back({self, CreateScope<CommandBuffer>()});
+    return *m_External.back().second;
+  }
+
+  void Scene::Flush() {
+    std::pmr::vector<CommandBuffer*> buffers(Memory::FrameResource());
+    {
+      std::lock_guard<std::mutex> guard(m_ExternalLock);
+      for (auto& [thread, cmds] : m_External) {
+        buffers.push_back(cmds.get());
+      }
+    }
+    for (auto& cmds : m_Commands) {
+      buffers.push_back(cmds.get());
+    }
+    CommandBuffer::Playback(m_ecs, buffers.data(), (u32) buffers.size());
+    // slots freed by this playback can be handed out by CreateEntityDeferred
+    m_ecs.PrepareReserve();
+  }
+
+  bool Scene::Save(const std::string& path) const {
+    return Snapshot::Save(m_ecs, path.c_str());
+  }
+
+  bool Scene::Load(const std::string& path) {
+    return Snapshot::Load(m_ecs, path.c_str());
+  }
 }
@@ -1,5 +1,14 @@
 #pragma once
 #include "octal/ecs/ecs.h"
+#include "octal/ecs/scheduler.h"
+#include "octal/ecs/cmdbuffer.h"
+#include "octal/ecs/transform.h"
+#include "octal/ecs/spatial.h"
+#include "octal/ecs/resources.h"
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 namespace octal {
   class Entity;
   /// Stores the ECS for the current scene
@@ -9,9 +18,38 @@ namespace octal {
       friend Entity;
       /// This scene's private ecs
       ECS m_ecs;
+
+      /// Runs the systems added to this scene
+      Scheduler m_Scheduler;
+
+      /// World matrices of this scene's transforms
+      TransformHierarchy m_Transforms;
+
+      /// Global state of this scene that doesn't belong to an entity
+      Resources m_Resources;
+
+      /// Keeps the spatial index in sync, null if the scene doesn't have one
+      Scope<SpatialTracker> m_Spatial;
+
+      /// Command buffer for each job system worker, by worker index
+      std::vector<Scope<CommandBuffer>> m_Commands;
+
+      /// Command buffers of threads outside the pool, one per thread
+      std::vector<std::pair<std::thread::id, Scope<CommandBuffer>>> m_External;
+
+      /// Guards m_External, each thread only touches its own buffer after finding it
+      std::mutex m_ExternalLock;
+
+      /// Make sure every worker has a command buffer
+      void prepareCommands();
+
+      /// Change tick the previous update started in
+      u32 m_LastUpdateTick{0};
       
     public:
-      Scene() {};
+      /// Constructor
+      /// @param storage how this scene's components should be stored
+      Scene(ECS::Storage storage = ECS::Storage::SparseSet) : m_ecs(storage) {};
       ~Scene(){};
 
       /// Creates a new entity in this scene
@@ -20,5 +58,154 @@ namespace octal {
       
       /// Destroys an entity
       void DestroyEntity(Entity e);
+
+      /// Create many copies of an entity at once
+      /// Only the entity itself is copied, not its children. Ids are allocated
+      /// together and each component type is copied into its storage in one pass.
+      /// @param prefab the entity to copy, must belong to this scene
+      /// @param count number of copies
+      /// @return the new entities
+      std::vector<Entity> Instantiate(Entity prefab, u32 count);
+
+      /// Copy every entity, component and resource of this scene into a new scene
+      /// Systems and the spatial index aren't copied since they are bound to the scene they were added to.
+      Scope<Scene> Clone() const;
+
+      /// Make another scene's entities, components and resources an exact copy of this one's
+      /// The other scene's spatial index is rebuilt on its next update.
+      /// Archetypes, stores and resources the other scene already has are reused
+      /// rather than recreated, so copying only allocates where this scene has
+      /// more than the other did, besides components that allocate when copied.
+      /// @param dst the scene to copy into, must use the same kind of storage
+      void CopyTo(Scene& dst) const;
+
+      /// Construct the resource of type T in place, replacing the one there was
+      /// Resources are single instances of global state, like the input or the frame time.
+      /// @param args arguments to the constructor of T
+      /// @return the resource, which keeps its address until it is removed
+      template<typename T, typename... Args>
+      T& SetResource(Args&&... args) {
+        return m_Resources.Set<T>(std::forward<Args>(args)...);
+      }
+
+      /// Get the resource of type T
+      /// The pointer can be kept around by systems until the resource is removed.
+      /// @return the resource or null if it hasn't been set
+      template<typename T>
+      T* Resource() {
+        return m_Resources.Get<T>();
+      }
+
+      /// Destroy the resource of type T if it has been set
+      template<typename T>
+      void RemoveResource() {
+        m_Resources.Remove<T>();
+      }
+
+      /// Get a view over every entity in this scene that has all of the components Cs
+      template<typename... Cs>
+      octal::View<Cs...> View() {
+        return m_ecs.View<Cs...>();
+      }
+
+      /// Add a system that is given the whole scene
+      /// The system must only touch the components it declares.
+      /// @param name of the system for debugging
+      /// @param func called as func(Scene&, f64 dt) every update
+      template<typename... Rs, typename... Ws, typename F>
+      void AddSystem(const std::string& name, Reads<Rs...>, Writes<Ws...>, F&& func) {
+        m_ecs.Register<Rs..., Ws...>();
+        SystemAccess access;
+        (access.reads.Set(TypeId<Rs>()), ...);
+        (access.writes.Set(TypeId<Ws>()), ...);
+        m_Scheduler.Add(name, access, [this, func = std::forward<F>(func)](f64 dt) {
+          func(*this, dt);
+        });
+      }
+
+      /// Add a system that runs on every entity with the components Cs
+      /// const components are only read and the rest are written.
+      /// Entities are split into batches across the job system.
+      /// @param name of the system for debugging
+      /// @param func called as func(f64 dt, Cs&...) for each entity
+      template<typename... Cs, typename F>
+      void AddSystem(const std::string& name, F&& func) {
+        m_ecs.Register<Cs...>();
+        m_Scheduler.Add(name, SystemAccess::Of<Cs...>(), [this, func = std::forward<F>(func)](f64 dt) {
+          m_ecs.View<Cs...>().ParallelEach([&](Cs&... comps) {
+            func(dt, comps...);
+          });
+        });
+      }
+
+      /// Run every system in this scene, apply their recorded commands, then update world transforms
+      /// and the spatial index
+      /// Each update starts a new change tick. Removed components are remembered
+      /// for the update they happened in and the one after.
+      /// @param dt the time that has passed since the last update
+      void Update(f64 dt);
+
+      /// Command buffer for the calling thread
+      /// Systems record structural changes here instead of making them directly.
+      /// Threads outside the job system get a buffer of their own too, but
+      /// must not record while the scene is flushing.
+      CommandBuffer& Commands();
+
+      /// Apply every recorded command
+      void Flush();
+
+      /// Make sure the storage for some component types exists
+      /// Types have to be registered before a snapshot holding them is loaded.
+      template<typename... Cs>
+      void Register() {
+        m_ecs.Register<Cs...>();
+      }
+
+      /// Save every entity of this scene to a snapshot file
+      /// @param path of the file
+      /// @return false if the file couldn't be written, see Snapshot::Save
+      bool Save(const std::string& path) const;
+
+      /// Load a snapshot file into this scene, which must not have any entities yet
+      /// @param path of the file
+      /// @return false if the file couldn't be loaded, see Snapshot::Load
+      bool Load(const std::string& path);
+
+      /// The transform hierarchy of this scene, as of the last update
+      const TransformHierarchy& Transforms() const {
+        return m_Transforms;
+      }
+
+      /// Keep a spatial index of this scene's entities, updated after the transforms every Update
+      /// @param index to fill, like a LooseGrid or DynamicBVH
+      void SetSpatialIndex(Scope<SpatialIndex> index) {
+        m_Spatial = CreateScope<SpatialTracker>(std::move(index));
+      }
+
+      /// The spatial index as of the last update, or null if there isn't one
+      const SpatialIndex* Spatial() const {
+        return m_Spatial ? &m_Spatial->Index() : nullptr;
+      }
+
+      /// Start a new change tick
+      /// @return the tick that just ended, see ECS::NextTick
+      u32 NextTick() {
+        return m_ecs.NextTick();
+      }
+
+      /// Call a function for every entity that lost a component of type C after a tick
+      /// @param since only removals newer than this tick are visited
+      /// @param func called as func(u32 id)
+      template<typename C, typename F>
+      void EachRemoved(u32 since, F&& func) const {
+        m_ecs.EachRemoved<C>(since, std::forward<F>(func));
+      }
+
+      /// Create an entity from inside a system
+      /// The id is usable with Commands() right away but the entity isn't alive until the next Flush
+      /// @return the id of the new entity
+      u32 CreateEntityDeferred() {
+        return Commands().CreateEntity(m_ecs);
+      }
   };
 }
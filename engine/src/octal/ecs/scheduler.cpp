@@ -0,0 +1,58 @@
+#include "octal/ecs/scheduler.h"
+#include "octal/core/logger.h"
+
+namespace octal {
+
+  void Scheduler::Add(const std::string& name, const SystemAccess& access, Func func) {
+    INFO("Adding system %s", name.c_str());
+    m_Systems.push_back({name, access, std::move(func), {}, 0});
+    m_Dirty = true;
+  }
+
+  void Scheduler::build() {
+    for (auto& sys : m_Systems) {
+      sys.dependents.clear();
+      sys.dependencies = 0;
+    }
+    // a system waits on every earlier system it conflicts with
+    for (u32 i = 0; i < m_Systems.size(); ++i) {
+      for (u32 j = 0; j < i; ++j) {
+        if (m_Systems[i].access.Conflicts(m_Systems[j].access)) {
+          m_Systems[j].dependents.push_back(i);
+          ++m_Systems[i].dependencies;
+        }
+      }
+    }
+    m_Remaining = Scope<std::atomic<u32>[]>(new std::atomic<u32>[m_Systems.size()]);
+    m_Dirty = false;
+  }
+
+  void Scheduler::Run(f64 dt) {
+    if (m_Systems.empty())
+      return;
+    if (m_Dirty)
+      build();
+
+    for (u32 i = 0; i < m_Systems.size(); ++i) {
+      m_Remaining[i].store(m_Systems[i].dependencies, std::memory_order_relaxed);
+    }
+    // start with everything that doesn't wait on anything
+    for (u32 i = 0; i < m_Systems.size(); ++i) {
+      if (m_Systems[i].dependencies == 0)
+        submit(i, dt);
+    }
+    JobSystem::Wait(m_Running);
+  }
+
+  void Scheduler::submit(u32 idx, f64 dt) {
+    JobSystem::Schedule([this, idx, dt]() {
+      System& sys = m_Systems[idx];
+      sys.func(dt);
+      // let the systems waiting on us go once we are their last dependency
+      for (u32 next : sys.dependents) {
+        if (m_Remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+          submit(next, dt);
+      }
+    }, &m_Running);
+  }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/core/jobs.h"
+#include "octal/ecs/signature.h"
+#include "octal/ecs/typeid.h"
+#include "octal/ecs/components.h"
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace octal {
+
+  /// List of component types a system only reads
+  template<typename... Cs>
+  struct Reads {};
+
+  /// List of component types a system writes
+  template<typename... Cs>
+  struct Writes {};
+
+  /// The component types a system reads and writes
+  struct SystemAccess {
+    /// Types that are only read
+    Signature reads;
+    /// Types that are written
+    Signature writes;
+
+    /// Access for a list of component types where const types are only read
+    template<typename... Cs>
+    static SystemAccess Of() {
+      SystemAccess access;
+      ((std::is_const_v<Cs>
+        ? access.reads.Set(TypeId<Cs>())
+        : access.writes.Set(TypeId<Cs>())), ...);
+      return access;
+    }
+
+    /// Can two systems with these accesses not run at the same time?
+    /// They conflict if either writes something the other reads or writes
+    bool Conflicts(const SystemAccess& other) const {
+      return writes.Intersects(other.writes)
+        || writes.Intersects(other.reads)
+        || reads.Intersects(other.writes);
+    }
+  };
+
+  /// Runs the systems of a scene
+  /// Systems that conflict run in the order they were added, everything else
+  /// runs concurrently on the job system.
+  class Scheduler {
+    public:
+      /// What a system does each update
+      using Func = std::function<void(f64)>;
+
+      /// Constructor
+      Scheduler() {};
+
+      /// Add a system
+      /// @param name of the system for debugging
+      /// @param access the components the system touches
+      /// @param func called every update with the time since the last one
+      void Add(const std::string& name, const SystemAccess& access, Func func);
+
+      /// Run every system once, returns when they have all finished
+      /// @param dt the time that has passed since the last update
+      void Run(f64 dt);
+
+    private:
+      /// A registered system and its place in the dependency graph
+      struct System {
+        /// Name for debugging
+        std::string name;
+        /// Components the system reads and writes
+        SystemAccess access;
+        /// The work itself
+        Func func;
+        /// Systems that have to wait for this one
+        std::vector<u32> dependents;
+        /// Number of systems this one waits on
+        u32 dependencies{0};
+      };
+
+      /// Rebuild the dependency graph
+      void build();
+
+      /// Queue a system to run on the job system
+      /// @param idx index of the system
+      /// @param dt the time that has passed since the last update
+      void submit(u32 idx, f64 dt);
+
+      /// Every system in the order they were added
+      std::vector<System> m_Systems;
+
+      /// Systems left to wait on for the current run
+      Scope<std::atomic<u32>[]> m_Remaining;
+
+      /// Number of systems that haven't finished in the current run
+      JobCounter m_Running{0};
+
+      /// Does the graph need to be rebuilt?
+      bool m_Dirty{false};
+  };
+}
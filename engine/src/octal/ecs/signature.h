@@ -0,0 +1,137 @@
+#pragma once
+#include "octal/defines.h"
+#include <vector>
+
+namespace octal {
+
+  /// A set of component type ids stored as a bitset that grows as needed
+  /// The first 64 ids are kept inline so most sets never allocate.
+  class Signature {
+    private:
+      /// Bits of ids 0 to 63
+      u64 m_First{0};
+
+      /// Bits of every id past 63, trailing zero words are always trimmed so equal sets compare equal
+      std::vector<u64> m_Rest;
+
+      /// Word of the set holding a bit, or null if it is past the end
+      const u64* word(u32 bit) const {
+        if (bit < 64)
+          return &m_First;
+        u32 w = bit / 64 - 1;
+        return w < m_Rest.size() ? &m_Rest[w] : nullptr;
+      }
+
+      /// Number of words in use
+      size_t words() const {
+        return 1 + m_Rest.size();
+      }
+
+      /// Word by index, 0 past the end
+      u64 at(size_t i) const {
+        if (i == 0)
+          return m_First;
+        return i - 1 < m_Rest.size() ? m_Rest[i - 1] : 0;
+      }
+
+    public:
+      /// Add a type to the set
+      /// @param bit the type id to add
+      void Set(u32 bit) {
+        if (bit < 64) {
+          m_First |= 1ull << bit;
+          return;
+        }
+        u32 w = bit / 64 - 1;
+        if (w >= m_Rest.size())
+          m_Rest.resize(w + 1, 0);
+        m_Rest[w] |= 1ull << (bit % 64);
+      }
+
+      /// Remove a type from the set
+      /// @param bit the type id to remove
+      void Reset(u32 bit) {
+        if (bit < 64) {
+          m_First &= ~(1ull << bit);
+          return;
+        }
+        u32 w = bit / 64 - 1;
+        if (w >= m_Rest.size())
+          return;
+        m_Rest[w] &= ~(1ull << (bit % 64));
+        // trim so that comparisons stay cheap
+        while (!m_Rest.empty() && m_Rest.back() == 0)
+          m_Rest.pop_back();
+      }
+
+      /// Is this type in the set?
+      /// @param bit the type id to check
+      bool Test(u32 bit) const {
+        const u64* w = word(bit);
+        return w && (*w >> (bit % 64)) & 1;
+      }
+
+      /// Does this set contain every type in another set?
+      /// @param other the set that should be a subset of this one
+      bool Contains(const Signature& other) const {
+        if (other.m_Rest.size() > m_Rest.size())
+          return false;
+        for (size_t i = 0; i < other.words(); ++i) {
+          if ((at(i) & other.at(i)) != other.at(i))
+            return false;
+        }
+        return true;
+      }
+
+      /// Do the two sets have any type in common?
+      /// @param other the set to compare against
+      bool Intersects(const Signature& other) const {
+        size_t n = words() < other.words() ? words() : other.words();
+        for (size_t i = 0; i < n; ++i) {
+          if (at(i) & other.at(i))
+            return true;
+        }
+        return false;
+      }
+
+      /// Is the set empty?
+      bool Empty() const {
+        return m_First == 0 && m_Rest.empty();
+      }
+
+      /// Remove every type from the set
+      void Clear() {
+        m_First = 0;
+        m_Rest.clear();
+      }
+
+      /// Call a function with each type id in the set, in increasing order
+      /// @param func called as func(u32 bit)
+      template<typename F>
+      void ForEach(F&& func) const {
+        for (size_t i = 0; i < words(); ++i) {
+          u64 word = at(i);
+          while (word) {
+            func((u32) (i * 64 + __builtin_ctzll(word)));
+            // clear the lowest set bit
+            word &= word - 1;
+          }
+        }
+      }
+
+      bool operator==(const Signature& other) const {
+        return m_First == other.m_First && m_Rest == other.m_Rest;
+      }
+
+      /// Hash the set so it can be used as a key
+      struct Hash {
+        size_t operator()(const Signature& sig) const {
+          u64 h = (14695981039346656037ull ^ sig.m_First) * 1099511628211ull;
+          for (u64 w : sig.m_Rest) {
+            h = (h ^ w) * 1099511628211ull;
+          }
+          return (size_t) h;
+        }
+      };
+  };
+}
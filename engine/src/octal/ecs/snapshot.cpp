@@ -0,0 +1,434 @@
+#include "octal/ecs/snapshot.h"
+#include "platform/platform.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace octal {
+
+  /// Round an offset up to the alignment of arrays in a snapshot
+  static u64 alignUp(u64 offset) {
+    return (offset + Snapshot::ALIGN - 1) & ~(u64) (Snapshot::ALIGN - 1);
+  }
+
+  /// Writes a file front to back, padding with zeros to reach each offset
+  struct Writer {
+    FILE* file;
+    u64 pos{0};
+    bool ok{true};
+
+    /// Pad up to an offset
+    void Seek(u64 offset) {
+      static const u8 zeros[Snapshot::ALIGN] = {};
+      while (pos < offset) {
+        u64 n = std::min<u64>(offset - pos, sizeof(zeros));
+        Put(zeros, n);
+      }
+    }
+
+    /// Append bytes
+    void Put(const void* data, u64 size) {
+      if (size && fwrite(data, 1, size, file) != size)
+        ok = false;
+      pos += size;
+    }
+  };
+
+  /// The arrays of one component type that will be saved
+  struct Source {
+    ComponentInfo info;
+    u32 count;
+  };
+
+  bool Snapshot::Save(const ECS& ecs, const char* path) {
+    if (ecs.m_Reserved.load(std::memory_order_relaxed) > 0) {
+      WARN("Reserved entities that haven't been committed are not saved");
+    }
+    for (const auto& rel : ecs.m_Relations) {
+      if (rel && rel->Size() > 0) {
+        WARN("Relations are not saved in snapshots");
+        break;
+      }
+    }
+    bool archetypes = ecs.m_Storage == ECS::Storage::Archetype;
+
+    // find every type with components to save
+    std::vector<Source> sources;
+    Signature skipped;
+    auto add = [&](const ComponentInfo& info, u32 count) {
+      if (!info.trivial) {
+        if (!skipped.Test(info.id))
+          WARN("Component type %d isn't trivially copyable and won't be saved", info.id);
+        skipped.Set(info.id);
+        return;
+      }
+      for (Source& s : sources) {
+        if (s.info.id == info.id) {
+          s.count += count;
+          return;
+        }
+      }
+      sources.push_back({info, count});
+    };
+    if (archetypes) {
+      for (Archetype* arch : ecs.m_Archetypes.m_ArchetypeList) {
+        if (arch->Size() == 0)
+          continue;
+        for (const ComponentInfo& info : arch->Types())
+          add(info, arch->Size());
+      }
+    } else {
+      for (auto& store : ecs.m_CompStorage) {
+        if (store && store->Size() > 0)
+          add(store->Info(), store->Size());
+      }
+      for (size_t tid = 0; tid < ecs.m_Tags.size(); ++tid) {
+        if (ecs.m_Tags[tid] && ecs.m_Tags[tid]->Size() > 0)
+          add(ecs.m_Infos[tid], ecs.m_Tags[tid]->Size());
+      }
+    }
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) {
+      return a.info.id < b.info.id;
+    });
+
+    // lay out the file before writing anything
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.slots = (u32) ecs.m_Entities.size();
+    header.free_head = ecs.m_FreeHead;
+    header.living = ecs.m_LivingEntities;
+    header.type_count = (u32) sources.size();
+    header.entities = alignUp(sizeof(Header));
+    header.types = alignUp(header.entities + (u64) header.slots * sizeof(u32));
+    std::vector<TypeEntry> entries(sources.size());
+    u64 end = header.types + sources.size() * sizeof(TypeEntry);
+    for (size_t i = 0; i < sources.size(); ++i) {
+      TypeEntry& e = entries[i];
+      e.hash = sources[i].info.hash;
+      e.size = sources[i].info.size;
+      e.count = sources[i].count;
+      e.entities = alignUp(end);
+      e.data = alignUp(e.entities + (u64) e.count * sizeof(u32));
+      end = e.data + (u64) e.count * e.size;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+      ERROR("Could not open %s to write a snapshot", path);
+      return false;
+    }
+    // arrays are written in big pieces so a large buffer saves system calls
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    Writer w{file};
+    w.Put(&header, sizeof(header));
+    w.Seek(header.entities);
+    w.Put(ecs.m_Entities.data(), (u64) header.slots * sizeof(u32));
+    w.Seek(header.types);
+    w.Put(entries.data(), entries.size() * sizeof(TypeEntry));
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+      const TypeEntry& e = entries[i];
+      u32 tid = sources[i].info.id;
+      if (archetypes) {
+        // every chunk holding the type, entities then components in the same order
+        auto each = [&](auto&& func) {
+          for (Archetype* arch : ecs.m_Archetypes.m_ArchetypeList) {
+            i32 col = arch->Column(tid);
+            if (col < 0)
+              continue;
+            for (u32 c = 0; c < arch->ChunkCount(); ++c)
+              func(arch, arch->GetChunk(c), (u32) col);
+          }
+        };
+        w.Seek(e.entities);
+        each([&](Archetype* arch, Chunk& chunk, u32) {
+          w.Put(arch->Entities(chunk), (u64) chunk.count * sizeof(u32));
+        });
+        w.Seek(e.data);
+        each([&](Archetype* arch, Chunk& chunk, u32 col) {
+          w.Put(arch->Data(chunk, col), (u64) chunk.count * e.size);
+        });
+      } else if (ecs.isTag(tid)) {
+        // tags are saved like any other empty type so either storage can load them
+        std::vector<u32> ids;
+        ids.reserve(e.count);
+        ecs.m_Tags[tid]->Each([&](u32 idx) { ids.push_back(ecs.m_Entities[idx]); });
+        w.Seek(e.entities);
+        w.Put(ids.data(), (u64) e.count * sizeof(u32));
+        w.Seek(e.data + (u64) e.count * e.size);
+      } else {
+        const CompStoreBase* store = ecs.m_CompStorage[tid].get();
+        w.Seek(e.entities);
+        w.Put(store->Entities(), (u64) e.count * sizeof(u32));
+        w.Seek(e.data);
+        w.Put(store->RawData(), (u64) e.count * e.size);
+      }
+    }
+
+    if (fclose(file) != 0)
+      w.ok = false;
+    if (!w.ok) {
+      ERROR("Failed writing snapshot %s", path);
+      return false;
+    }
+    INFO("Saved %d entities and %d component types to %s", header.living, header.type_count, path);
+    return true;
+  }
+
+  /// Check that everything a header points to is inside the file and the entity table holds together
+  /// @param living set to the number of living entities in the table
+  static bool validate(const Snapshot::Header& header, const u8* file, u64 size, const char* path, u32& living) {
+    if (header.magic != Snapshot::MAGIC) {
+      ERROR("%s is not a snapshot", path);
+      return false;
+    }
+    if (header.version != Snapshot::VERSION) {
+      ERROR("Snapshot %s is version %d, expected %d", path, header.version, Snapshot::VERSION);
+      return false;
+    }
+    if (header.slots == 0 || header.entities + (u64) header.slots * sizeof(u32) > size
+        || header.types + (u64) header.type_count * sizeof(Snapshot::TypeEntry) > size) {
+      ERROR("Snapshot %s is truncated", path);
+      return false;
+    }
+    if ((u64) header.slots > (u64) ENTITY_INDEX_MASK + 1) {
+      ERROR("Snapshot %s has more entity slots than ids can address", path);
+      return false;
+    }
+    if (header.entities % Snapshot::ALIGN || header.types % Snapshot::ALIGN) {
+      ERROR("Snapshot %s has misaligned arrays", path);
+      return false;
+    }
+    // a slot is alive when it holds its own index, free ones hold the next free slot
+    const u32* slots = (const u32*) (file + header.entities);
+    living = 0;
+    for (u32 idx = 1; idx < header.slots; ++idx) {
+      if (EntityIndex(slots[idx]) == idx)
+        ++living;
+    }
+    // every other slot must be on the free list exactly once
+    u32 free = 0;
+    for (u32 idx = header.free_head; idx != 0; idx = EntityIndex(slots[idx])) {
+      if (idx >= header.slots || EntityIndex(slots[idx]) == idx || ++free > header.slots - 1 - living) {
+        ERROR("Snapshot %s has a broken free list", path);
+        return false;
+      }
+    }
+    if (free != header.slots - 1 - living) {
+      ERROR("Snapshot %s has a broken free list", path);
+      return false;
+    }
+    return true;
+  }
+
+  bool Snapshot::Load(ECS& ecs, const char* path) {
+    if (ecs.m_Entities.size() != 1 || ecs.m_Reserved.load(std::memory_order_relaxed) > 0) {
+      ERROR("Snapshots can only be loaded into an ecs without entities");
+      return false;
+    }
+    u64 size;
+    const u8* file = (const u8*) Platform::MapFile(path, size);
+    if (!file) {
+      ERROR("Could not open snapshot %s", path);
+      return false;
+    }
+    Header header;
+    if (size < sizeof(Header)) {
+      ERROR("Snapshot %s is truncated", path);
+      Platform::UnmapFile(file, size);
+      return false;
+    }
+    memcpy(&header, file, sizeof(Header));
+    u32 living;
+    if (!validate(header, file, size, path, living)) {
+      Platform::UnmapFile(file, size);
+      return false;
+    }
+
+    // the entity table comes back as it was so ids stay valid
+    const u32* slots = (const u32*) (file + header.entities);
+    ecs.m_Entities.assign(slots, slots + header.slots);
+    ecs.m_FreeHead = header.free_head;
+    ecs.m_ReservePool.clear();
+    ecs.m_LivingEntities = living;
+    if (ecs.m_Storage == ECS::Storage::SparseSet)
+      ecs.m_Signatures.assign(header.slots, Signature());
+
+    // match each saved type to a registered one
+    const TypeEntry* types = (const TypeEntry*) (file + header.types);
+    std::vector<u32> tids(header.type_count, 0);
+    Signature loaded;
+    // last type each slot was seen in, to catch an entity listed twice
+    std::vector<u32> seen(header.slots, 0);
+    for (u32 t = 0; t < header.type_count; ++t) {
+      const TypeEntry& e = types[t];
+      if (e.entities % ALIGN || e.data % ALIGN || e.data + (u64) e.count * e.size > size
+          || e.entities + (u64) e.count * sizeof(u32) > size) {
+        WARN("Skipping component type %d of snapshot %s, it is out of bounds", t, path);
+        continue;
+      }
+      u32 tid = TypeRegistry::Find(e.hash);
+      if (tid == 0 || tid >= ecs.m_Infos.size() || ecs.m_Infos[tid].size == 0) {
+        WARN("Skipping %d components of an unregistered type", e.count);
+        continue;
+      }
+      const ComponentInfo& info = ecs.m_Infos[tid];
+      if (info.size != e.size || !info.trivial) {
+        WARN("Skipping component type %d, it has changed since the snapshot was saved", tid);
+        continue;
+      }
+      if (loaded.Test(tid)) {
+        WARN("Skipping component type %d, it is in the snapshot twice", tid);
+        continue;
+      }
+      // a bad id would otherwise index past the entity table or add a component twice
+      const u32* ids = (const u32*) (file + e.entities);
+      bool alive = true, unique = true;
+      for (u32 i = 0; i < e.count && alive && unique; ++i) {
+        alive = ecs.IsAlive(ids[i]);
+        if (alive) {
+          unique = seen[EntityIndex(ids[i])] != t + 1;
+          seen[EntityIndex(ids[i])] = t + 1;
+        }
+      }
+      if (!alive) {
+        WARN("Skipping component type %d, it belongs to entities that aren't alive", tid);
+        continue;
+      }
+      if (!unique) {
+        WARN("Skipping component type %d, it lists an entity twice", tid);
+        continue;
+      }
+      loaded.Set(tid);
+      tids[t] = tid;
+    }
+
+    if (ecs.m_Storage == ECS::Storage::Archetype) {
+      loadArchetypes(ecs, tids, types, file);
+    } else {
+      for (u32 t = 0; t < header.type_count; ++t) {
+        if (tids[t])
+          loadSparse(ecs, tids[t], types[t], file);
+      }
+    }
+
+    Platform::UnmapFile(file, size);
+    INFO("Loaded %d entities from %s", living, path);
+    return true;
+  }
+
+  void Snapshot::loadSparse(ECS& ecs, u32 tid, const TypeEntry& type, const u8* file) {
+    const u32* ids = (const u32*) (file + type.entities);
+    if (ecs.isTag(tid)) {
+      for (u32 i = 0; i < type.count; ++i)
+        ecs.m_Tags[tid]->Add(ids[i]);
+    } else {
+      ecs.m_CompStorage[tid]->Load(ids, file + type.data, type.count);
+    }
+    for (u32 i = 0; i < type.count; ++i) {
+      ecs.m_Signatures[EntityIndex(ids[i])].Set(tid);
+    }
+  }
+
+  void Snapshot::loadArchetypes(ECS& ecs, const std::vector<u32>& tids, const TypeEntry* types, const u8* file) {
+    ArchetypeStorage& storage = ecs.m_Archetypes;
+    u32 slots = (u32) ecs.m_Entities.size();
+
+    // visit types in id order so each entity is first seen in the array of its lowest type
+    std::vector<u32> order(tids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) { return tids[a] < tids[b]; });
+
+    // the set of types of every entity and its row in the array of each type
+    std::vector<Signature> sigs(slots);
+    std::vector<std::vector<u32>> rows(tids.size());
+    for (u32 t : order) {
+      if (!tids[t])
+        continue;
+      const u32* ids = (const u32*) (file + types[t].entities);
+      rows[t].resize(slots);
+      for (u32 r = 0; r < types[t].count; ++r) {
+        u32 idx = EntityIndex(ids[r]);
+        sigs[idx].Set(tids[t]);
+        rows[t][idx] = r;
+      }
+    }
+
+    // group entities by archetype, keeping the order they were saved in so rows copy as runs
+    std::unordered_map<Signature, std::vector<u32>, Signature::Hash> groups;
+    std::vector<const Signature*> groupOrder;
+    std::vector<u8> placed(slots, 0);
+    for (u32 t : order) {
+      if (!tids[t])
+        continue;
+      const u32* ids = (const u32*) (file + types[t].entities);
+      std::vector<u32>* group = nullptr;
+      const Signature* last = nullptr;
+      for (u32 r = 0; r < types[t].count; ++r) {
+        u32 idx = EntityIndex(ids[r]);
+        if (placed[idx])
+          continue;
+        placed[idx] = 1;
+        // neighbours usually share an archetype
+        if (!last || !(*last == sigs[idx])) {
+          auto [itr, added] = groups.try_emplace(sigs[idx]);
+          if (added)
+            groupOrder.push_back(&itr->first);
+          group = &itr->second;
+          last = &itr->first;
+        }
+        group->push_back(ids[r]);
+      }
+    }
+
+    // where each type id is in the file
+    std::vector<u32> entryOf;
+    for (u32 t = 0; t < tids.size(); ++t) {
+      if (!tids[t])
+        continue;
+      if (tids[t] >= entryOf.size())
+        entryOf.resize(tids[t] + 1);
+      entryOf[tids[t]] = t;
+    }
+
+    u32 tick = ecs.m_Tick;
+    for (const Signature* sig : groupOrder) {
+      const std::vector<u32>& ids = groups[*sig];
+      std::vector<ComponentInfo> infos;
+      sig->ForEach([&](u32 tid) { infos.push_back(ecs.m_Infos[tid]); });
+      Archetype* arch = storage.getArchetype(*sig, std::move(infos));
+
+      // rows are reserved first, entities go in the order they came in
+      std::vector<u32> chunkOf(ids.size()), rowOf(ids.size());
+      for (u32 i = 0; i < ids.size(); ++i) {
+        arch->Push(ids[i], chunkOf[i], rowOf[i]);
+        auto& rec = storage.record(ids[i]);
+        rec.archetype = arch;
+        rec.chunk = chunkOf[i];
+        rec.row = rowOf[i];
+      }
+
+      for (u32 col = 0; col < arch->Types().size(); ++col) {
+        const ComponentInfo& info = arch->Types()[col];
+        u32 t = entryOf[info.id];
+        const u8* src = file + types[t].data;
+        const std::vector<u32>& srcRow = rows[t];
+        // copy as many neighbouring rows as possible at once
+        for (u32 i = 0; i < ids.size();) {
+          u32 from = srcRow[EntityIndex(ids[i])];
+          u32 j = i + 1;
+          while (j < ids.size() && chunkOf[j] == chunkOf[i] && rowOf[j] == rowOf[i] + (j - i)
+              && srcRow[EntityIndex(ids[j])] == from + (j - i))
+            ++j;
+          memcpy(arch->At(chunkOf[i], col, rowOf[i]), src + (u64) from * info.size, (u64) (j - i) * info.size);
+          for (u32 k = i; k < j; ++k)
+            arch->Stamp(chunkOf[k], col, rowOf[k], tick, tick);
+          i = j;
+        }
+      }
+    }
+  }
+}
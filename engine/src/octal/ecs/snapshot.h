@@ -0,0 +1,76 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/ecs/ecs.h"
+
+namespace octal {
+
+  /// Saves and loads every entity and component of an ecs as a single binary file
+  /// The file holds the entity table followed by one packed array per component
+  /// type, each starting on a 64 byte boundary. Loading maps the file and copies
+  /// each array into storage in one go rather than adding components one by one.
+  /// Only trivially copyable components are saved, types are matched by TypeHash
+  /// so files can be loaded by any binary built with the same compiler.
+  class Snapshot {
+    public:
+      /// Identifies snapshot files, "OCSN"
+      static constexpr u32 MAGIC = 0x4e53434f;
+      /// Bumped whenever the layout of the file changes
+      static constexpr u32 VERSION = 1;
+      /// Alignment of every array in the file
+      static constexpr u32 ALIGN = 64;
+
+      /// Start of the file
+      struct Header {
+        u32 magic;
+        u32 version;
+        /// Number of slots in the entity table
+        u32 slots;
+        /// First free slot of the entity table
+        u32 free_head;
+        /// Number of living entities
+        u32 living;
+        /// Number of component types saved
+        u32 type_count;
+        /// Offset of the entity table
+        u64 entities;
+        /// Offset of the array of TypeEntry
+        u64 types;
+      };
+
+      /// Where the components of one type are in the file
+      struct TypeEntry {
+        /// TypeHash of the component
+        u64 hash;
+        /// Size of the component in bytes
+        u32 size;
+        /// Number of components
+        u32 count;
+        /// Offset of the owner of each component
+        u64 entities;
+        /// Offset of the components
+        u64 data;
+      };
+
+      /// Write every entity and trivially copyable component to a file
+      /// @param ecs to save
+      /// @param path of the file, replaced if it exists
+      /// @return false if the file couldn't be written
+      API static bool Save(const ECS& ecs, const char* path);
+
+      /// Load entities and components from a file into an empty ecs
+      /// Entities keep the ids they were saved with and every component is
+      /// stamped as added in the current tick. Component types must be
+      /// registered with ECS::Register first, types that aren't are skipped.
+      /// @param ecs to load into, must not have created any entities yet
+      /// @param path of the file
+      /// @return false if the file couldn't be read or isn't a valid snapshot
+      API static bool Load(ECS& ecs, const char* path);
+
+    private:
+      /// Copy the components of one type from a mapped file into sparse set storage
+      static void loadSparse(ECS& ecs, u32 tid, const TypeEntry& type, const u8* file);
+
+      /// Place the entities of every type from a mapped file into archetypes
+      static void loadArchetypes(ECS& ecs, const std::vector<u32>& tids, const TypeEntry* types, const u8* file);
+  };
+}
@@ -0,0 +1,63 @@
+#include "octal/ecs/spatial.h"
+#include "octal/core/jobs.h"
+#include "octal/core/memory.h"
+
+namespace octal {
+
+  AABB SpatialTracker::boxOf(ECS& ecs, u32 id, const WorldTransform& world) {
+    if (const Bounds* b = ecs.GetComponent<const Bounds>(id))
+      return TransformBox(world.matrix, b->box);
+    vec3 p = world.matrix.c[3].xyz();
+    return {p, p};
+  }
+
+  void SpatialTracker::Update(ECS& ecs) {
+    // boxes are looked up from several threads so the storage has to exist first
+    ecs.Register<WorldTransform, Bounds>();
+    // everything from here on is newer than seen
+    u32 seen = ecs.NextTick();
+    if (!m_Built) {
+      rebuild(ecs);
+      m_Seen = seen;
+      return;
+    }
+
+    ecs.EachRemoved<WorldTransform>(m_Seen, [&](u32 id) { m_Index->Remove(id); });
+    std::pmr::vector<u32> changed(Memory::FrameResource());
+    ecs.View<const WorldTransform>().Changed<WorldTransform>(m_Seen).Each([&](u32 id, const WorldTransform&) {
+      changed.push_back(id);
+    });
+    ecs.View<const WorldTransform, const Bounds>().Changed<Bounds>(m_Seen).Each([&](u32 id, const WorldTransform&, const Bounds&) {
+      changed.push_back(id);
+    });
+    // losing its bounds turns an entity back into a point
+    ecs.EachRemoved<Bounds>(m_Seen, [&](u32 id) { changed.push_back(id); });
+
+    if (changed.size() > REBUILD_FRACTION * m_Index->Size()) {
+      rebuild(ecs);
+    } else {
+      for (u32 id : changed) {
+        const WorldTransform* world = ecs.GetComponent<const WorldTransform>(id);
+        if (world)
+          m_Index->Update(id, boxOf(ecs, id, *world));
+      }
+    }
+    m_Seen = seen;
+  }
+
+  void SpatialTracker::rebuild(ECS& ecs) {
+    std::vector<u32> ids;
+    std::vector<const WorldTransform*> worlds;
+    ecs.View<const WorldTransform>().Each([&](u32 id, const WorldTransform& world) {
+      ids.push_back(id);
+      worlds.push_back(&world);
+    });
+    std::vector<AABB> boxes(ids.size());
+    JobSystem::ParallelFor((u32) ids.size(), 4096, [&](u32 begin, u32 end) {
+      for (u32 i = begin; i < end; ++i)
+        boxes[i] = boxOf(ecs, ids[i], *worlds[i]);
+    });
+    m_Index->Build(ids.data(), boxes.data(), (u32) ids.size());
+    m_Built = true;
+  }
+}
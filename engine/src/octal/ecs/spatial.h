@@ -0,0 +1,47 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/ecs/ecs.h"
+#include "octal/spatial/index.h"
+
+namespace octal {
+
+  /// Keeps a spatial index in sync with the WorldTransforms of an ecs
+  /// Every entity with a WorldTransform is indexed by its Bounds moved into
+  /// world space, or as a point if it has none. Only entities whose
+  /// WorldTransform or Bounds changed since the last update are touched, and
+  /// when enough of them have changed the index is rebuilt in one go instead.
+  class SpatialTracker {
+    public:
+      /// Rebuild instead of updating once more than this part of the index has changed
+      static constexpr f32 REBUILD_FRACTION = 0.25f;
+
+      /// Constructor
+      /// @param index to keep in sync
+      SpatialTracker(Scope<SpatialIndex> index) : m_Index(std::move(index)) {};
+
+      /// Bring the index up to date with an ecs
+      /// @param ecs to read from, must be the same one every time until Reset
+      void Update(ECS& ecs);
+
+      /// Forget what has been seen so the next update rebuilds everything
+      void Reset() { m_Built = false; }
+
+      /// The index being kept in sync
+      const SpatialIndex& Index() const { return *m_Index; }
+
+    private:
+      /// Rebuild the index from every WorldTransform
+      void rebuild(ECS& ecs);
+
+      /// World space box of an entity
+      static AABB boxOf(ECS& ecs, u32 id, const WorldTransform& world);
+
+      /// The index being kept in sync
+      Scope<SpatialIndex> m_Index;
+
+      /// Change tick of the last update
+      u32 m_Seen{0};
+      /// Has the index been built yet?
+      bool m_Built{false};
+  };
+}
@@ -0,0 +1,83 @@
+#include "octal/ecs/tagstore.h"
+#include "octal/math/math.h"
+
+namespace octal {
+
+  u32 TagStore::CountAll(const TagStore* const* stores, u32 count) {
+    if (count == 1)
+      return stores[0]->Size();
+    u32 words = stores[0]->WordCount();
+    for (u32 s = 1; s < count; ++s)
+      words = std::min(words, stores[s]->WordCount());
+    u64 block[BLOCK_WORDS];
+    u32 total = 0;
+    for (u32 w = 0; w < words; w += BLOCK_WORDS) {
+      u32 n = std::min(BLOCK_WORDS, words - w);
+      And(block, stores[0]->Words() + w, stores[1]->Words() + w, n);
+      for (u32 s = 2; s < count; ++s)
+        And(block, block, stores[s]->Words() + w, n);
+      total += PopCount(block, n);
+    }
+    return total;
+  }
+
+  // each kernel does as many words as it can with vectors and finishes with scalars
+  void TagStore::And(u64* dst, const u64* a, const u64* b, u32 words) {
+    u32 i = 0;
+#if MATH_AVX2
+    for (; i + 4 <= words; i += 4) {
+      __m256i r = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (a + i)), _mm256_loadu_si256((const __m256i*) (b + i)));
+      _mm256_storeu_si256((__m256i*) (dst + i), r);
+    }
+#elif MATH_SSE
+    for (; i + 2 <= words; i += 2) {
+      __m128i r = _mm_and_si128(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+      _mm_storeu_si128((__m128i*) (dst + i), r);
+    }
+#endif
+    for (; i < words; ++i)
+      dst[i] = a[i] & b[i];
+  }
+
+  void TagStore::AndNot(u64* dst, const u64* a, const u64* b, u32 words) {
+    u32 i = 0;
+#if MATH_AVX2
+    for (; i + 4 <= words; i += 4) {
+      // andnot clears the bits of its first operand
+      __m256i r = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*) (b + i)), _mm256_loadu_si256((const __m256i*) (a + i)));
+      _mm256_storeu_si256((__m256i*) (dst + i), r);
+    }
+#elif MATH_SSE
+    for (; i + 2 <= words; i += 2) {
+      __m128i r = _mm_andnot_si128(_mm_loadu_si128((const __m128i*) (b + i)), _mm_loadu_si128((const __m128i*) (a + i)));
+      _mm_storeu_si128((__m128i*) (dst + i), r);
+    }
+#endif
+    for (; i < words; ++i)
+      dst[i] = a[i] & ~b[i];
+  }
+
+  void TagStore::Or(u64* dst, const u64* a, const u64* b, u32 words) {
+    u32 i = 0;
+#if MATH_AVX2
+    for (; i + 4 <= words; i += 4) {
+      __m256i r = _mm256_or_si256(_mm256_loadu_si256((const __m256i*) (a + i)), _mm256_loadu_si256((const __m256i*) (b + i)));
+      _mm256_storeu_si256((__m256i*) (dst + i), r);
+    }
+#elif MATH_SSE
+    for (; i + 2 <= words; i += 2) {
+      __m128i r = _mm_or_si128(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+      _mm_storeu_si128((__m128i*) (dst + i), r);
+    }
+#endif
+    for (; i < words; ++i)
+      dst[i] = a[i] | b[i];
+  }
+
+  u32 TagStore::PopCount(const u64* words, u32 count) {
+    u32 total = 0;
+    for (u32 i = 0; i < count; ++i)
+      total += (u32) std::popcount(words[i]);
+    return total;
+  }
+}
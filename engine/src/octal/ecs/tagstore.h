@@ -0,0 +1,153 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/core/memory.h"
+#include "octal/ecs/entityid.h"
+#include <algorithm>
+#include <bit>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+namespace octal {
+
+  /// Is a component type a tag?
+  /// Tags have no data, so with sparse set storage they are kept as one bit
+  /// per entity in a TagStore instead of a CompStore.
+  template<typename C>
+  constexpr bool IsTag = std::is_empty_v<std::remove_const_t<C>>;
+
+  /// Storage for a tag component, one bit per entity index
+  /// Bits are packed into 64 bit words so checking a tag is a single load and
+  /// iterating skips 64 entities without the tag at a time. Entities with
+  /// several tags are found by combining whole words of each tag's bits.
+  /// Tags don't record change ticks.
+  class TagStore {
+    public:
+      /// Number of words combined at a time when iterating several tags
+      static constexpr u32 BLOCK_WORDS = 64;
+
+      /// Constructor
+      TagStore() {};
+      /// Copies count against MemoryTag::ECS like the original
+      TagStore(const TagStore& other) : m_Words(other.m_Words, Memory::Resource(MemoryTag::ECS)), m_Count(other.m_Count) {};
+      TagStore& operator=(const TagStore&) = default;
+
+      /// Give an entity the tag
+      /// @param id of the entity
+      /// @return false if it already had it
+      bool Add(u32 id) {
+        u32 idx = EntityIndex(id);
+        if (idx / 64 >= m_Words.size())
+          m_Words.resize(idx / 64 + 1, 0);
+        u64 bit = 1ull << (idx % 64);
+        if (m_Words[idx / 64] & bit)
+          return false;
+        m_Words[idx / 64] |= bit;
+        ++m_Count;
+        return true;
+      }
+
+      /// Take the tag away from an entity
+      /// @param id of the entity
+      /// @return false if it didn't have it
+      bool Remove(u32 id) {
+        u32 idx = EntityIndex(id);
+        u64 bit = 1ull << (idx % 64);
+        if (idx / 64 >= m_Words.size() || !(m_Words[idx / 64] & bit))
+          return false;
+        m_Words[idx / 64] &= ~bit;
+        --m_Count;
+        return true;
+      }
+
+      /// Does an entity have the tag?
+      /// Only the index part of the id is checked
+      /// @param id of the entity
+      bool Has(u32 id) const {
+        u32 idx = EntityIndex(id);
+        return idx / 64 < m_Words.size() && (m_Words[idx / 64] >> (idx % 64) & 1);
+      }
+
+      /// Number of entities with the tag
+      u32 Size() const { return m_Count; }
+
+      /// The bits, entity index i is bit i % 64 of word i / 64
+      const u64* Words() const { return m_Words.data(); }
+
+      /// Number of words of bits
+      u32 WordCount() const { return (u32) m_Words.size(); }
+
+      /// Call a function on the index of every entity with the tag, in index order
+      /// @param func called as func(u32 index)
+      template<typename F>
+      void Each(F&& func) const {
+        eachBit(m_Words.data(), 0, (u32) m_Words.size(), func);
+      }
+
+      /// Call a function on the index of every entity that has all of some tags, in index order
+      /// @param stores the tags to check, none of them null
+      /// @param count number of stores
+      /// @param func called as func(u32 index)
+      template<typename F>
+      static void EachAll(const TagStore* const* stores, u32 count, F&& func) {
+        if (count == 1) {
+          stores[0]->Each(func);
+          return;
+        }
+        // entities past the end of the shortest store can't have every tag
+        u32 words = stores[0]->WordCount();
+        for (u32 s = 1; s < count; ++s)
+          words = std::min(words, stores[s]->WordCount());
+        u64 block[BLOCK_WORDS];
+        for (u32 w = 0; w < words; w += BLOCK_WORDS) {
+          u32 n = std::min(BLOCK_WORDS, words - w);
+          And(block, stores[0]->Words() + w, stores[1]->Words() + w, n);
+          for (u32 s = 2; s < count; ++s)
+            And(block, block, stores[s]->Words() + w, n);
+          eachBit(block, w, n, func);
+        }
+      }
+
+      /// Count the entities that have all of some tags
+      /// @param stores the tags to check, none of them null
+      /// @param count number of stores
+      API static u32 CountAll(const TagStore* const* stores, u32 count);
+
+      /// dst = a & b for arrays of words
+      API static void And(u64* dst, const u64* a, const u64* b, u32 words);
+
+      /// dst = a & ~b for arrays of words
+      API static void AndNot(u64* dst, const u64* a, const u64* b, u32 words);
+
+      /// dst = a | b for arrays of words
+      API static void Or(u64* dst, const u64* a, const u64* b, u32 words);
+
+      /// Number of bits set in an array of words
+      API static u32 PopCount(const u64* words, u32 count);
+
+      /// The instance handed out for every entity with a tag, since tags have no data
+      template<typename C>
+      static C* Instance() {
+        static C s_Instance;
+        return &s_Instance;
+      }
+
+    private:
+      /// Call a function on the index of every set bit in some words
+      /// @param first index of the first word, for turning bits into entity indices
+      template<typename F>
+      static void eachBit(const u64* words, u32 first, u32 count, F& func) {
+        for (u32 w = 0; w < count; ++w) {
+          // clear the lowest set bit until there are none left
+          for (u64 bits = words[w]; bits != 0; bits &= bits - 1)
+            func((first + w) * 64 + (u32) std::countr_zero(bits));
+        }
+      }
+
+      /// One bit per entity index
+      std::pmr::vector<u64> m_Words{Memory::Resource(MemoryTag::ECS)};
+
+      /// Number of bits set
+      u32 m_Count{0};
+  };
+}
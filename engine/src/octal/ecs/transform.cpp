@@ -0,0 +1,161 @@
+#include "octal/ecs/transform.h"
+#include "octal/core/jobs.h"
+#include "octal/core/logger.h"
+#include <unordered_map>
+
+namespace octal {
+
+  void TransformHierarchy::Update(ECS& ecs) {
+    // everything from here on is newer than seen
+    u32 seen = ecs.NextTick();
+    if (!m_Built || structureChanged(ecs)) {
+      rebuild(ecs);
+    } else {
+      gather(ecs);
+    }
+    propagate();
+    writeBack(ecs);
+    m_Seen = seen;
+  }
+
+  bool TransformHierarchy::structureChanged(ECS& ecs) {
+    bool changed = false;
+    ecs.EachRemoved<Parent>(m_Seen, [&](u32) { changed = true; });
+    ecs.EachRemoved<Transform>(m_Seen, [&](u32) { changed = true; });
+    // rebuilding puts back a WorldTransform that was taken off
+    ecs.EachRemoved<WorldTransform>(m_Seen, [&](u32) { changed = true; });
+    if (changed)
+      return true;
+    // reparenting shows up as a changed Parent
+    auto parents = ecs.View<const Parent>().Changed<Parent>(m_Seen);
+    if (parents.begin() != parents.end())
+      return true;
+    auto added = ecs.View<const Transform>().Added<Transform>(m_Seen);
+    return added.begin() != added.end();
+  }
+
+  void TransformHierarchy::rebuild(ECS& ecs) {
+    // find the children of every node
+    std::vector<u32> nodes;
+    ecs.View<const Transform>().Each([&](u32 id, const Transform&) {
+      nodes.push_back(id);
+    });
+    std::unordered_map<u32, std::vector<u32>> children;
+    std::vector<u32> roots;
+    for (u32 id : nodes) {
+      const Parent* p = ecs.GetComponent<const Parent>(id);
+      // a parent without a transform can't place its children
+      if (p && p->entity != id && ecs.GetComponent<const Transform>(p->entity)) {
+        children[p->entity].push_back(id);
+      } else {
+        roots.push_back(id);
+      }
+    }
+
+    m_Entities.clear();
+    m_Parents.clear();
+    m_RootOf.clear();
+    m_Roots.clear();
+    m_IndexOf.assign(m_IndexOf.size(), 0);
+
+    // walk each root depth-first, children are pushed backwards to keep their order
+    std::vector<std::pair<u32, u32>> stack;
+    for (u32 root : roots) {
+      m_Roots.push_back((u32) m_Entities.size());
+      stack.push_back({root, NONE});
+      while (!stack.empty()) {
+        auto [id, parent] = stack.back();
+        stack.pop_back();
+        u32 idx = (u32) m_Entities.size();
+        m_Entities.push_back(id);
+        m_Parents.push_back(parent);
+        m_RootOf.push_back((u32) m_Roots.size() - 1);
+        if (EntityIndex(id) >= m_IndexOf.size())
+          m_IndexOf.resize(EntityIndex(id) + 1, 0);
+        m_IndexOf[EntityIndex(id)] = idx + 1;
+        auto itr = children.find(id);
+        if (itr == children.end())
+          continue;
+        for (auto c = itr->second.rbegin(); c != itr->second.rend(); ++c) {
+          stack.push_back({*c, idx});
+        }
+      }
+    }
+    if (m_Entities.size() != nodes.size()) {
+      WARN("%d transforms are in a parent cycle and won't be updated", (u32) (nodes.size() - m_Entities.size()));
+    }
+
+    // subtrees end where the last of their descendants does
+    u32 count = (u32) m_Entities.size();
+    m_SubtreeEnd.resize(count);
+    for (u32 i = 0; i < count; ++i) {
+      m_SubtreeEnd[i] = i + 1;
+    }
+    for (u32 i = count; i-- > 0;) {
+      if (m_Parents[i] != NONE && m_SubtreeEnd[i] > m_SubtreeEnd[m_Parents[i]])
+        m_SubtreeEnd[m_Parents[i]] = m_SubtreeEnd[i];
+    }
+
+    m_Local.resize(count);
+    m_World.resize(count);
+    m_Dirty.assign(count, 1);
+    m_RootDirty.assign(m_Roots.size(), 1);
+    for (u32 i = 0; i < count; ++i) {
+      u32 id = m_Entities[i];
+      m_Local[i] = ecs.GetComponent<const Transform>(id)->Local();
+      if (!ecs.GetComponent<const WorldTransform>(id))
+        ecs.Emplace<WorldTransform>(id);
+    }
+    m_Built = true;
+  }
+
+  void TransformHierarchy::gather(ECS& ecs) {
+    ecs.View<const Transform>().Changed<Transform>(m_Seen).Each([&](u32 id, const Transform& t) {
+      u32 idx = indexOf(id);
+      if (idx == NONE)
+        return;
+      m_Local[idx] = t.Local();
+      m_Dirty[idx] = 1;
+      m_RootDirty[m_RootOf[idx]] = 1;
+    });
+  }
+
+  void TransformHierarchy::propagate() {
+    u32 count = (u32) m_Entities.size();
+    JobSystem::ParallelFor((u32) m_Roots.size(), 16, [&](u32 begin, u32 end) {
+      for (u32 r = begin; r < end; ++r) {
+        if (!m_RootDirty[r])
+          continue;
+        u32 last = r + 1 < m_Roots.size() ? m_Roots[r + 1] : count;
+        // parents come first so their dirty flag and matrix are already final
+        for (u32 i = m_Roots[r]; i < last; ++i) {
+          u32 p = m_Parents[i];
+          if (p == NONE) {
+            if (m_Dirty[i])
+              m_World[i] = m_Local[i];
+          } else if (m_Dirty[i] || m_Dirty[p]) {
+            m_World[i] = m_World[p] * m_Local[i];
+            m_Dirty[i] = 1;
+          }
+        }
+      }
+    });
+  }
+
+  void TransformHierarchy::writeBack(ECS& ecs) {
+    u32 count = (u32) m_Entities.size();
+    for (u32 r = 0; r < m_Roots.size(); ++r) {
+      if (!m_RootDirty[r])
+        continue;
+      u32 last = r + 1 < m_Roots.size() ? m_Roots[r + 1] : count;
+      for (u32 i = m_Roots[r]; i < last; ++i) {
+        if (!m_Dirty[i])
+          continue;
+        if (WorldTransform* world = ecs.GetComponent<WorldTransform>(m_Entities[i]))
+          world->matrix = m_World[i];
+        m_Dirty[i] = 0;
+      }
+      m_RootDirty[r] = 0;
+    }
+  }
+}
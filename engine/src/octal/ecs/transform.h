@@ -0,0 +1,105 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/math/math.h"
+#include "octal/ecs/ecs.h"
+#include <vector>
+
+namespace octal {
+
+  /// Keeps the WorldTransform of every entity with a Transform up to date
+  /// Nodes are stored depth-first so every parent comes before its children and
+  /// each root's subtree is one contiguous range. Propagating world matrices is
+  /// then a single linear pass per root, and roots are split across the job system.
+  /// Only subtrees under a changed Transform are recomputed.
+  class TransformHierarchy {
+    public:
+      /// Marks a node without a parent
+      static constexpr u32 NONE = ~0u;
+
+      /// Constructor
+      TransformHierarchy() {};
+
+      /// Bring every WorldTransform up to date with the Transforms and Parents in an ecs
+      /// The order is rebuilt when Parents or Transforms are added or removed,
+      /// otherwise only changed Transforms are read.
+      /// @param ecs to update, must be the same one every time
+      void Update(ECS& ecs);
+
+      /// Number of nodes in the hierarchy
+      u32 Size() const { return (u32) m_Entities.size(); }
+
+      /// World matrix of an entity as of the last update
+      /// @param id of the entity
+      /// @return the matrix or null if the entity isn't in the hierarchy
+      const mat4* World(u32 id) const {
+        u32 idx = indexOf(id);
+        return idx == NONE ? nullptr : &m_World[idx];
+      }
+
+      /// Call a function on every direct child of an entity
+      /// @param id of the parent entity
+      /// @param func called as func(u32 child)
+      template<typename F>
+      void EachChild(u32 id, F&& func) const {
+        u32 idx = indexOf(id);
+        if (idx == NONE)
+          return;
+        // skip over each child's own subtree
+        for (u32 i = idx + 1; i < m_SubtreeEnd[idx]; i = m_SubtreeEnd[i]) {
+          func(m_Entities[i]);
+        }
+      }
+
+    private:
+      /// Index of an entity in the depth-first order or NONE
+      u32 indexOf(u32 id) const {
+        u32 idx = EntityIndex(id);
+        if (idx >= m_IndexOf.size() || m_IndexOf[idx] == 0 || m_Entities[m_IndexOf[idx] - 1] != id)
+          return NONE;
+        return m_IndexOf[idx] - 1;
+      }
+
+      /// Have Parents or Transforms been added or removed since the last update?
+      bool structureChanged(ECS& ecs);
+
+      /// Sort every node depth-first and mark them all dirty
+      void rebuild(ECS& ecs);
+
+      /// Read the Transforms that changed since the last update
+      void gather(ECS& ecs);
+
+      /// Recompute the world matrices of dirty subtrees
+      void propagate();
+
+      /// Write dirty world matrices into the ecs and clear the dirty flags
+      void writeBack(ECS& ecs);
+
+      /// Entity of each node in depth-first order
+      std::vector<u32> m_Entities;
+      /// Index of each node's parent or NONE
+      std::vector<u32> m_Parents;
+      /// Index past the last node in each node's subtree
+      std::vector<u32> m_SubtreeEnd;
+      /// Index of the root of each node's subtree in m_Roots
+      std::vector<u32> m_RootOf;
+      /// Matrix from each node to its parent
+      std::vector<mat4> m_Local;
+      /// Matrix from each node to the world
+      std::vector<mat4> m_World;
+      /// Does the node need its world matrix recomputed?
+      std::vector<u8> m_Dirty;
+
+      /// Index of the first node of each root's subtree
+      std::vector<u32> m_Roots;
+      /// Does anything in the root's subtree need recomputing?
+      std::vector<u8> m_RootDirty;
+
+      /// Index of each node plus one, indexed by the index part of the entity id
+      std::vector<u32> m_IndexOf;
+
+      /// Change tick of the last update
+      u32 m_Seen{0};
+      /// Has the order been built yet?
+      bool m_Built{false};
+  };
+}
@@ -0,0 +1,52 @@
+#include "octal/ecs/typeid.h"
+#include "octal/core/logger.h"
+#include "octal/core/asserts.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace octal {
+
+  /// Registered types
+  /// Kept in a function so it exists before any static initializer asks for it
+  struct TypeTable {
+    std::mutex lock;
+    /// Index of each type hash
+    std::unordered_map<u64, u32> indices;
+    /// Name of each type by index, index 0 is reserved
+    std::vector<std::string> names{""};
+  };
+
+  static TypeTable& table() {
+    static TypeTable t;
+    return t;
+  }
+
+  u32 TypeRegistry::Register(u64 hash, std::string_view name) {
+    TypeTable& t = table();
+    std::lock_guard<std::mutex> guard(t.lock);
+    auto itr = t.indices.find(hash);
+    if (itr != t.indices.end()) {
+      ASSERT(t.names[itr->second] == name, "Component type hash collision");
+      return itr->second;
+    }
+    u32 idx = (u32) t.names.size();
+    t.indices.emplace(hash, idx);
+    t.names.emplace_back(name);
+    return idx;
+  }
+
+  u32 TypeRegistry::Find(u64 hash) {
+    TypeTable& t = table();
+    std::lock_guard<std::mutex> guard(t.lock);
+    auto itr = t.indices.find(hash);
+    return itr == t.indices.end() ? 0 : itr->second;
+  }
+
+  u32 TypeRegistry::Count() {
+    TypeTable& t = table();
+    std::lock_guard<std::mutex> guard(t.lock);
+    return (u32) t.names.size() - 1;
+  }
+}
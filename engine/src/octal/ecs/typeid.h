@@ -0,0 +1,92 @@
+#pragma once
+#include "octal/defines.h"
+#include <string_view>
+#include <type_traits>
+
+namespace octal {
+
+  /// Get the name of a type at compile time
+  /// The name comes from the compiler so it is the same in every binary built by it
+  template<typename T>
+  constexpr std::string_view TypeName() {
+#if defined(__clang__) || defined(__GNUC__)
+    // "... TypeName() [T = Foo]" or "... TypeName() [with T = Foo; ...]"
+    std::string_view name = __PRETTY_FUNCTION__;
+    size_t start = name.find("T = ") + 4;
+    size_t end = name.find_first_of(";]", start);
+    return name.substr(start, end - start);
+#elif defined(_MSC_VER)
+    // "... TypeName<struct Foo>(void)"
+    std::string_view name = __FUNCSIG__;
+    size_t start = name.find("TypeName<") + 9;
+    size_t end = name.rfind(">(void)");
+    return name.substr(start, end - start);
+#else
+#error "Unsupported compiler for TypeName"
+#endif
+  }
+
+  /// Is a type's name the same in every translation unit?
+  /// Types in an anonymous namespace are named alike in each file that declares
+  /// one, so two of them with the same name would share an index.
+  template<typename T>
+  constexpr bool HasUniqueName() {
+    // as clang, gcc and msvc spell it
+    std::string_view name = TypeName<T>();
+    return name.find("(anonymous namespace)") == std::string_view::npos
+      && name.find("{anonymous}") == std::string_view::npos
+      && name.find("`anonymous namespace'") == std::string_view::npos;
+  }
+
+  /// Hash the name of a type at compile time (64 bit FNV-1a)
+  template<typename T>
+  constexpr u64 TypeHash() {
+    u64 hash = 14695981039346656037ull;
+    for (char c : TypeName<T>()) {
+      hash = (hash ^ (u8) c) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  /// Hands out dense indices for type hashes
+  /// Indices are shared by every binary that links against the engine and
+  /// don't depend on the order types are first used in. Types are told apart
+  /// by their qualified name alone, so it must be unique across the program.
+  class TypeRegistry {
+    public:
+      /// Get the dense index of a type, registering it if it is new
+      /// @param hash of the type from TypeHash
+      /// @param name of the type from TypeName, used to catch collisions
+      /// @return the index of the type, never 0
+      API static u32 Register(u64 hash, std::string_view name);
+
+      /// Find the index of a type that is already registered
+      /// @param hash of the type from TypeHash
+      /// @return the index of the type or 0 if it hasn't been registered
+      API static u32 Find(u64 hash);
+
+      /// Number of types registered so far
+      API static u32 Count();
+  };
+
+  /// Caches the dense index of a type so looking it up is a plain load
+  template<typename T>
+  struct TypeIndex {
+    static_assert(HasUniqueName<T>(), "Types in an anonymous namespace can't be given a type id, name the namespace");
+    /// Set during static initialization, 0 until then
+    static inline const u32 value = TypeRegistry::Register(TypeHash<T>(), TypeName<T>());
+  };
+
+  /// Get the dense index of a component type
+  /// const and non const versions of a type share an index
+  /// @return a number representing the type given, starting at 1
+  template<typename C>
+  inline u32 TypeId() {
+    using T = std::remove_cv_t<C>;
+    u32 id = TypeIndex<T>::value;
+    // only when asked for from another static initializer
+    if (id == 0) [[unlikely]]
+      return TypeRegistry::Register(TypeHash<T>(), TypeName<T>());
+    return id;
+  }
+}
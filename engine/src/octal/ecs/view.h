@@ -0,0 +1,498 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/core/jobs.h"
+#include "octal/core/memory.h"
+#include "octal/ecs/compstore.h"
+#include "octal/ecs/archetype.h"
+#include "octal/ecs/tagstore.h"
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+namespace octal {
+
+  /// Iterates all the entities that have every one of the components Cs
+  /// With sparse set storage iteration is driven by the smallest of the stores
+  /// involved, walking its packed entity array and only looking up the other
+  /// components by id. With archetype storage every matching chunk is walked linearly.
+  /// Component types can be const to show they are only read. Components that
+  /// aren't const are marked as changed for every entity visited.
+  /// Added and Changed filters narrow the view down to components that are newer
+  /// than a tick, so consumers only touch what changed since they last looked.
+  /// With and Without narrow it down to entities that have or lack some tags.
+  /// Adding or removing components of the viewed types while iterating is not allowed
+  template<typename... Cs>
+  class View {
+    private:
+      /// Number of component types in this view
+      static constexpr u32 N = sizeof...(Cs);
+      static_assert(N > 0, "A view needs at least one component type");
+
+      /// The stores for each component type
+      std::tuple<CompStore<std::remove_const_t<Cs>>*...> m_Stores;
+
+      /// The store with the fewest components which we use to drive iteration
+      CompStoreBase* m_Driver{nullptr};
+
+      /// Archetype storage if that is what we are viewing, null for sparse sets
+      ArchetypeStorage* m_Archetypes{nullptr};
+
+      /// The archetypes that have all the components
+      std::vector<Archetype*> m_Matches;
+
+      /// Tick that visited components are marked as changed in
+      u32 m_Tick;
+
+      /// Only visit components added after this tick, for each component type
+      std::array<u32, N> m_AddedSince{};
+
+      /// Only visit components changed after this tick, for each component type
+      std::array<u32, N> m_ChangedSince{};
+
+      /// Does the view have any filters?
+      bool m_Filtered{false};
+
+      /// Bits of every tag type with sparse set storage
+      const std::vector<Scope<TagStore>>* m_Tags{nullptr};
+
+      /// Tags an entity must have, a null store is a tag nobody has
+      std::vector<const TagStore*> m_With;
+
+      /// Tags an entity must not have
+      std::vector<const TagStore*> m_Without;
+
+    public:
+      /// Create a view over some component stores
+      /// @param tick the current change tick
+      /// @param tags the bits of each tag type, indexed by type id
+      /// @param stores the storage for each component type
+      View(u32 tick, const std::vector<Scope<TagStore>>* tags, CompStore<std::remove_const_t<Cs>>*... stores)
+        : m_Stores(stores...), m_Tick(tick), m_Tags(tags) {
+        for (CompStoreBase* s : {static_cast<CompStoreBase*>(stores)...}) {
+          if (!m_Driver || s->Size() < m_Driver->Size())
+            m_Driver = s;
+        }
+      }
+
+      /// Create a view over archetype storage
+      /// @param tick the current change tick
+      /// @param storage the archetypes to look through
+      View(u32 tick, ArchetypeStorage* storage) : m_Archetypes(storage), m_Tick(tick) {
+        storage->Match(ArchetypeStorage::SignatureOf<Cs...>(), m_Matches);
+      }
+
+      /// Only visit entities whose component C was added after a tick
+      /// @param since tick from ECS::NextTick when the caller last looked
+      template<typename C>
+      View& Added(u32 since) & {
+        m_AddedSince[indexOf<C>()] = since;
+        m_Filtered = true;
+        return *this;
+      }
+
+      /// Filtering a temporary view gives back a view so it can still be iterated
+      template<typename C>
+      View Added(u32 since) && {
+        return std::move(Added<C>(since));
+      }
+
+      /// Only visit entities whose component C was added or changed after a tick
+      /// @param since tick from ECS::NextTick when the caller last looked
+      template<typename C>
+      View& Changed(u32 since) & {
+        m_ChangedSince[indexOf<C>()] = since;
+        m_Filtered = true;
+        return *this;
+      }
+
+      /// Filtering a temporary view gives back a view so it can still be iterated
+      template<typename C>
+      View Changed(u32 since) && {
+        return std::move(Changed<C>(since));
+      }
+
+      /// Only visit entities that have all of the tags Ts
+      template<typename... Ts>
+      View& With() & {
+        static_assert((IsTag<Ts> && ...), "With only takes tags");
+        if (m_Archetypes) {
+          Signature tags = ArchetypeStorage::SignatureOf<Ts...>();
+          std::erase_if(m_Matches, [&](Archetype* arch) { return !arch->GetSignature().Contains(tags); });
+        } else {
+          (m_With.push_back(findTag<Ts>()), ...);
+        }
+        return *this;
+      }
+
+      /// Filtering a temporary view gives back a view so it can still be iterated
+      template<typename... Ts>
+      View With() && {
+        return std::move(With<Ts...>());
+      }
+
+      /// Only visit entities that have none of the tags Ts
+      template<typename... Ts>
+      View& Without() & {
+        static_assert((IsTag<Ts> && ...), "Without only takes tags");
+        if (m_Archetypes) {
+          Signature tags = ArchetypeStorage::SignatureOf<Ts...>();
+          std::erase_if(m_Matches, [&](Archetype* arch) { return arch->GetSignature().Intersects(tags); });
+        } else {
+          auto add = [&](const TagStore* tag) {
+            // nobody has a tag without a store so it filters nothing
+            if (tag)
+              m_Without.push_back(tag);
+          };
+          (add(findTag<Ts>()), ...);
+        }
+        return *this;
+      }
+
+      /// Filtering a temporary view gives back a view so it can still be iterated
+      template<typename... Ts>
+      View Without() && {
+        return std::move(Without<Ts...>());
+      }
+
+      /// Call a function on every entity in the view
+      /// @param func either func(u32 id, Cs&...) or func(Cs&...)
+      template<typename F>
+      void Each(F&& func) {
+        if (m_Archetypes) {
+          for (Archetype* arch : m_Matches) {
+            for (u32 c = 0; c < arch->ChunkCount(); ++c) {
+              eachChunk(func, arch->GetChunk(c), arch, std::index_sequence_for<Cs...>{});
+            }
+          }
+          return;
+        }
+        eachRange(func, 0, m_Driver->Size(), std::index_sequence_for<Cs...>{});
+      }
+
+      /// Call a function on every entity in the view, split into batches across the job system
+      /// The function is called concurrently so it must only touch the entity it is given.
+      /// @param func either func(u32 id, Cs&...) or func(Cs&...)
+      /// @param batch how many entities each task handles with sparse set storage.
+      ///              With archetype storage each task handles a chunk.
+      template<typename F>
+      void ParallelEach(F&& func, u32 batch = 1024) {
+        if (m_Archetypes) {
+          // flatten the chunks so they can be handed out
+          std::pmr::vector<std::pair<Archetype*, u32>> chunks(Memory::FrameResource());
+          for (Archetype* arch : m_Matches) {
+            for (u32 c = 0; c < arch->ChunkCount(); ++c)
+              chunks.emplace_back(arch, c);
+          }
+          JobSystem::ParallelFor((u32) chunks.size(), 1, [&](u32 begin, u32 end) {
+            for (u32 i = begin; i < end; ++i) {
+              Archetype* arch = chunks[i].first;
+              eachChunk(func, arch->GetChunk(chunks[i].second), arch, std::index_sequence_for<Cs...>{});
+            }
+          });
+          return;
+        }
+        JobSystem::ParallelFor(m_Driver->Size(), batch, [&](u32 begin, u32 end) {
+          eachRange(func, begin, end, std::index_sequence_for<Cs...>{});
+        });
+      }
+
+      /// Iterator over a view which yields a tuple of the entity id and its components
+      class Iterator {
+        private:
+          /// View we are iterating
+          View* m_View;
+          /// current index into the driving store, or into the matching archetypes
+          u32 m_Idx;
+          /// Indices of the components for the current entity
+          std::array<u32, N> m_Indices;
+
+          /// Chunk of the current archetype
+          u32 m_Chunk{0};
+          /// Row of the current chunk
+          u32 m_Row{0};
+          /// Number of entities in the current chunk
+          u32 m_Count{0};
+          /// Entities of the current chunk
+          const u32* m_Entities{nullptr};
+          /// Archetype of the current chunk
+          Archetype* m_Arch{nullptr};
+          /// Columns of the current chunk for each component
+          std::array<void*, N> m_Columns;
+
+        public:
+          Iterator(View* view, u32 idx) : m_View(view), m_Idx(idx) {
+            if (m_View->m_Archetypes) {
+              settle();
+            } else {
+              skip();
+            }
+          }
+
+          /// The entity id followed by references to each of its components
+          std::tuple<u32, Cs&...> operator*() const {
+            return deref(std::index_sequence_for<Cs...>{});
+          }
+
+          Iterator& operator++() {
+            if (m_View->m_Archetypes) {
+              // stay in the chunk if we can
+              if (++m_Row < m_Count && !m_View->m_Filtered)
+                return *this;
+              settle();
+              return *this;
+            }
+            ++m_Idx;
+            skip();
+            return *this;
+          }
+
+          bool operator==(const Iterator& other) const {
+            return m_Idx == other.m_Idx && m_Chunk == other.m_Chunk && m_Row == other.m_Row;
+          }
+          bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+        private:
+          /// Move forward until we reach an entity that has all the components
+          void skip() {
+            u32 size = m_View->m_Driver->Size();
+            while (m_Idx < size && !(m_View->match(m_Idx, m_Indices) && m_View->passes(m_Indices))) {
+              ++m_Idx;
+            }
+          }
+
+          /// Move forward until we are on a row that passes the filters, and load its chunk's columns
+          void settle() {
+            auto& matches = m_View->m_Matches;
+            while (m_Idx < matches.size()) {
+              Archetype* arch = matches[m_Idx];
+              while (m_Chunk < arch->ChunkCount()) {
+                Chunk& chunk = arch->GetChunk(m_Chunk);
+                if (m_View->chunkPasses(arch, chunk)) {
+                  while (m_Row < chunk.count && !m_View->rowPasses(arch, chunk, m_Row))
+                    ++m_Row;
+                  if (m_Row < chunk.count) {
+                    load(arch, std::index_sequence_for<Cs...>{});
+                    return;
+                  }
+                }
+                ++m_Chunk;
+                m_Row = 0;
+              }
+              // on to the next archetype
+              ++m_Idx;
+              m_Chunk = 0;
+              m_Row = 0;
+            }
+          }
+
+          template<size_t... Is>
+          void load(Archetype* arch, std::index_sequence<Is...>) {
+            Chunk& chunk = arch->GetChunk(m_Chunk);
+            m_Arch = arch;
+            m_Count = chunk.count;
+            m_Entities = arch->Entities(chunk);
+            ((m_Columns[Is] = arch->Data(chunk, arch->Column(TypeId<Cs>()))), ...);
+          }
+
+          template<size_t... Is>
+          std::tuple<u32, Cs&...> deref(std::index_sequence<Is...>) const {
+            if (m_View->m_Archetypes) {
+              m_View->touchRow(m_Arch, m_Arch->GetChunk(m_Chunk), m_Row);
+              return std::tuple<u32, Cs&...>(
+                  m_Entities[m_Row],
+                  ((Cs*) m_Columns[Is])[m_Row]...);
+            }
+            m_View->touch(m_Indices);
+            return std::tuple<u32, Cs&...>(
+                m_View->m_Driver->Entities()[m_Idx],
+                std::get<Is>(m_View->m_Stores)->Data()[m_Indices[Is]]...);
+          }
+      };
+
+      /// Iterator to the first entity in the view
+      Iterator begin() { return Iterator(this, 0); }
+      /// Iterator past the last entity in the view
+      Iterator end() {
+        return Iterator(this, m_Archetypes ? (u32) m_Matches.size() : m_Driver->Size());
+      }
+
+      /// Upper bound on the number of entities in this view
+      u32 SizeHint() const {
+        if (m_Archetypes) {
+          u32 size = 0;
+          for (Archetype* arch : m_Matches)
+            size += arch->Size();
+          return size;
+        }
+        return m_Driver->Size();
+      }
+
+    private:
+      /// Bits of a tag type or null if nobody has had it
+      template<typename T>
+      const TagStore* findTag() const {
+        u32 tid = TypeId<T>();
+        return tid < m_Tags->size() ? (*m_Tags)[tid].get() : nullptr;
+      }
+
+      /// Does an entity pass the tag filters?
+      bool tagged(u32 id) const {
+        for (const TagStore* tag : m_With) {
+          if (!tag || !tag->Has(id))
+            return false;
+        }
+        for (const TagStore* tag : m_Without) {
+          if (tag->Has(id))
+            return false;
+        }
+        return true;
+      }
+
+      /// Index of a component type in Cs, ignoring const
+      template<typename C>
+      static constexpr u32 indexOf() {
+        constexpr u32 idx = indexOf<C>(std::index_sequence_for<Cs...>{});
+        static_assert(idx < N, "Filtering on a component that isn't in the view");
+        return idx;
+      }
+
+      template<typename C, size_t... Is>
+      static constexpr u32 indexOf(std::index_sequence<Is...>) {
+        u32 idx = N;
+        ((std::is_same_v<std::remove_const_t<C>, std::remove_const_t<Cs>> ? (void) (idx = Is) : (void) 0), ...);
+        return idx;
+      }
+
+      /// Do the components at these dense indices pass the filters?
+      bool passes(const std::array<u32, N>& indices) const {
+        return passes(indices, std::index_sequence_for<Cs...>{});
+      }
+
+      template<size_t... Is>
+      bool passes(const std::array<u32, N>& indices, std::index_sequence<Is...>) const {
+        if (!m_Filtered)
+          return true;
+        return ((std::get<Is>(m_Stores)->AddedTicks()[indices[Is]] > m_AddedSince[Is]
+              && std::get<Is>(m_Stores)->ChangedTicks()[indices[Is]] > m_ChangedSince[Is]) && ...);
+      }
+
+      /// Mark the components at these dense indices that aren't const as changed
+      void touch(const std::array<u32, N>& indices) const {
+        touch(indices, std::index_sequence_for<Cs...>{});
+      }
+
+      template<size_t... Is>
+      void touch(const std::array<u32, N>& indices, std::index_sequence<Is...>) const {
+        ((std::is_const_v<Cs> ? (void) 0 : std::get<Is>(m_Stores)->touch(indices[Is])), ...);
+      }
+
+      /// Could anything in a chunk pass the filters?
+      bool chunkPasses(Archetype* arch, Chunk& chunk) const {
+        return chunkPasses(arch, chunk, std::index_sequence_for<Cs...>{});
+      }
+
+      template<size_t... Is>
+      bool chunkPasses(Archetype* arch, Chunk& chunk, std::index_sequence<Is...>) const {
+        if (!m_Filtered)
+          return true;
+        // added implies changed so the column tick covers both
+        return ((arch->ColumnTick(chunk, arch->Column(TypeId<Cs>()))
+              > std::max(m_AddedSince[Is], m_ChangedSince[Is])) && ...);
+      }
+
+      /// Does a row of a chunk pass the filters?
+      bool rowPasses(Archetype* arch, Chunk& chunk, u32 row) const {
+        return rowPasses(arch, chunk, row, std::index_sequence_for<Cs...>{});
+      }
+
+      template<size_t... Is>
+      bool rowPasses(Archetype* arch, Chunk& chunk, u32 row, std::index_sequence<Is...>) const {
+        if (!m_Filtered)
+          return true;
+        return ((arch->AddedTicks(chunk, arch->Column(TypeId<Cs>()))[row] > m_AddedSince[Is]
+              && arch->ChangedTicks(chunk, arch->Column(TypeId<Cs>()))[row] > m_ChangedSince[Is]) && ...);
+      }
+
+      /// Mark the components of a row that aren't const as changed
+      void touchRow(Archetype* arch, Chunk& chunk, u32 row) const {
+        ((std::is_const_v<Cs> ? (void) 0 : arch->Touch(chunk, arch->Column(TypeId<Cs>()), row, m_Tick)), ...);
+      }
+
+      /// Get the indices of each component for the entity at idx in the driving store
+      /// @param idx index into the driving store
+      /// @param out where to put the component indices
+      /// @return false if the entity is missing one of the components
+      bool match(u32 idx, std::array<u32, N>& out) const {
+        return match(idx, out, std::index_sequence_for<Cs...>{});
+      }
+
+      template<size_t... Is>
+      bool match(u32 idx, std::array<u32, N>& out, std::index_sequence<Is...>) const {
+        u32 id = m_Driver->Entities()[idx];
+        // the driving store already knows where its component is
+        // stop at the first store that doesn't have the entity
+        return ((out[Is] = std::get<Is>(m_Stores) == m_Driver
+              ? idx
+              : std::get<Is>(m_Stores)->index(id) - 1,
+              out[Is] != (u32) -1) && ...) && tagged(id);
+      }
+
+      /// Call a function with the entity id only if it asks for it
+      template<typename F>
+      static void call(F& func, u32 id, Cs&... comps) {
+        if constexpr (std::is_invocable_v<F, u32, Cs&...>) {
+          func(id, comps...);
+        } else {
+          func(comps...);
+        }
+      }
+
+      /// Call a function on the matching entities in part of the driving store
+      template<typename F, size_t... Is>
+      void eachRange(F& func, u32 begin, u32 end, std::index_sequence<Is...>) {
+        std::array<u32, N> indices;
+        const u32* ents = m_Driver->Entities();
+        for (u32 i = begin; i < end; ++i) {
+          if (!match(i, indices) || !passes(indices))
+            continue;
+          touch(indices);
+          call(func, ents[i], std::get<Is>(m_Stores)->Data()[indices[Is]]...);
+        }
+      }
+
+      /// Call a function on every entity in a chunk, walking each column linearly
+      template<typename F, size_t... Is>
+      void eachChunk(F& func, Chunk& chunk, Archetype* arch, std::index_sequence<Is...>) {
+        if (!chunkPasses(arch, chunk))
+          return;
+        const u32* ents = arch->Entities(chunk);
+        std::tuple<Cs*...> data((Cs*) arch->Data(chunk, arch->Column(TypeId<Cs>()))...);
+        if (!m_Filtered) {
+          for (u32 r = 0; r < chunk.count; ++r) {
+            call(func, ents[r], std::get<Is>(data)[r]...);
+          }
+          // every row was visited so mark whole columns at once
+          std::array<i32, N> cols{arch->Column(TypeId<Cs>())...};
+          ((std::is_const_v<Cs> ? (void) 0 : markColumn(arch, chunk, (u32) cols[Is])), ...);
+          return;
+        }
+        for (u32 r = 0; r < chunk.count; ++r) {
+          if (!rowPasses(arch, chunk, r))
+            continue;
+          touchRow(arch, chunk, r);
+          call(func, ents[r], std::get<Is>(data)[r]...);
+        }
+      }
+
+      /// Mark every component of a column in a chunk as changed
+      void markColumn(Archetype* arch, Chunk& chunk, u32 column) const {
+        u32* ticks = arch->ChangedTicks(chunk, column);
+        for (u32 r = 0; r < chunk.count; ++r)
+          ticks[r] = m_Tick;
+        arch->ColumnTick(chunk, column) = m_Tick;
+      }
+  };
+}
@@ -0,0 +1,177 @@
+#include "octal/math/batch.h"
+
+namespace octal {
+
+  namespace scalar {
+    void TransformPoints(const mat4& m, const f32* x, const f32* y, const f32* z,
+        f32* ox, f32* oy, f32* oz, u32 count) {
+      for (u32 i = 0; i < count; ++i) {
+        f32 px = x[i], py = y[i], pz = z[i];
+        ox[i] = m.c[0].x * px + m.c[1].x * py + m.c[2].x * pz + m.c[3].x;
+        oy[i] = m.c[0].y * px + m.c[1].y * py + m.c[2].y * pz + m.c[3].y;
+        oz[i] = m.c[0].z * px + m.c[1].z * py + m.c[2].z * pz + m.c[3].z;
+      }
+    }
+
+    void MulMatrices(const mat4* a, const mat4* b, mat4* out, u32 count) {
+      for (u32 i = 0; i < count; ++i) {
+        mat4 r;
+        for (u32 col = 0; col < 4; ++col) {
+          const vec4& v = b[i].c[col];
+          r.c[col] = a[i].c[0] * v.x + a[i].c[1] * v.y + a[i].c[2] * v.z + a[i].c[3] * v.w;
+        }
+        out[i] = r;
+      }
+    }
+
+    void CullAABBs(const Frustum& f, const AABB8* boxes, u8* masks, u32 groups) {
+      for (u32 g = 0; g < groups; ++g) {
+        const AABB8& b = boxes[g];
+        u8 mask = 0;
+        for (u32 lane = 0; lane < 8; ++lane) {
+          AABB box{{b.minx[lane], b.miny[lane], b.minz[lane]}, {b.maxx[lane], b.maxy[lane], b.maxz[lane]}};
+          if (f.Intersects(box))
+            mask |= 1 << lane;
+        }
+        masks[g] = mask;
+      }
+    }
+  }
+
+#if MATH_AVX2
+  void TransformPoints(const mat4& m, const f32* x, const f32* y, const f32* z,
+      f32* ox, f32* oy, f32* oz, u32 count) {
+    // one register per matrix element so each row is three fmas
+    __m256 m00 = _mm256_set1_ps(m.c[0].x), m01 = _mm256_set1_ps(m.c[1].x), m02 = _mm256_set1_ps(m.c[2].x), m03 = _mm256_set1_ps(m.c[3].x);
+    __m256 m10 = _mm256_set1_ps(m.c[0].y), m11 = _mm256_set1_ps(m.c[1].y), m12 = _mm256_set1_ps(m.c[2].y), m13 = _mm256_set1_ps(m.c[3].y);
+    __m256 m20 = _mm256_set1_ps(m.c[0].z), m21 = _mm256_set1_ps(m.c[1].z), m22 = _mm256_set1_ps(m.c[2].z), m23 = _mm256_set1_ps(m.c[3].z);
+    u32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m256 px = _mm256_loadu_ps(x + i);
+      __m256 py = _mm256_loadu_ps(y + i);
+      __m256 pz = _mm256_loadu_ps(z + i);
+      _mm256_storeu_ps(ox + i, _mm256_fmadd_ps(m00, px, _mm256_fmadd_ps(m01, py, _mm256_fmadd_ps(m02, pz, m03))));
+      _mm256_storeu_ps(oy + i, _mm256_fmadd_ps(m10, px, _mm256_fmadd_ps(m11, py, _mm256_fmadd_ps(m12, pz, m13))));
+      _mm256_storeu_ps(oz + i, _mm256_fmadd_ps(m20, px, _mm256_fmadd_ps(m21, py, _mm256_fmadd_ps(m22, pz, m23))));
+    }
+    scalar::TransformPoints(m, x + i, y + i, z + i, ox + i, oy + i, oz + i, count - i);
+  }
+#elif MATH_SSE
+  void TransformPoints(const mat4& m, const f32* x, const f32* y, const f32* z,
+      f32* ox, f32* oy, f32* oz, u32 count) {
+    __m128 m00 = _mm_set1_ps(m.c[0].x), m01 = _mm_set1_ps(m.c[1].x), m02 = _mm_set1_ps(m.c[2].x), m03 = _mm_set1_ps(m.c[3].x);
+    __m128 m10 = _mm_set1_ps(m.c[0].y), m11 = _mm_set1_ps(m.c[1].y), m12 = _mm_set1_ps(m.c[2].y), m13 = _mm_set1_ps(m.c[3].y);
+    __m128 m20 = _mm_set1_ps(m.c[0].z), m21 = _mm_set1_ps(m.c[1].z), m22 = _mm_set1_ps(m.c[2].z), m23 = _mm_set1_ps(m.c[3].z);
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128 px = _mm_loadu_ps(x + i);
+      __m128 py = _mm_loadu_ps(y + i);
+      __m128 pz = _mm_loadu_ps(z + i);
+      _mm_storeu_ps(ox + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py)), _mm_add_ps(_mm_mul_ps(m02, pz), m03)));
+      _mm_storeu_ps(oy + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m12, pz), m13)));
+      _mm_storeu_ps(oz + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, px), _mm_mul_ps(m21, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m23)));
+    }
+    scalar::TransformPoints(m, x + i, y + i, z + i, ox + i, oy + i, oz + i, count - i);
+  }
+#else
+  void TransformPoints(const mat4& m, const f32* x, const f32* y, const f32* z,
+      f32* ox, f32* oy, f32* oz, u32 count) {
+    scalar::TransformPoints(m, x, y, z, ox, oy, oz, count);
+  }
+#endif
+
+#if MATH_AVX2
+  void MulMatrices(const mat4* a, const mat4* b, mat4* out, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+      // every column of a in both halves so two columns of the result come out at once
+      __m256 a0 = _mm256_broadcast_ps((const __m128*) &a[i].c[0].x);
+      __m256 a1 = _mm256_broadcast_ps((const __m128*) &a[i].c[1].x);
+      __m256 a2 = _mm256_broadcast_ps((const __m128*) &a[i].c[2].x);
+      __m256 a3 = _mm256_broadcast_ps((const __m128*) &a[i].c[3].x);
+      __m256 b01 = _mm256_loadu_ps(&b[i].c[0].x);
+      __m256 b23 = _mm256_loadu_ps(&b[i].c[2].x);
+      // each component of a column of b spread across its half
+      __m256 r01 = _mm256_fmadd_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00),
+          _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55),
+            _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, 0xaa),
+              _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, 0xff)))));
+      __m256 r23 = _mm256_fmadd_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00),
+          _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55),
+            _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, 0xaa),
+              _mm256_mul_ps(a3, _mm256_shuffle_ps(b23, b23, 0xff)))));
+      // only store once everything is read in case out aliases the inputs
+      _mm256_storeu_ps(&out[i].c[0].x, r01);
+      _mm256_storeu_ps(&out[i].c[2].x, r23);
+    }
+  }
+#elif MATH_SSE
+  void MulMatrices(const mat4* a, const mat4* b, mat4* out, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+      __m128 a0 = _mm_load_ps(&a[i].c[0].x);
+      __m128 a1 = _mm_load_ps(&a[i].c[1].x);
+      __m128 a2 = _mm_load_ps(&a[i].c[2].x);
+      __m128 a3 = _mm_load_ps(&a[i].c[3].x);
+      __m128 r[4];
+      for (u32 col = 0; col < 4; ++col) {
+        const vec4& v = b[i].c[col];
+        r[col] = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(v.x)), _mm_mul_ps(a1, _mm_set1_ps(v.y))),
+            _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(v.z)), _mm_mul_ps(a3, _mm_set1_ps(v.w))));
+      }
+      // only store once everything is read in case out aliases the inputs
+      for (u32 col = 0; col < 4; ++col)
+        _mm_store_ps(&out[i].c[col].x, r[col]);
+    }
+  }
+#else
+  void MulMatrices(const mat4* a, const mat4* b, mat4* out, u32 count) {
+    scalar::MulMatrices(a, b, out, count);
+  }
+#endif
+
+#if MATH_AVX2
+  void CullAABBs(const Frustum& f, const AABB8* boxes, u8* masks, u32 groups) {
+    for (u32 g = 0; g < groups; ++g) {
+      const AABB8& b = boxes[g];
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (const Plane& pl : f.planes) {
+        // the sign of the normal picks the corner furthest along it for every lane at once
+        __m256 px = _mm256_load_ps(pl.normal.x > 0 ? b.maxx : b.minx);
+        __m256 py = _mm256_load_ps(pl.normal.y > 0 ? b.maxy : b.miny);
+        __m256 pz = _mm256_load_ps(pl.normal.z > 0 ? b.maxz : b.minz);
+        __m256 dist = _mm256_fmadd_ps(_mm256_set1_ps(pl.normal.x), px,
+            _mm256_fmadd_ps(_mm256_set1_ps(pl.normal.y), py,
+              _mm256_fmadd_ps(_mm256_set1_ps(pl.normal.z), pz, _mm256_set1_ps(pl.d))));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+      }
+      masks[g] = (u8) _mm256_movemask_ps(inside);
+    }
+  }
+#elif MATH_SSE
+  void CullAABBs(const Frustum& f, const AABB8* boxes, u8* masks, u32 groups) {
+    for (u32 g = 0; g < groups; ++g) {
+      const AABB8& b = boxes[g];
+      u8 mask = 0;
+      // two halves of four lanes
+      for (u32 h = 0; h < 8; h += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const Plane& pl : f.planes) {
+          __m128 px = _mm_load_ps((pl.normal.x > 0 ? b.maxx : b.minx) + h);
+          __m128 py = _mm_load_ps((pl.normal.y > 0 ? b.maxy : b.miny) + h);
+          __m128 pz = _mm_load_ps((pl.normal.z > 0 ? b.maxz : b.minz) + h);
+          __m128 dist = _mm_add_ps(
+              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pl.normal.x), px), _mm_mul_ps(_mm_set1_ps(pl.normal.y), py)),
+              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pl.normal.z), pz), _mm_set1_ps(pl.d)));
+          inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+        }
+        mask |= (u8) (_mm_movemask_ps(inside) << h);
+      }
+      masks[g] = mask;
+    }
+  }
+#else
+  void CullAABBs(const Frustum& f, const AABB8* boxes, u8* masks, u32 groups) {
+    scalar::CullAABBs(f, boxes, masks, groups);
+  }
+#endif
+}
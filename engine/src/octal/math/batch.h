@@ -0,0 +1,56 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/math/math.h"
+
+namespace octal {
+
+  // Kernels that work on whole arrays at once. Each one uses AVX2 when the
+  // engine is built with it, SSE otherwise, and has a scalar version in
+  // octal::scalar for comparison. The results are equal within rounding,
+  // not bit for bit: the AVX2 kernels fuse multiply-adds and the SIMD ones
+  // sum in a different order, so a box exactly on a plane may cull
+  // differently.
+
+  /// Transform points stored as separate arrays of each component
+  /// The output may alias the input.
+  /// @param m the matrix to transform by, points have an implicit w of 1
+  /// @param x, y, z components of the points
+  /// @param ox, oy, oz where to write the transformed components
+  /// @param count number of points
+  API void TransformPoints(const mat4& m, const f32* x, const f32* y, const f32* z,
+      f32* ox, f32* oy, f32* oz, u32 count);
+
+  /// Multiply arrays of matrices, out[i] = a[i] * b[i]
+  /// @param a left hand matrices
+  /// @param b right hand matrices
+  /// @param out where to write the results, may alias a or b
+  /// @param count number of matrices
+  API void MulMatrices(const mat4* a, const mat4* b, mat4* out, u32 count);
+
+  /// Test groups of eight boxes against a frustum
+  /// @param f the frustum
+  /// @param boxes groups of eight boxes
+  /// @param masks set to a mask per group with bit i set if box i is at least partly inside
+  /// @param groups number of groups
+  API void CullAABBs(const Frustum& f, const AABB8* boxes, u8* masks, u32 groups);
+
+  /// Test eight boxes against a frustum
+  /// @return a mask with bit i set if box i is at least partly inside
+  inline u8 CullAABB8(const Frustum& f, const AABB8& boxes) {
+    u8 mask;
+    CullAABBs(f, &boxes, &mask, 1);
+    return mask;
+  }
+
+  namespace scalar {
+    /// Scalar version of octal::TransformPoints
+    API void TransformPoints(const mat4& m, const f32* x, const f32* y, const f32* z,
+        f32* ox, f32* oy, f32* oz, u32 count);
+
+    /// Scalar version of octal::MulMatrices
+    API void MulMatrices(const mat4* a, const mat4* b, mat4* out, u32 count);
+
+    /// Scalar version of octal::CullAABBs
+    API void CullAABBs(const Frustum& f, const AABB8* boxes, u8* masks, u32 groups);
+  }
+}
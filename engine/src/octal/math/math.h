@@ -0,0 +1,390 @@
+#pragma once
+#include "octal/defines.h"
+#include <cmath>
+#include <utility>
+#include <type_traits>
+
+// SIMD paths are picked from what the compiler is allowed to use.
+// Define MATH_SCALAR to force the scalar fallback everywhere.
+#if !defined(MATH_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define MATH_SSE 1
+#include <immintrin.h>
+#endif
+#if defined(MATH_SSE) && defined(__AVX2__) && defined(__FMA__)
+#define MATH_AVX2 1
+#endif
+
+namespace octal {
+
+  /// 3 component vector
+  struct vec3 {
+    f32 x{0}, y{0}, z{0};
+
+    constexpr vec3() = default;
+    constexpr vec3(f32 x, f32 y, f32 z) : x(x), y(y), z(z) {}
+    /// Same value in every component
+    constexpr explicit vec3(f32 v) : x(v), y(v), z(v) {}
+
+    constexpr vec3 operator+(const vec3& o) const { return {x + o.x, y + o.y, z + o.z}; }
+    constexpr vec3 operator-(const vec3& o) const { return {x - o.x, y - o.y, z - o.z}; }
+    constexpr vec3 operator*(const vec3& o) const { return {x * o.x, y * o.y, z * o.z}; }
+    constexpr vec3 operator*(f32 s) const { return {x * s, y * s, z * s}; }
+    constexpr vec3 operator-() const { return {-x, -y, -z}; }
+    constexpr bool operator==(const vec3& o) const = default;
+
+    /// Component by index
+    constexpr f32 operator[](u32 i) const {
+      return i == 0 ? x : i == 1 ? y : z;
+    }
+  };
+
+  /// 4 component vector
+  struct alignas(16) vec4 {
+    f32 x{0}, y{0}, z{0}, w{0};
+
+    constexpr vec4() = default;
+    constexpr vec4(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+    constexpr vec4(const vec3& v, f32 w) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+    constexpr vec4 operator+(const vec4& o) const {
+#if MATH_SSE
+      if (!std::is_constant_evaluated())
+        return from(_mm_add_ps(_mm_load_ps(&x), _mm_load_ps(&o.x)));
+#endif
+      return {x + o.x, y + o.y, z + o.z, w + o.w};
+    }
+    constexpr vec4 operator-(const vec4& o) const {
+#if MATH_SSE
+      if (!std::is_constant_evaluated())
+        return from(_mm_sub_ps(_mm_load_ps(&x), _mm_load_ps(&o.x)));
+#endif
+      return {x - o.x, y - o.y, z - o.z, w - o.w};
+    }
+    constexpr vec4 operator*(f32 s) const {
+#if MATH_SSE
+      if (!std::is_constant_evaluated())
+        return from(_mm_mul_ps(_mm_load_ps(&x), _mm_set1_ps(s)));
+#endif
+      return {x * s, y * s, z * s, w * s};
+    }
+    constexpr bool operator==(const vec4& o) const = default;
+
+    /// The first three components
+    constexpr vec3 xyz() const { return {x, y, z}; }
+
+    /// Component by index
+    constexpr f32 operator[](u32 i) const {
+      return i == 0 ? x : i == 1 ? y : i == 2 ? z : w;
+    }
+
+#if MATH_SSE
+  private:
+    static vec4 from(__m128 v) {
+      vec4 r;
+      _mm_store_ps(&r.x, v);
+      return r;
+    }
+#endif
+  };
+
+  /// Rotation as a unit quaternion
+  struct alignas(16) quat {
+    f32 x{0}, y{0}, z{0}, w{1};
+
+    constexpr quat() = default;
+    constexpr quat(f32 x, f32 y, f32 z, f32 w) : x(x), y(y), z(z), w(w) {}
+
+    /// Combine two rotations, o is applied first
+    constexpr quat operator*(const quat& o) const {
+#if MATH_SSE
+      if (!std::is_constant_evaluated()) {
+        // o scaled by each component of this, the other three shuffled and
+        // negated so every lane lines up with the terms written out below
+        __m128 q = _mm_load_ps(&o.x);
+        __m128 r = _mm_mul_ps(_mm_set1_ps(w), q);
+        __m128 t = _mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 1, 2, 3));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(x), _mm_xor_ps(t, _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f))));
+        t = _mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 3, 2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(y), _mm_xor_ps(t, _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f))));
+        t = _mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 3, 0, 1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(z), _mm_xor_ps(t, _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f))));
+        quat out;
+        _mm_store_ps(&out.x, r);
+        return out;
+      }
+#endif
+      return {
+        w * o.x + x * o.w + y * o.z - z * o.y,
+        w * o.y - x * o.z + y * o.w + z * o.x,
+        w * o.z + x * o.y - y * o.x + z * o.w,
+        w * o.w - x * o.x - y * o.y - z * o.z,
+      };
+    }
+    constexpr bool operator==(const quat& o) const = default;
+  };
+
+  constexpr f32 Dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+  constexpr f32 Dot(const vec4& a, const vec4& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+  constexpr vec3 Cross(const vec3& a, const vec3& b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+  }
+
+  /// 4x4 column major matrix
+  struct alignas(16) mat4 {
+    /// Columns of the matrix
+    vec4 c[4]{
+      {1, 0, 0, 0},
+      {0, 1, 0, 0},
+      {0, 0, 1, 0},
+      {0, 0, 0, 1},
+    };
+
+    /// Identity matrix
+    constexpr mat4() = default;
+    constexpr mat4(const vec4& c0, const vec4& c1, const vec4& c2, const vec4& c3) : c{c0, c1, c2, c3} {}
+
+    /// Transform a vector
+    constexpr vec4 operator*(const vec4& v) const {
+#if MATH_SSE
+      if (!std::is_constant_evaluated()) {
+        vec4 r;
+        _mm_store_ps(&r.x, mul(v));
+        return r;
+      }
+#endif
+      return c[0] * v.x + c[1] * v.y + c[2] * v.z + c[3] * v.w;
+    }
+
+    /// Combine two transforms, o is applied first
+    constexpr mat4 operator*(const mat4& o) const {
+#if MATH_SSE
+      if (!std::is_constant_evaluated()) {
+        mat4 r;
+        for (u32 i = 0; i < 4; ++i)
+          _mm_store_ps(&r.c[i].x, mul(o.c[i]));
+        return r;
+      }
+#endif
+      return {(*this) * o.c[0], (*this) * o.c[1], (*this) * o.c[2], (*this) * o.c[3]};
+    }
+    constexpr bool operator==(const mat4& o) const = default;
+
+#if MATH_SSE
+  private:
+    /// Columns scaled by each component of v and summed
+    __m128 mul(const vec4& v) const {
+      __m128 r = _mm_mul_ps(_mm_load_ps(&c[0].x), _mm_set1_ps(v.x));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&c[1].x), _mm_set1_ps(v.y)));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&c[2].x), _mm_set1_ps(v.z)));
+      return _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&c[3].x), _mm_set1_ps(v.w)));
+    }
+#endif
+  };
+
+  /// Axis aligned bounding box
+  struct AABB {
+    vec3 min;
+    vec3 max;
+
+    /// Is a point inside the box?
+    constexpr bool Contains(const vec3& p) const {
+      return p.x >= min.x && p.y >= min.y && p.z >= min.z
+        && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+    }
+
+    /// Do two boxes overlap?
+    constexpr bool Overlaps(const AABB& o) const {
+      return min.x <= o.max.x && min.y <= o.max.y && min.z <= o.max.z
+        && max.x >= o.min.x && max.y >= o.min.y && max.z >= o.min.z;
+    }
+
+    /// Is another box completely inside this one?
+    constexpr bool Contains(const AABB& o) const {
+      return o.min.x >= min.x && o.min.y >= min.y && o.min.z >= min.z
+        && o.max.x <= max.x && o.max.y <= max.y && o.max.z <= max.z;
+    }
+
+    constexpr vec3 Center() const { return (min + max) * 0.5f; }
+
+    /// Half the size of the box along each axis
+    constexpr vec3 Extents() const { return (max - min) * 0.5f; }
+
+    /// Half the surface area, enough to compare boxes by
+    constexpr f32 HalfArea() const {
+      vec3 d = max - min;
+      return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    /// Grow the box in every direction
+    constexpr AABB Expanded(f32 margin) const {
+      return {min - vec3(margin), max + vec3(margin)};
+    }
+
+    /// Squared distance from a point to the closest point of the box, 0 inside
+    constexpr f32 DistanceSq(const vec3& p) const {
+      f32 dx = p.x < min.x ? min.x - p.x : p.x > max.x ? p.x - max.x : 0;
+      f32 dy = p.y < min.y ? min.y - p.y : p.y > max.y ? p.y - max.y : 0;
+      f32 dz = p.z < min.z ? min.z - p.z : p.z > max.z ? p.z - max.z : 0;
+      return dx * dx + dy * dy + dz * dz;
+    }
+
+    /// Smallest box around two boxes
+    static constexpr AABB Merge(const AABB& a, const AABB& b) {
+      return {
+        {a.min.x < b.min.x ? a.min.x : b.min.x, a.min.y < b.min.y ? a.min.y : b.min.y, a.min.z < b.min.z ? a.min.z : b.min.z},
+        {a.max.x > b.max.x ? a.max.x : b.max.x, a.max.y > b.max.y ? a.max.y : b.max.y, a.max.z > b.max.z ? a.max.z : b.max.z},
+      };
+    }
+  };
+
+  /// Half line from an origin along a direction
+  struct Ray {
+    vec3 origin;
+    /// Doesn't have to be normalized, distances along the ray are in multiples of it
+    vec3 dir;
+    /// Distances past this are ignored
+    f32 length{INFINITY};
+
+    /// Where along the ray it enters a box
+    /// @param box to test
+    /// @param t set to the entry distance, 0 if the origin is inside
+    /// @return false if the ray misses the box within its length
+    bool Intersects(const AABB& box, f32& t) const {
+      f32 exit;
+      return Intersects(box, t, exit);
+    }
+
+    /// Where along the ray it enters and leaves a box
+    /// @param box to test
+    /// @param enter set to the entry distance, 0 if the origin is inside
+    /// @param exit set to the exit distance, at most the ray's length
+    /// @return false if the ray misses the box within its length
+    bool Intersects(const AABB& box, f32& enter, f32& exit) const {
+      f32 tmin = 0, tmax = length;
+      for (u32 a = 0; a < 3; ++a) {
+        f32 o = origin[a], d = dir[a], lo = box.min[a], hi = box.max[a];
+        if (d == 0) {
+          // parallel to the slab so it has to start inside it
+          if (o < lo || o > hi)
+            return false;
+          continue;
+        }
+        f32 inv = 1.0f / d;
+        f32 t0 = (lo - o) * inv, t1 = (hi - o) * inv;
+        if (t0 > t1)
+          std::swap(t0, t1);
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+        if (tmin > tmax)
+          return false;
+      }
+      enter = tmin;
+      exit = tmax;
+      return true;
+    }
+
+    /// Point at a distance along the ray
+    constexpr vec3 At(f32 t) const { return origin + dir * t; }
+  };
+
+  /// Eight boxes stored as separate arrays of each component so they can be tested at once
+  struct alignas(32) AABB8 {
+    f32 minx[8], miny[8], minz[8];
+    f32 maxx[8], maxy[8], maxz[8];
+
+    /// Store a box in a lane
+    constexpr void Set(u32 lane, const AABB& box) {
+      minx[lane] = box.min.x; miny[lane] = box.min.y; minz[lane] = box.min.z;
+      maxx[lane] = box.max.x; maxy[lane] = box.max.y; maxz[lane] = box.max.z;
+    }
+  };
+
+  /// Plane where points p with Dot(normal, p) + d >= 0 are in front
+  struct Plane {
+    vec3 normal;
+    f32 d{0};
+  };
+
+  /// The six planes bounding what a camera can see, normals point inwards
+  struct Frustum {
+    /// Left, right, bottom, top, near, far
+    Plane planes[6];
+
+    /// Extract the planes of a view projection matrix with 0 to 1 depth
+    /// @param vp the view projection matrix
+    static constexpr Frustum FromMatrix(const mat4& vp) {
+      // rows of the matrix
+      vec4 r[4];
+      for (u32 i = 0; i < 4; ++i)
+        r[i] = {vp.c[0][i], vp.c[1][i], vp.c[2][i], vp.c[3][i]};
+      vec4 p[6] = {r[3] + r[0], r[3] - r[0], r[3] + r[1], r[3] - r[1], r[2], r[3] - r[2]};
+      Frustum f;
+      for (u32 i = 0; i < 6; ++i)
+        f.planes[i] = {p[i].xyz(), p[i].w};
+      return f;
+    }
+
+    /// Is any part of a box in front of every plane?
+    constexpr bool Intersects(const AABB& box) const {
+      for (const Plane& pl : planes) {
+        // the corner furthest along the normal
+        vec3 v{pl.normal.x > 0 ? box.max.x : box.min.x,
+          pl.normal.y > 0 ? box.max.y : box.min.y,
+          pl.normal.z > 0 ? box.max.z : box.min.z};
+        if (Dot(pl.normal, v) + pl.d < 0)
+          return false;
+      }
+      return true;
+    }
+  };
+
+  inline f32 Length(const vec3& v) { return std::sqrt(Dot(v, v)); }
+
+  inline vec3 Normalize(const vec3& v) { return v * (1.0f / Length(v)); }
+
+  /// Rotation around an axis
+  /// @param axis to rotate around, must be normalized
+  /// @param angle in radians
+  inline quat AxisAngle(const vec3& axis, f32 angle) {
+    f32 s = std::sin(angle * 0.5f);
+    return {axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f)};
+  }
+
+  /// Translation matrix
+  constexpr mat4 Translate(const vec3& t) {
+    return {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {t, 1}};
+  }
+
+  /// Box around a transformed box
+  /// @param m the transform
+  /// @param box to transform
+  constexpr AABB TransformBox(const mat4& m, const AABB& box) {
+    vec3 c = box.Center(), e = box.Extents();
+    vec4 wc = m * vec4(c, 1);
+    // each world extent is the sum of the absolute matrix entries scaled by the local extents
+    auto abs = [](f32 v) { return v < 0 ? -v : v; };
+    vec3 we{
+      abs(m.c[0].x) * e.x + abs(m.c[1].x) * e.y + abs(m.c[2].x) * e.z,
+      abs(m.c[0].y) * e.x + abs(m.c[1].y) * e.y + abs(m.c[2].y) * e.z,
+      abs(m.c[0].z) * e.x + abs(m.c[1].z) * e.y + abs(m.c[2].z) * e.z,
+    };
+    return {wc.xyz() - we, wc.xyz() + we};
+  }
+
+  /// Build a matrix that scales, then rotates, then translates
+  /// @param t translation
+  /// @param r rotation, must be normalized
+  /// @param s scale
+  constexpr mat4 Compose(const vec3& t, const quat& r, const vec3& s) {
+    f32 xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+    f32 xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+    f32 wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+    return {
+      vec4(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0) * s.x,
+      vec4(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0) * s.y,
+      vec4(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0) * s.z,
+      vec4(t, 1),
+    };
+  }
+}
@@ -0,0 +1,361 @@
+#include "octal/spatial/bvh.h"
+#include "octal/core/jobs.h"
+#include <algorithm>
+#include <atomic>
+
+namespace octal {
+
+  DynamicBVH::DynamicBVH(f32 margin) : m_Margin(margin) {}
+
+  u32 DynamicBVH::allocate() {
+    if (m_Free != NONE) {
+      u32 node = m_Free;
+      m_Free = m_Nodes[node].parent;
+      return node;
+    }
+    m_Nodes.emplace_back();
+    return (u32) m_Nodes.size() - 1;
+  }
+
+  void DynamicBVH::release(u32 node) {
+    m_Nodes[node].parent = m_Free;
+    m_Nodes[node].left = m_Nodes[node].right = NONE;
+    m_Free = node;
+  }
+
+  void DynamicBVH::refit(u32 node) {
+    while (node != NONE) {
+      Node& n = m_Nodes[node];
+      n.box = AABB::Merge(m_Nodes[n.left].box, m_Nodes[n.right].box);
+      node = n.parent;
+    }
+  }
+
+  void DynamicBVH::insertLeaf(u32 leaf) {
+    if (m_Root == NONE) {
+      m_Root = leaf;
+      m_Nodes[leaf].parent = NONE;
+      return;
+    }
+
+    // walk down while splitting a child is cheaper than making a new parent here
+    AABB box = m_Nodes[leaf].box;
+    u32 sibling = m_Root;
+    while (!m_Nodes[sibling].IsLeaf()) {
+      const Node& n = m_Nodes[sibling];
+      f32 combined = AABB::Merge(n.box, box).HalfArea();
+      f32 cost = 2 * combined;
+      // every node above the new leaf grows by the same amount
+      f32 inherited = 2 * (combined - n.box.HalfArea());
+      auto descend = [&](u32 child) {
+        const Node& c = m_Nodes[child];
+        f32 merged = AABB::Merge(c.box, box).HalfArea();
+        return (c.IsLeaf() ? merged : merged - c.box.HalfArea()) + inherited;
+      };
+      f32 left = descend(n.left), right = descend(n.right);
+      if (cost < left && cost < right)
+        break;
+      sibling = left < right ? n.left : n.right;
+    }
+
+    u32 old_parent = m_Nodes[sibling].parent;
+    u32 parent = allocate();
+    Node& p = m_Nodes[parent];
+    p.box = AABB::Merge(box, m_Nodes[sibling].box);
+    p.parent = old_parent;
+    p.left = sibling;
+    p.right = leaf;
+    p.id = 0;
+    if (old_parent == NONE) {
+      m_Root = parent;
+    } else if (m_Nodes[old_parent].left == sibling) {
+      m_Nodes[old_parent].left = parent;
+    } else {
+      m_Nodes[old_parent].right = parent;
+    }
+    m_Nodes[sibling].parent = parent;
+    m_Nodes[leaf].parent = parent;
+    refit(old_parent);
+  }
+
+  void DynamicBVH::removeLeaf(u32 leaf) {
+    if (leaf == m_Root) {
+      m_Root = NONE;
+      return;
+    }
+    u32 parent = m_Nodes[leaf].parent;
+    u32 grand = m_Nodes[parent].parent;
+    u32 sibling = m_Nodes[parent].left == leaf ? m_Nodes[parent].right : m_Nodes[parent].left;
+    // the sibling takes the parent's place
+    m_Nodes[sibling].parent = grand;
+    if (grand == NONE) {
+      m_Root = sibling;
+    } else if (m_Nodes[grand].left == parent) {
+      m_Nodes[grand].left = sibling;
+    } else {
+      m_Nodes[grand].right = sibling;
+    }
+    release(parent);
+    refit(grand);
+  }
+
+  void DynamicBVH::Update(u32 id, const AABB& box) {
+    u32 leaf = handle(id);
+    if (leaf == NONE) {
+      leaf = allocate();
+      m_Nodes[leaf] = {box.Expanded(m_Margin), box, NONE, NONE, NONE, id};
+      setHandle(id, leaf);
+      insertLeaf(leaf);
+      ++m_Count;
+      return;
+    }
+    m_Nodes[leaf].tight = box;
+    // small moves stay inside the grown box
+    if (m_Nodes[leaf].box.Contains(box))
+      return;
+    removeLeaf(leaf);
+    m_Nodes[leaf].box = box.Expanded(m_Margin);
+    insertLeaf(leaf);
+  }
+
+  void DynamicBVH::Remove(u32 id) {
+    u32 leaf = handle(id);
+    if (leaf == NONE)
+      return;
+    removeLeaf(leaf);
+    release(leaf);
+    clearHandle(id);
+    --m_Count;
+  }
+
+  void DynamicBVH::Clear() {
+    m_Nodes.clear();
+    m_Root = NONE;
+    m_Free = NONE;
+    m_Count = 0;
+    clearHandles();
+  }
+
+  /// Spread the low 10 bits of a value out to every third bit
+  static u32 expandBits(u32 v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+  }
+
+  void DynamicBVH::Build(const u32* ids, const AABB* boxes, u32 count) {
+    Clear();
+    if (count == 0)
+      return;
+    m_Count = count;
+    // internal nodes first, then the leaves in Morton order
+    u32 first_leaf = count - 1;
+    m_Nodes.resize(2 * count - 1);
+
+    AABB centers{vec3(INFINITY), vec3(-INFINITY)};
+    for (u32 i = 0; i < count; ++i) {
+      vec3 c = boxes[i].Center();
+      centers = AABB::Merge(centers, {c, c});
+    }
+    vec3 size = centers.max - centers.min;
+    vec3 scale{size.x > 0 ? 1023 / size.x : 0, size.y > 0 ? 1023 / size.y : 0, size.z > 0 ? 1023 / size.z : 0};
+
+    // Morton code of each box center along with its index
+    std::vector<std::pair<u32, u32>> codes(count);
+    JobSystem::ParallelFor(count, 4096, [&](u32 begin, u32 end) {
+      for (u32 i = begin; i < end; ++i) {
+        vec3 p = (boxes[i].Center() - centers.min) * scale;
+        codes[i] = {expandBits((u32) p.x) * 4 + expandBits((u32) p.y) * 2 + expandBits((u32) p.z), i};
+      }
+    });
+    std::sort(codes.begin(), codes.end());
+
+    JobSystem::ParallelFor(count, 4096, [&](u32 begin, u32 end) {
+      for (u32 k = begin; k < end; ++k) {
+        u32 i = codes[k].second;
+        m_Nodes[first_leaf + k] = {boxes[i].Expanded(m_Margin), boxes[i], NONE, NONE, NONE, ids[i]};
+      }
+    });
+    for (u32 k = 0; k < count; ++k) {
+      setHandle(ids[codes[k].second], first_leaf + k);
+    }
+    if (count == 1) {
+      m_Root = 0;
+      return;
+    }
+
+    // length of the common prefix of two codes, ties broken by position
+    auto delta = [&](i64 i, i64 j) -> i32 {
+      if (j < 0 || j >= count)
+        return -1;
+      u32 a = codes[i].first, b = codes[j].first;
+      if (a == b)
+        return 32 + __builtin_clz((u32) i ^ (u32) j);
+      return __builtin_clz(a ^ b);
+    };
+
+    // every internal node finds its own range and split (Karras 2012)
+    JobSystem::ParallelFor(count - 1, 1024, [&](u32 begin, u32 end) {
+      for (i64 i = begin; i < end; ++i) {
+        i64 d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+        i32 min_prefix = delta(i, i - d);
+        i64 max_len = 2;
+        while (delta(i, i + max_len * d) > min_prefix)
+          max_len *= 2;
+        i64 len = 0;
+        for (i64 t = max_len / 2; t >= 1; t /= 2) {
+          if (delta(i, i + (len + t) * d) > min_prefix)
+            len += t;
+        }
+        i64 j = i + len * d;
+        i32 node_prefix = delta(i, j);
+        i64 split = 0, step = len;
+        do {
+          step = (step + 1) >> 1;
+          if (delta(i, i + (split + step) * d) > node_prefix)
+            split += step;
+        } while (step > 1);
+        i64 gamma = i + split * d + std::min<i64>(d, 0);
+
+        Node& n = m_Nodes[i];
+        n.left = (u32) (std::min(i, j) == gamma ? first_leaf + gamma : gamma);
+        n.right = (u32) (std::max(i, j) == gamma + 1 ? first_leaf + gamma + 1 : gamma + 1);
+        n.id = 0;
+        m_Nodes[n.left].parent = (u32) i;
+        m_Nodes[n.right].parent = (u32) i;
+      }
+    });
+    m_Nodes[0].parent = NONE;
+
+    // boxes go up from the leaves, the second child to arrive at a node computes it
+    std::vector<std::atomic<u32>> arrived(count - 1);
+    JobSystem::ParallelFor(count, 4096, [&](u32 begin, u32 end) {
+      for (u32 k = begin; k < end; ++k) {
+        u32 node = m_Nodes[first_leaf + k].parent;
+        while (node != NONE) {
+          if (arrived[node].fetch_add(1, std::memory_order_acq_rel) == 0)
+            break;
+          Node& n = m_Nodes[node];
+          n.box = AABB::Merge(m_Nodes[n.left].box, m_Nodes[n.right].box);
+          node = n.parent;
+        }
+      }
+    });
+    m_Root = 0;
+  }
+
+  void DynamicBVH::Query(const AABB& box, std::vector<u32>& out) const {
+    if (m_Root == NONE)
+      return;
+    thread_local std::vector<u32> stack;
+    stack.clear();
+    stack.push_back(m_Root);
+    while (!stack.empty()) {
+      const Node& n = m_Nodes[stack.back()];
+      stack.pop_back();
+      if (!n.box.Overlaps(box))
+        continue;
+      if (n.IsLeaf()) {
+        if (n.tight.Overlaps(box))
+          out.push_back(n.id);
+        continue;
+      }
+      stack.push_back(n.left);
+      stack.push_back(n.right);
+    }
+  }
+
+  RayHit DynamicBVH::Raycast(const Ray& ray) const {
+    RayHit hit;
+    f32 t;
+    if (m_Root == NONE || !ray.Intersects(m_Nodes[m_Root].box, t))
+      return hit;
+    thread_local std::vector<std::pair<f32, u32>> stack;
+    stack.clear();
+    stack.push_back({t, m_Root});
+    while (!stack.empty()) {
+      auto [enter, node] = stack.back();
+      stack.pop_back();
+      // something closer was hit since this was pushed
+      if (enter > hit.t)
+        continue;
+      const Node& n = m_Nodes[node];
+      if (n.IsLeaf()) {
+        if (ray.Intersects(n.tight, t) && t < hit.t)
+          hit = {n.id, t};
+        continue;
+      }
+      f32 tl, tr;
+      bool l = ray.Intersects(m_Nodes[n.left].box, tl) && tl <= hit.t;
+      bool r = ray.Intersects(m_Nodes[n.right].box, tr) && tr <= hit.t;
+      // the nearer child goes on top
+      if (l && r && tl < tr) {
+        stack.push_back({tr, n.right});
+        stack.push_back({tl, n.left});
+      } else {
+        if (l)
+          stack.push_back({tl, n.left});
+        if (r)
+          stack.push_back({tr, n.right});
+      }
+    }
+    return hit;
+  }
+
+  void DynamicBVH::Nearest(const vec3& point, u32 k, std::vector<u32>& out) const {
+    u32 want = std::min(k, m_Count);
+    if (want == 0)
+      return;
+    // nodes by distance, leaves are pushed a second time with their exact box
+    struct Entry {
+      f32 dist;
+      u32 node;
+      bool exact;
+      bool operator<(const Entry& o) const { return dist > o.dist; }
+    };
+    thread_local std::vector<Entry> heap;
+    heap.clear();
+    heap.push_back({m_Nodes[m_Root].box.DistanceSq(point), m_Root, false});
+    u32 found = 0;
+    while (!heap.empty() && found < want) {
+      std::pop_heap(heap.begin(), heap.end());
+      Entry e = heap.back();
+      heap.pop_back();
+      const Node& n = m_Nodes[e.node];
+      if (e.exact) {
+        out.push_back(n.id);
+        ++found;
+        continue;
+      }
+      if (n.IsLeaf()) {
+        heap.push_back({n.tight.DistanceSq(point), e.node, true});
+        std::push_heap(heap.begin(), heap.end());
+        continue;
+      }
+      for (u32 child : {n.left, n.right}) {
+        heap.push_back({m_Nodes[child].box.DistanceSq(point), child, false});
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+  }
+
+  u32 DynamicBVH::Depth() const {
+    if (m_Root == NONE)
+      return 0;
+    u32 deepest = 0;
+    std::vector<std::pair<u32, u32>> stack{{m_Root, 1}};
+    while (!stack.empty()) {
+      auto [node, depth] = stack.back();
+      stack.pop_back();
+      deepest = std::max(deepest, depth);
+      const Node& n = m_Nodes[node];
+      if (!n.IsLeaf()) {
+        stack.push_back({n.left, depth + 1});
+        stack.push_back({n.right, depth + 1});
+      }
+    }
+    return deepest;
+  }
+}
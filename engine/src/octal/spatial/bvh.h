@@ -0,0 +1,80 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/spatial/index.h"
+#include <vector>
+
+namespace octal {
+
+  /// Spatial index that keeps entities in a binary tree of bounding boxes
+  /// Leaves store a box grown by a margin so entities that move a little don't
+  /// touch the tree. Single updates insert by the smallest growth in surface
+  /// area. Build sorts every entity along a Morton curve and builds all
+  /// internal nodes in parallel, which gives a good tree to update from.
+  /// Handles entities of very different sizes better than LooseGrid.
+  class DynamicBVH : public SpatialIndex {
+    public:
+      /// Constructor
+      /// @param margin how far leaf boxes are grown past the entity's box
+      DynamicBVH(f32 margin = 0.1f);
+
+      void Update(u32 id, const AABB& box) override;
+      void Remove(u32 id) override;
+      void Build(const u32* ids, const AABB* boxes, u32 count) override;
+      void Clear() override;
+      u32 Size() const override { return m_Count; }
+      void Query(const AABB& box, std::vector<u32>& out) const override;
+      RayHit Raycast(const Ray& ray) const override;
+      void Nearest(const vec3& point, u32 k, std::vector<u32>& out) const override;
+
+      /// Number of levels of the tree, for checking how balanced it is
+      u32 Depth() const;
+
+    private:
+      /// Node of the tree, a leaf if it has no children
+      struct Node {
+        /// Box around everything below the node, grown by the margin for leaves
+        AABB box;
+        /// Exact box of the entity of a leaf
+        AABB tight;
+        /// Parent node or NONE for the root, the next free node for free ones
+        u32 parent;
+        /// Children or NONE for leaves
+        u32 left;
+        u32 right;
+        /// Entity of a leaf
+        u32 id;
+
+        bool IsLeaf() const { return left == NONE; }
+      };
+
+      /// Get a node from the free list or grow the array
+      u32 allocate();
+
+      /// Put a node on the free list
+      void release(u32 node);
+
+      /// Link a leaf into the tree next to the node it grows the least
+      void insertLeaf(u32 leaf);
+
+      /// Unlink a leaf from the tree and free its parent
+      void removeLeaf(u32 leaf);
+
+      /// Recompute the boxes from a node up to the root
+      void refit(u32 node);
+
+      /// Every node, including free ones
+      std::vector<Node> m_Nodes;
+
+      /// Root node or NONE if the tree is empty
+      u32 m_Root{NONE};
+
+      /// First free node or NONE
+      u32 m_Free{NONE};
+
+      /// Number of entities
+      u32 m_Count{0};
+
+      /// How far leaf boxes are grown
+      f32 m_Margin;
+  };
+}
@@ -0,0 +1,263 @@
+#include "octal/spatial/grid.h"
+#include "octal/core/jobs.h"
+#include <algorithm>
+#include <cmath>
+
+namespace octal {
+
+  /// Cell coordinates are kept to 21 bits each so a key fits in 64
+  static constexpr i32 COORD_BIAS = 1 << 20;
+  /// Key given to objects too big for a cell
+  static constexpr u64 OVERSIZE_KEY = ~0ull;
+
+  LooseGrid::LooseGrid(f32 cell_size)
+    : m_CellSize(cell_size), m_InvCellSize(1.0f / cell_size) {}
+
+  i32 LooseGrid::coord(f32 v) const {
+    f32 c = std::floor(v * m_InvCellSize);
+    // also catches infinite query boxes
+    if (!(c >= (f32) -COORD_BIAS))
+      return -COORD_BIAS;
+    if (c > (f32) (COORD_BIAS - 1))
+      return COORD_BIAS - 1;
+    return (i32) c;
+  }
+
+  u64 LooseGrid::key(i32 x, i32 y, i32 z) {
+    return ((u64) (x + COORD_BIAS) << 42) | ((u64) (y + COORD_BIAS) << 21) | (u64) (z + COORD_BIAS);
+  }
+
+  AABB LooseGrid::looseBounds(u64 key) const {
+    const u64 mask = (1ull << 21) - 1;
+    vec3 c{
+      (f32) ((i32) ((key >> 42) & mask) - COORD_BIAS),
+      (f32) ((i32) ((key >> 21) & mask) - COORD_BIAS),
+      (f32) ((i32) (key & mask) - COORD_BIAS),
+    };
+    f32 half = m_CellSize * 0.5f;
+    return {c * m_CellSize - vec3(half), (c + vec3(1)) * m_CellSize + vec3(half)};
+  }
+
+  u64 LooseGrid::cellKey(const AABB& box) const {
+    vec3 e = box.Extents();
+    // the loose bounds only stretch half a cell past the cell
+    if (std::max(e.x, std::max(e.y, e.z)) * 2 > m_CellSize)
+      return OVERSIZE_KEY;
+    vec3 c = box.Center();
+    return key(coord(c.x), coord(c.y), coord(c.z));
+  }
+
+  void LooseGrid::place(u32 obj, u64 key) {
+    Object& o = m_Objects[obj];
+    if (key == OVERSIZE_KEY) {
+      o.cell = OVERSIZE;
+      o.slot = (u32) m_Oversize.size();
+      m_Oversize.push_back(obj);
+      return;
+    }
+    auto [itr, added] = m_CellIndex.try_emplace(key, (u32) m_Cells.size());
+    if (added)
+      m_Cells.push_back({key, {}});
+    Cell& cell = m_Cells[itr->second];
+    o.cell = itr->second;
+    o.slot = (u32) cell.objects.size();
+    cell.objects.push_back(obj);
+  }
+
+  void LooseGrid::unplace(u32 obj) {
+    Object& o = m_Objects[obj];
+    std::vector<u32>& list = o.cell == OVERSIZE ? m_Oversize : m_Cells[o.cell].objects;
+    // swap the last object of the list into the hole
+    u32 last = list.back();
+    list[o.slot] = last;
+    m_Objects[last].slot = o.slot;
+    list.pop_back();
+  }
+
+  void LooseGrid::Update(u32 id, const AABB& box) {
+    m_Bounds = AABB::Merge(m_Bounds, box);
+    u64 k = cellKey(box);
+    u32 obj = handle(id);
+    if (obj == NONE) {
+      obj = (u32) m_Objects.size();
+      m_Objects.push_back({box, id, 0, 0});
+      setHandle(id, obj);
+      place(obj, k);
+      return;
+    }
+    Object& o = m_Objects[obj];
+    o.box = box;
+    u64 current = o.cell == OVERSIZE ? OVERSIZE_KEY : m_Cells[o.cell].key;
+    if (k != current) {
+      unplace(obj);
+      place(obj, k);
+    }
+  }
+
+  void LooseGrid::Remove(u32 id) {
+    u32 obj = handle(id);
+    if (obj == NONE)
+      return;
+    unplace(obj);
+    clearHandle(id);
+    // move the last object into the hole and point its cell at the new index
+    u32 last = (u32) m_Objects.size() - 1;
+    if (obj != last) {
+      Object& moved = m_Objects[obj] = m_Objects[last];
+      std::vector<u32>& list = moved.cell == OVERSIZE ? m_Oversize : m_Cells[moved.cell].objects;
+      list[moved.slot] = obj;
+      setHandle(moved.id, obj);
+    }
+    m_Objects.pop_back();
+  }
+
+  void LooseGrid::Build(const u32* ids, const AABB* boxes, u32 count) {
+    Clear();
+    m_Objects.resize(count);
+    // key of each object paired with its index so sorting groups cells together
+    std::vector<std::pair<u64, u32>> keys(count);
+    JobSystem::ParallelFor(count, 4096, [&](u32 begin, u32 end) {
+      for (u32 i = begin; i < end; ++i) {
+        m_Objects[i] = {boxes[i], ids[i], 0, 0};
+        keys[i] = {cellKey(boxes[i]), i};
+      }
+    });
+    std::sort(keys.begin(), keys.end());
+
+    for (u32 i = 0; i < count; ++i) {
+      setHandle(ids[i], i);
+      m_Bounds = AABB::Merge(m_Bounds, boxes[i]);
+    }
+    for (u32 i = 0; i < count;) {
+      u64 k = keys[i].first;
+      u32 end = i;
+      while (end < count && keys[end].first == k)
+        ++end;
+      std::vector<u32>* list = &m_Oversize;
+      u32 cell = OVERSIZE;
+      if (k != OVERSIZE_KEY) {
+        cell = (u32) m_Cells.size();
+        m_CellIndex.emplace(k, cell);
+        m_Cells.push_back({k, {}});
+        list = &m_Cells.back().objects;
+      }
+      list->reserve(end - i);
+      for (; i < end; ++i) {
+        Object& o = m_Objects[keys[i].second];
+        o.cell = cell;
+        o.slot = (u32) list->size();
+        list->push_back(keys[i].second);
+      }
+    }
+  }
+
+  void LooseGrid::Clear() {
+    m_Objects.clear();
+    m_Cells.clear();
+    m_CellIndex.clear();
+    m_Oversize.clear();
+    m_Bounds = {vec3(INFINITY), vec3(-INFINITY)};
+    clearHandles();
+  }
+
+  template<typename F>
+  void LooseGrid::eachCell(const AABB& box, F&& func) const {
+    f32 half = m_CellSize * 0.5f;
+    i32 lx = coord(box.min.x - half), ly = coord(box.min.y - half), lz = coord(box.min.z - half);
+    i32 hx = coord(box.max.x + half), hy = coord(box.max.y + half), hz = coord(box.max.z + half);
+    u64 volume = (u64) (hx - lx + 1) * (u64) (hy - ly + 1) * (u64) (hz - lz + 1);
+    // big boxes are cheaper to check against every cell than to look up each one
+    if (volume > m_Cells.size()) {
+      for (const Cell& cell : m_Cells) {
+        if (!cell.objects.empty() && looseBounds(cell.key).Overlaps(box))
+          func(cell);
+      }
+      return;
+    }
+    for (i32 x = lx; x <= hx; ++x) {
+      for (i32 y = ly; y <= hy; ++y) {
+        for (i32 z = lz; z <= hz; ++z) {
+          auto itr = m_CellIndex.find(key(x, y, z));
+          if (itr != m_CellIndex.end())
+            func(m_Cells[itr->second]);
+        }
+      }
+    }
+  }
+
+  void LooseGrid::Query(const AABB& box, std::vector<u32>& out) const {
+    auto test = [&](const std::vector<u32>& objects) {
+      for (u32 obj : objects) {
+        if (m_Objects[obj].box.Overlaps(box))
+          out.push_back(m_Objects[obj].id);
+      }
+    };
+    eachCell(box, [&](const Cell& cell) { test(cell.objects); });
+    test(m_Oversize);
+  }
+
+  RayHit LooseGrid::Raycast(const Ray& ray) const {
+    RayHit hit;
+    f32 enter, exit;
+    if (m_Objects.empty() || !ray.Intersects(m_Bounds, enter, exit))
+      return hit;
+    auto test = [&](const std::vector<u32>& objects) {
+      for (u32 obj : objects) {
+        f32 t;
+        if (ray.Intersects(m_Objects[obj].box, t) && t < hit.t)
+          hit = {m_Objects[obj].id, t};
+      }
+    };
+    test(m_Oversize);
+
+    // visit the cells along the part of the ray inside the grid, nearest first
+    thread_local std::vector<std::pair<f32, const Cell*>> cells;
+    cells.clear();
+    AABB segment = AABB::Merge({ray.At(enter), ray.At(enter)}, {ray.At(exit), ray.At(exit)});
+    eachCell(segment, [&](const Cell& cell) {
+      f32 t;
+      if (ray.Intersects(looseBounds(cell.key), t))
+        cells.push_back({t, &cell});
+    });
+    std::sort(cells.begin(), cells.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (auto& [t, cell] : cells) {
+      // nothing in this cell or any after it can be closer
+      if (t > hit.t)
+        break;
+      test(cell->objects);
+    }
+    return hit;
+  }
+
+  void LooseGrid::Nearest(const vec3& point, u32 k, std::vector<u32>& out) const {
+    u32 want = std::min(k, Size());
+    if (want == 0)
+      return;
+    thread_local std::vector<std::pair<f32, u32>> found;
+    // grow a cube around the point until it holds enough objects that are closer than its half size
+    for (f32 r = m_CellSize * 0.5f;; r *= 2) {
+      AABB cube{point - vec3(r), point + vec3(r)};
+      found.clear();
+      auto test = [&](const std::vector<u32>& objects) {
+        for (u32 obj : objects) {
+          const Object& o = m_Objects[obj];
+          if (o.box.Overlaps(cube))
+            found.push_back({o.box.DistanceSq(point), o.id});
+        }
+      };
+      eachCell(cube, [&](const Cell& cell) { test(cell.objects); });
+      test(m_Oversize);
+
+      u32 inside = 0;
+      for (auto& f : found)
+        inside += f.first <= r * r;
+      // once the cube holds everything the closest ones are all in it
+      if (inside >= want || cube.Contains(m_Bounds)) {
+        std::partial_sort(found.begin(), found.begin() + want, found.end());
+        for (u32 i = 0; i < want; ++i)
+          out.push_back(found[i].second);
+        return;
+      }
+    }
+  }
+}
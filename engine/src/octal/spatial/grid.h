@@ -0,0 +1,98 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/spatial/index.h"
+#include <unordered_map>
+#include <vector>
+
+namespace octal {
+
+  /// Spatial index that hashes entities into the cubic cell holding the center of their box
+  /// The grid is loose: a cell's contents may stick out of it by up to half a
+  /// cell, so an entity only ever lives in one cell and moving it rarely
+  /// changes cells. Entities bigger than a cell are kept in a separate list
+  /// that every query checks. Works best when most entities are about the
+  /// same size and the cell is around twice that.
+  class LooseGrid : public SpatialIndex {
+    public:
+      /// Constructor
+      /// @param cell_size length of the edge of each cell
+      LooseGrid(f32 cell_size = 4.0f);
+
+      void Update(u32 id, const AABB& box) override;
+      void Remove(u32 id) override;
+      void Build(const u32* ids, const AABB* boxes, u32 count) override;
+      void Clear() override;
+      u32 Size() const override { return (u32) m_Objects.size(); }
+      void Query(const AABB& box, std::vector<u32>& out) const override;
+      RayHit Raycast(const Ray& ray) const override;
+      void Nearest(const vec3& point, u32 k, std::vector<u32>& out) const override;
+
+      /// Length of the edge of each cell
+      f32 CellSize() const { return m_CellSize; }
+
+    private:
+      /// Cell of entities that are too big for any cell
+      static constexpr u32 OVERSIZE = ~0u;
+
+      /// An entity in the grid
+      struct Object {
+        AABB box;
+        u32 id;
+        /// Index of the cell in m_Cells or OVERSIZE
+        u32 cell;
+        /// Index of the object in its cell's list
+        u32 slot;
+      };
+
+      /// Entities whose box centers are in the same cell
+      struct Cell {
+        /// Coordinates of the cell packed by key()
+        u64 key;
+        /// Index of each object in m_Objects
+        std::vector<u32> objects;
+      };
+
+      /// Coordinate of the cell along one axis
+      i32 coord(f32 v) const;
+
+      /// Pack the coordinates of a cell into a key
+      static u64 key(i32 x, i32 y, i32 z);
+
+      /// Loose bounds of a cell, where its objects can reach
+      AABB looseBounds(u64 key) const;
+
+      /// Key of the cell an object belongs in, or OVERSIZE as a key if it is too big
+      u64 cellKey(const AABB& box) const;
+
+      /// Put an object in the list of a cell
+      void place(u32 obj, u64 key);
+
+      /// Take an object out of its cell's list
+      void unplace(u32 obj);
+
+      /// Call a function on every cell whose loose bounds overlap a box
+      /// @param func called as func(const Cell& cell)
+      template<typename F>
+      void eachCell(const AABB& box, F&& func) const;
+
+      /// Length of the edge of each cell
+      f32 m_CellSize;
+      /// One over the cell size
+      f32 m_InvCellSize;
+
+      /// Every entity in the grid, packed
+      std::vector<Object> m_Objects;
+
+      /// Cells that have held something, empty ones are kept for reuse
+      std::vector<Cell> m_Cells;
+
+      /// Index of each cell in m_Cells by its key
+      std::unordered_map<u64, u32> m_CellIndex;
+
+      /// Objects too big for a cell
+      std::vector<u32> m_Oversize;
+
+      /// Box around every object that has been in the grid since it was last built
+      AABB m_Bounds{vec3(INFINITY), vec3(-INFINITY)};
+  };
+}
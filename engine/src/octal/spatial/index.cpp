@@ -0,0 +1,60 @@
+#include "octal/spatial/index.h"
+#include "octal/core/jobs.h"
+#include <algorithm>
+
+namespace octal {
+
+  /// Number of queries each job runs
+  static constexpr u32 BATCH = 64;
+
+  /// Run queries in batches and pack their results
+  /// @param query called as query(i, out) to append the results of query i
+  template<typename F>
+  static void batched(u32 count, QueryResults& out, F&& query) {
+    // every batch fills its own arrays so nothing is shared while running
+    u32 batches = (count + BATCH - 1) / BATCH;
+    std::vector<std::vector<u32>> ids(batches), sizes(batches);
+    JobSystem::ParallelFor(count, BATCH, [&](u32 begin, u32 end) {
+      // a single call can cover several batches when there are no workers
+      for (u32 i = begin; i < end; ++i) {
+        u32 b = i / BATCH;
+        size_t before = ids[b].size();
+        query(i, ids[b]);
+        sizes[b].push_back((u32) (ids[b].size() - before));
+      }
+    });
+
+    out.offsets.resize(count + 1);
+    out.offsets[0] = 0;
+    u32 q = 0;
+    for (u32 b = 0; b < batches; ++b) {
+      for (u32 size : sizes[b]) {
+        out.offsets[q + 1] = out.offsets[q] + size;
+        ++q;
+      }
+    }
+    out.ids.resize(out.offsets[count]);
+    for (u32 b = 0; b < batches; ++b) {
+      std::copy(ids[b].begin(), ids[b].end(), out.ids.begin() + out.offsets[b * BATCH]);
+    }
+  }
+
+  void SpatialIndex::QueryBatch(const AABB* boxes, u32 count, QueryResults& out) const {
+    batched(count, out, [&](u32 i, std::vector<u32>& found) {
+      Query(boxes[i], found);
+    });
+  }
+
+  void SpatialIndex::RaycastBatch(const Ray* rays, u32 count, RayHit* hits) const {
+    JobSystem::ParallelFor(count, BATCH, [&](u32 begin, u32 end) {
+      for (u32 i = begin; i < end; ++i)
+        hits[i] = Raycast(rays[i]);
+    });
+  }
+
+  void SpatialIndex::NearestBatch(const vec3* points, u32 count, u32 k, QueryResults& out) const {
+    batched(count, out, [&](u32 i, std::vector<u32>& found) {
+      Nearest(points[i], k, found);
+    });
+  }
+}
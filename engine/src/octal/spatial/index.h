@@ -0,0 +1,140 @@
+#pragma once
+#include "octal/defines.h"
+#include "octal/math/math.h"
+#include "octal/ecs/entityid.h"
+#include <vector>
+
+namespace octal {
+
+  /// Closest object hit by a ray
+  struct RayHit {
+    /// Entity that was hit, 0 if nothing was
+    u32 id{0};
+    /// Distance along the ray to where it entered the object's box
+    f32 t{INFINITY};
+  };
+
+  /// Results of a batch of queries stored back to back
+  struct QueryResults {
+    /// Where the results of each query start in ids, with one extra entry for the end
+    std::vector<u32> offsets;
+    /// Entities found by every query
+    std::vector<u32> ids;
+
+    /// Number of queries
+    u32 Count() const { return offsets.empty() ? 0 : (u32) offsets.size() - 1; }
+
+    /// Number of results of a query
+    u32 Size(u32 query) const { return offsets[query + 1] - offsets[query]; }
+
+    /// First result of a query
+    const u32* Begin(u32 query) const { return ids.data() + offsets[query]; }
+  };
+
+  /// Finds entities by where their bounding boxes are
+  /// Implementations keep one box per entity id and must allow queries from
+  /// several threads at once as long as nothing is being changed.
+  class SpatialIndex {
+    public:
+      /// Marks an entity that isn't in the index
+      static constexpr u32 NONE = ~0u;
+
+      /// Virtual destructor
+      virtual ~SpatialIndex() {};
+
+      /// Add an entity or move it if it is already in the index
+      /// @param id of the entity
+      /// @param box its bounding box in world space
+      virtual void Update(u32 id, const AABB& box) = 0;
+
+      /// Take an entity out of the index, does nothing if it isn't in it
+      /// @param id of the entity
+      virtual void Remove(u32 id) = 0;
+
+      /// Replace everything in the index, using the job system where it can
+      /// Faster than updating each entity once a large part of them has moved.
+      /// @param ids of the entities
+      /// @param boxes bounding box of each entity
+      /// @param count number of entities
+      virtual void Build(const u32* ids, const AABB* boxes, u32 count) = 0;
+
+      /// Remove every entity
+      virtual void Clear() = 0;
+
+      /// Number of entities in the index
+      virtual u32 Size() const = 0;
+
+      /// Find every entity whose box overlaps a box
+      /// @param box to look in
+      /// @param out the entities are appended to this, in no particular order
+      virtual void Query(const AABB& box, std::vector<u32>& out) const = 0;
+
+      /// Find the first entity box a ray enters
+      /// @param ray to cast
+      /// @return the hit, with an id of 0 if nothing was hit
+      virtual RayHit Raycast(const Ray& ray) const = 0;
+
+      /// Find the entities whose boxes are closest to a point
+      /// @param point to measure from
+      /// @param k how many entities to find
+      /// @param out the entities are appended to this, closest first
+      virtual void Nearest(const vec3& point, u32 k, std::vector<u32>& out) const = 0;
+
+      /// Is an entity in the index?
+      bool Contains(u32 id) const { return handle(id) != NONE; }
+
+      /// Run many box queries spread across the job system
+      /// @param boxes to look in
+      /// @param count number of queries
+      /// @param out filled with the results of each query
+      void QueryBatch(const AABB* boxes, u32 count, QueryResults& out) const;
+
+      /// Cast many rays spread across the job system
+      /// @param rays to cast
+      /// @param count number of rays
+      /// @param hits filled with the hit of each ray, must have room for count
+      void RaycastBatch(const Ray* rays, u32 count, RayHit* hits) const;
+
+      /// Run many nearest queries spread across the job system
+      /// @param points to measure from
+      /// @param count number of queries
+      /// @param k how many entities to find for each point
+      /// @param out filled with the results of each query, closest first
+      void NearestBatch(const vec3* points, u32 count, u32 k, QueryResults& out) const;
+
+    protected:
+      /// Handle an implementation gave an entity, or NONE
+      u32 handle(u32 id) const {
+        u32 idx = EntityIndex(id);
+        return idx < m_Handles.size() && m_Handles[idx].id == id ? m_Handles[idx].handle : NONE;
+      }
+
+      /// Remember the handle of an entity
+      void setHandle(u32 id, u32 handle) {
+        u32 idx = EntityIndex(id);
+        if (idx >= m_Handles.size())
+          m_Handles.resize(idx + 1, {0, NONE});
+        m_Handles[idx] = {id, handle};
+      }
+
+      /// Forget the handle of an entity
+      void clearHandle(u32 id) {
+        m_Handles[EntityIndex(id)] = {0, NONE};
+      }
+
+      /// Forget every handle
+      void clearHandles() {
+        m_Handles.clear();
+      }
+
+    private:
+      /// Handle of an entity along with its full id, so stale ids aren't found
+      struct Entry {
+        u32 id;
+        u32 handle;
+      };
+
+      /// Handle of each entity indexed by the index part of its id
+      std::vector<Entry> m_Handles;
+  };
+}
@@ -1,8 +1,17 @@
 #include "octal/core/logger.h"
 #include "platform/platform.h"
 #include "platform/linux/linux.h"
+#include "octal/core/memory.h"
 #include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
 #include <chrono>
+#include <ctime>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
@@ -177,6 +186,12 @@ namespace octal {
                 // TODO: Resizing
                 INFO("window resized");
             } break;
+            case XCB_UNMAP_NOTIFY: {
+                state->suspended = true;
+            } break;
+            case XCB_MAP_NOTIFY: {
+                state->suspended = false;
+            } break;
 
             case XCB_CLIENT_MESSAGE: {
                 cm = (xcb_client_message_event_t*)event;
@@ -196,12 +211,50 @@ namespace octal {
     return !should_quit;
   }
 
-  void* Platform::Allocate(u64 size, bool aligned) {
-    return malloc(size);
+  bool Platform::IsSuspended() {
+    LinuxState* state = (LinuxState*) s_State;
+    return state && state->suspended;
+  }
+
+  /// Sits right before every block from Allocate
+  struct BlockHeader {
+    /// Size the block was allocated with
+    u64 size;
+    /// Bytes from the start of the allocation to the block
+    u32 offset;
+    /// What the block is counted against
+    MemoryTag tag;
+  };
+  static_assert(sizeof(BlockHeader) <= Platform::HEADER_SIZE);
+
+  void* Platform::Allocate(u64 size, bool aligned, MemoryTag tag) {
+    // aligned blocks give up a whole cache line for the header to stay aligned
+    u64 offset = aligned ? ALIGNMENT : HEADER_SIZE;
+    void* raw = nullptr;
+    if (aligned) {
+      // blocks from posix_memalign are given back with free like any other
+      if (posix_memalign(&raw, ALIGNMENT, size + offset) != 0)
+        return nullptr;
+    } else {
+      raw = malloc(size + offset);
+      if (!raw)
+        return nullptr;
+    }
+    u8* block = (u8*) raw + offset;
+    BlockHeader* header = (BlockHeader*) (block - HEADER_SIZE);
+    header->size = size;
+    header->offset = (u32) offset;
+    header->tag = tag;
+    Memory::Track(tag, (i64) size);
+    return block;
   }
 
 	void Platform::Free(void* block) {
-	  free(block);
+	  if (!block)
+	    return;
+	  const BlockHeader* header = (const BlockHeader*) ((u8*) block - HEADER_SIZE);
+	  Memory::Track(header->tag, -(i64) header->size);
+	  free((u8*) block - header->offset);
 	}
 
   void* Platform::MemZero(void* block, u64 size) {
@@ -216,6 +269,55 @@ namespace octal {
     return memcpy(dest, src, size);
   }
 
+  const void* Platform::MapFile(const char* path, u64& size) {
+    size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return nullptr;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    // the mapping keeps the file alive
+    close(fd);
+    if (data == MAP_FAILED)
+      return nullptr;
+    // it is read front to back once
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    size = (u64) st.st_size;
+    return data;
+  }
+
+  void* Platform::CreateMappedFile(const char* path, u64 size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return nullptr;
+    if (ftruncate(fd, size) != 0) {
+      close(fd);
+      return nullptr;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+      return nullptr;
+    return data;
+  }
+
+  void Platform::CloseMappedFile(const char* path, void* data, u64 size, u64 used) {
+    if (!data)
+      return;
+    munmap(data, size);
+    if (truncate(path, used) != 0) {
+      WARN("Could not truncate %s", path);
+    }
+  }
+
+  void Platform::UnmapFile(const void* data, u64 size) {
+    if (data)
+      munmap((void*) data, size);
+  }
 
   void Platform::Write(const char* msg, u8 color) {
     const char* colour_strings[] = {"0;41", "1;31", "1;33", "1;32", "1;34", "1;35"};
@@ -227,11 +329,57 @@ namespace octal {
     fprintf(stderr, "\033[%sm%s\033[0m", colour_strings[color], msg);
   }
 
+  u64 Platform::Ticks() {
+    // served from the vDSO off the kernel's calibrated TSC, no syscall
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64) now.tv_sec * TICKS_PER_SECOND + (u64) now.tv_nsec;
+  }
+
   f64 Platform::AbsoluteTime() {
-    return 0.0;
+    return (f64) Ticks() / (f64) TICKS_PER_SECOND;
   }
 
   void Platform::Sleep(u64 ms) {
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
   }
+
+  void Platform::SleepUntil(u64 ticks) {
+    // an absolute deadline doesn't drift when a signal cuts the sleep short
+    timespec until;
+    until.tv_sec = (time_t) (ticks / TICKS_PER_SECOND);
+    until.tv_nsec = (long) (ticks % TICKS_PER_SECOND);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR) {}
+  }
+
+  u32 Platform::CoreCount() {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return std::thread::hardware_concurrency();
+    return (u32) CPU_COUNT(&allowed);
+  }
+
+  void Platform::PinThread(u32 core) {
+    // threads start with the mask of the one that created them, so unless
+    // something already pinned this one it is the process's
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return;
+    u32 cores = (u32) CPU_COUNT(&allowed);
+    if (cores == 0)
+      return;
+    // find the cpu behind the nth allowed core
+    u32 skip = core % cores;
+    i32 cpu = 0;
+    for (; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed) && skip-- == 0)
+        break;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      WARN("Could not pin thread to core %d", cpu);
+    }
+  }
 }
@@ -18,6 +18,8 @@ namespace octal {
     xcb_atom_t wm_protocols;
     /// Atom to notify us when the window is deleted
     xcb_atom_t wm_delete_win;
+    /// Is the window unmapped, like when it is minimized?
+    bool suspended;
   };
 
 }
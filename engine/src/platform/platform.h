@@ -3,6 +3,24 @@
 
 namespace octal {
 
+	/// What a block of memory is used for, see Memory::Stats
+	/// Only memory from Platform::Allocate is counted, so a tag covers the
+	/// allocations its subsystem routes through it and nothing else.
+	enum class MemoryTag : u8 {
+		/// Platform::Allocate without a tag
+		Unknown,
+		/// Component, tag and relation stores, the entity table and archetype chunks
+		ECS,
+		/// Log rings
+		Logger,
+		/// Jobs waiting to run and the worker queues
+		Jobs,
+		/// Per frame scratch memory
+		Frame,
+		/// Number of tags
+		Count,
+	};
+
 	class Platform {
 		public:
 			/// Start the platform
@@ -19,13 +37,24 @@ namespace octal {
 			/// Get all events from the system
 			static bool Flush();
 
+			/// Is the window hidden, minimized or otherwise not being shown?
+			static bool IsSuspended();
+
+			/// Alignment of blocks allocated with aligned set, one cache line
+			static constexpr u64 ALIGNMENT = 64;
+
+			/// Bytes in front of every block that remember its size and tag
+			static constexpr u64 HEADER_SIZE = 16;
+
 			/// Allocate on this platform
+			/// The block is counted against its tag until it is freed.
 			/// @param size of the block we are allocating
-			/// @param aligned if the block should be aligned
-			static void* Allocate(u64 size, bool aligned);
+			/// @param aligned if the block should start on a cache line, see ALIGNMENT
+			/// @param tag what the block is used for
+			static void* Allocate(u64 size, bool aligned, MemoryTag tag = MemoryTag::Unknown);
 		
 			/// Free on this platform
-			/// @param block to free
+			/// @param block to free, from Allocate whether it was aligned or not
 			static void Free(void* block);
 
 			/// Set block of memory to zero
@@ -44,6 +73,31 @@ namespace octal {
 			/// @param size of the block
 			static void* MemCopy(void* dest, const void* source, u64 size);
 
+			/// Map a whole file into memory to read from
+			/// @param path of the file
+			/// @param size set to the size of the file in bytes
+			/// @return the start of the mapping, page aligned, or null if the file couldn't be mapped
+			static const void* MapFile(const char* path, u64& size);
+
+			/// Unmap a file mapped with MapFile
+			/// @param data start of the mapping
+			/// @param size of the mapping in bytes
+			static void UnmapFile(const void* data, u64 size);
+
+			/// Create a file of a fixed size and map it into memory to write to
+			/// Replaces whatever was at path, the file starts out zeroed.
+			/// @param path of the file
+			/// @param size of the file in bytes
+			/// @return the start of the mapping or null if the file couldn't be created
+			static void* CreateMappedFile(const char* path, u64 size);
+
+			/// Unmap a file from CreateMappedFile and cut it down to what was written
+			/// @param path of the file
+			/// @param data start of the mapping
+			/// @param size of the mapping in bytes
+			/// @param used bytes at the start of the file to keep
+			static void CloseMappedFile(const char* path, void* data, u64 size, u64 used);
+
 			/// Write to the platform's console
 			/// @param msg text to print
 			/// @param color of the text
@@ -54,7 +108,15 @@ namespace octal {
 			/// @param color of the text
 			static void WriteError(const char* msg, u8 color);
 
+			/// Ticks in a second; each tick is a nanosecond
+			static constexpr u64 TICKS_PER_SECOND = 1000000000;
+
+			/// Nanoseconds on a monotonic clock, never goes backwards
+			/// Counts from an arbitrary point so only differences mean anything.
+			static u64 Ticks();
+
 			/// What time is it?
+			/// @return seconds on the same clock as Ticks
 			static f64 AbsoluteTime();
 
 			// Sleep on the thread for the provided ms. This blocks the main thread.
@@ -64,6 +126,20 @@ namespace octal {
 			/// @param ms amount of time to sleep in ms
 			static void Sleep(u64 ms);
 
+			/// Sleep the calling thread until a time on the Ticks clock
+			/// Wakes a little late, by however long the scheduler takes. See FramePacer
+			/// for waiting more precisely than that.
+			/// @param ticks time to wake up at
+			static void SleepUntil(u64 ticks);
+
+			/// Number of cores the process is allowed to run on
+			/// Respects the affinity mask it was started with, e.g. by taskset or a container.
+			static u32 CoreCount();
+
+			/// Pin the calling thread to a core
+			/// @param core index among the cores the process may run on, wraps around if there are fewer
+			static void PinThread(u32 core);
+
       /// State held by the platform
       static void* s_State;
     private:
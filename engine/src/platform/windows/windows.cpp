@@ -1,7 +1,10 @@
 #include "octal/platform/platform.h"
+#include "octal/core/memory.h"
 #include <cstdlib>
+#include <malloc.h>
 #include <cstring>
 #include <cstdio>
+#include <thread>
 
 namespace octal {
   bool Platform::Init() {
@@ -19,12 +22,42 @@ namespace octal {
     return !quit;
   }
 
-  void* Platform::Allocate(u64 size, bool aligned) {
-    return malloc(size);
+  bool Platform::IsSuspended() {
+    return false;
+  }
+
+  /// Sits right before every block from Allocate
+  struct BlockHeader {
+    /// Size the block was allocated with
+    u64 size;
+    /// Bytes from the start of the allocation to the block
+    u32 offset;
+    /// What the block is counted against
+    MemoryTag tag;
+  };
+  static_assert(sizeof(BlockHeader) <= Platform::HEADER_SIZE);
+
+  void* Platform::Allocate(u64 size, bool aligned, MemoryTag tag) {
+    // _aligned_free can't free blocks from malloc so every block goes through _aligned_malloc
+    u64 offset = aligned ? ALIGNMENT : HEADER_SIZE;
+    u8* raw = (u8*) _aligned_malloc(size + offset, aligned ? ALIGNMENT : 16);
+    if (!raw)
+      return nullptr;
+    u8* block = raw + offset;
+    BlockHeader* header = (BlockHeader*) (block - HEADER_SIZE);
+    header->size = size;
+    header->offset = (u32) offset;
+    header->tag = tag;
+    Memory::Track(tag, (i64) size);
+    return block;
   }
 
 	void Platform::Free(void* block) {
-	  free(block);
+	  if (!block)
+	    return;
+	  const BlockHeader* header = (const BlockHeader*) ((u8*) block - HEADER_SIZE);
+	  Memory::Track(header->tag, -(i64) header->size);
+	  _aligned_free((u8*) block - header->offset);
 	}
 
   void* Platform::MemZero(void* block, u64 size) {
@@ -39,6 +72,20 @@ namespace octal {
     return memcpy(dest, src, size);
   }
 
+  const void* Platform::MapFile(const char* path, u64& size) {
+    size = 0;
+    return nullptr;
+  }
+
+  void Platform::UnmapFile(const void* data, u64 size) {
+  }
+
+  void* Platform::CreateMappedFile(const char* path, u64 size) {
+    return nullptr;
+  }
+
+  void Platform::CloseMappedFile(const char* path, void* data, u64 size, u64 used) {
+  }
 
   void Platform::Write(const char* msg, u8 color) {
   }
@@ -46,6 +93,10 @@ namespace octal {
   void Platform::WriteError(const char* msg, u8 color) {
   }
 
+  u64 Platform::Ticks() {
+    return 0;
+  }
+
   f64 Platform::AbsoluteTime() {
     return 0.0;
   }
@@ -53,4 +104,16 @@ namespace octal {
   void Platform::Sleep(u64 ms) {
 
   }
+
+  void Platform::SleepUntil(u64 ticks) {
+
+  }
+
+  u32 Platform::CoreCount() {
+    return std::thread::hardware_concurrency();
+  }
+
+  void Platform::PinThread(u32 core) {
+
+  }
 }
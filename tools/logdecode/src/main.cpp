@@ -0,0 +1,110 @@
+#include <octal/core/logfile.h>
+#include <octal/core/logger.h>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+// Turns binary logs written with LogSink::Binary back into text
+// usage: octal-logdecode [--json] file...
+
+/// Local wall clock time of a message as HH:MM:SS.uuuuuu
+static std::string clockTime(u64 wall_time) {
+  time_t seconds = (time_t) (wall_time / 1000000000ull);
+  tm local{};
+  localtime_r(&seconds, &local);
+  char text[32];
+  snprintf(text, sizeof(text), "%02d:%02d:%02d.%06llu", local.tm_hour, local.tm_min, local.tm_sec,
+      (unsigned long long) (wall_time % 1000000000ull / 1000));
+  return text;
+}
+
+/// Append a string as a JSON string literal
+static void appendJson(std::string& out, const std::string& text) {
+  out += '"';
+  for (char c : text) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if ((unsigned char) c < 0x20) {
+          char escape[8];
+          snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char) c);
+          out += escape;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+/// Print every message in a file
+/// @return false if it isn't a binary log
+static bool decode(const char* path, bool json) {
+  octal::LogFileReader reader;
+  if (!reader.Open(path)) {
+    fprintf(stderr, "octal-logdecode: %s is not a binary log\n", path);
+    return false;
+  }
+  octal::LogFileReader::Message msg;
+  std::string line;
+  while (reader.Next(msg)) {
+    std::string text = octal::FormatLogMessage(msg.format, msg.args, msg.bytes);
+    line.clear();
+    if (json) {
+      line += "{\"time\":";
+      line += std::to_string(msg.wall_time);
+      line += ",\"level\":";
+      appendJson(line, octal::LogLevelName(msg.level));
+      line += ",\"category\":";
+      appendJson(line, octal::LogCategoryName(msg.category));
+      line += ",\"thread\":";
+      line += std::to_string(msg.thread);
+      line += ",\"message\":";
+      appendJson(line, text);
+      line += "}\n";
+    } else {
+      line += clockTime(msg.wall_time);
+      line += " [";
+      line += octal::LogLevelName(msg.level);
+      line += "] [";
+      line += octal::LogCategoryName(msg.category);
+      line += "] t";
+      line += std::to_string(msg.thread);
+      line += ' ';
+      line += text;
+      line += '\n';
+    }
+    fwrite(line.data(), 1, line.size(), stdout);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  int files = 0;
+  bool ok = true;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      printf("usage: octal-logdecode [--json] file...\n");
+      return 0;
+    }
+  }
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-')
+      continue;
+    ++files;
+    ok = decode(argv[i], json) && ok;
+  }
+  if (files == 0) {
+    fprintf(stderr, "usage: octal-logdecode [--json] file...\n");
+    return 1;
+  }
+  return ok ? 0 : 1;
+}